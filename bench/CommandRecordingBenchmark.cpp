@@ -0,0 +1,227 @@
+/*
+* Command recording benchmark
+*
+* Measures how the recording time of a draw list scales with the number of recording threads, using the worker pool of
+* src/WorkerPool.cpp the way src/ParallelRecorder.cpp does. Without a device the commands are encoded into per thread
+* streams standing in for secondary command buffers, with the same commands ScreenshotExample::recordDraws records:
+* every part starts with the viewport, scissor and bindings a secondary command buffer doesn't inherit, followed by one
+* indexed draw per draw. The streams executed in order are checked to contain the same draws as the stream recorded on
+* one thread. This measures the split and the threads, not a driver's vkCmd* cost, headless --record-sweep times the
+* real recording.
+*
+* Usage: command-recording-bench [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/WorkerPool.hpp"
+
+namespace
+{
+    enum Command : uint32_t
+    {
+        SetViewport = 1,
+        SetScissor,
+        BindDescriptorSets,
+        BindPipeline,
+        BindVertexBuffers,
+        BindIndexBuffer,
+        DrawIndexed,
+    };
+
+    // A secondary command buffer, the words every command is encoded into
+    using CommandStream = std::vector<uint32_t>;
+
+    const uint32_t instanceCount = 1000000;
+    const uint32_t indexCount = 36;
+
+    inline void emit(CommandStream & stream, Command command, std::initializer_list<uint32_t> arguments)
+    {
+        stream.push_back(command);
+        stream.push_back(static_cast<uint32_t>(arguments.size()));
+        stream.insert(stream.end(), arguments);
+    }
+
+    inline uint32_t floatBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // The commands of ScreenshotExample::recordDraws with instancing, the draws cover all instances in order
+    void recordDraws(CommandStream & stream, uint32_t firstDraw, uint32_t count, uint32_t drawCount)
+    {
+        emit(stream, SetViewport, { 0, 0, floatBits(1280.0f), floatBits(720.0f), floatBits(0.0f), floatBits(1.0f) });
+        emit(stream, SetScissor, { 0, 0, 1280, 720 });
+        emit(stream, BindDescriptorSets, { 0, 1, 0x1000, 256 });
+        emit(stream, BindPipeline, { 0x2000 });
+        emit(stream, BindVertexBuffers, { 0, 0x3000, 0 });
+        emit(stream, BindVertexBuffers, { 1, 0x5000, 0 });
+        emit(stream, BindIndexBuffer, { 0x4000, 0 });
+        for (uint32_t draw = firstDraw; draw < firstDraw + count; draw++) {
+            uint32_t firstInstance = static_cast<uint32_t>(uint64_t(instanceCount) * draw / drawCount);
+            uint32_t endInstance = static_cast<uint32_t>(uint64_t(instanceCount) * (draw + 1) / drawCount);
+            emit(stream, DrawIndexed, { indexCount, endInstance - firstInstance, 0, 0, firstInstance });
+        }
+    }
+
+    // The draw commands of streams executed in order, the state commands left out
+    CommandStream drawCommands(const std::vector<CommandStream> & streams)
+    {
+        CommandStream draws;
+        for (const CommandStream & stream : streams) {
+            for (size_t i = 0; i + 1 < stream.size(); i += 2 + stream[i + 1]) {
+                if (stream[i] == DrawIndexed) {
+                    draws.insert(draws.end(), stream.begin() + i, stream.begin() + i + 2 + stream[i + 1]);
+                }
+            }
+        }
+        return draws;
+    }
+
+    // Every part has to start with the state, a secondary command buffer would otherwise draw without a pipeline
+    bool startsWithState(const CommandStream & stream)
+    {
+        return stream.empty() || (stream[0] == SetViewport && std::find(stream.begin(), stream.end(), BindPipeline) != stream.end());
+    }
+
+    class Recorder
+    {
+    public:
+        explicit Recorder(uint32_t threadCount)
+            : streams(threadCount)
+        {
+            workers.start(threadCount);
+        }
+
+        // Streams are cleared rather than freed between frames, like a reset command buffer keeps its memory
+        void record(uint32_t drawCount)
+        {
+            workers.parallelFor(drawCount, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+                streams[worker].clear();
+                if (begin < end) {
+                    recordDraws(streams[worker], begin, end - begin, drawCount);
+                }
+            });
+        }
+
+        const std::vector<CommandStream> & recorded() const
+        { return streams; }
+
+    private:
+        vks::WorkerPool workers;
+        std::vector<CommandStream> streams;
+    };
+
+    // Every index of the range has to be covered exactly once, worker i by the i-th part
+    bool verifyPool(uint32_t threadCount)
+    {
+        vks::WorkerPool workers;
+        workers.start(threadCount);
+        for (uint32_t count : { 0u, 1u, threadCount - 1, threadCount, 1000u, 1001u }) {
+            std::vector<uint32_t> visits(count, 0);
+            std::vector<uint32_t> begins(threadCount, 0);
+            std::vector<uint32_t> ends(threadCount, 0);
+            workers.parallelFor(count, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+                begins[worker] = begin;
+                ends[worker] = end;
+                for (uint32_t i = begin; i < end; i++) {
+                    visits[i]++;
+                }
+            });
+            for (uint32_t worker = 0; worker + 1 < threadCount; worker++) {
+                if (ends[worker] != begins[worker + 1]) {
+                    std::cerr << "Error: Parts of " << count << " with " << threadCount << " workers aren't contiguous" << std::endl;
+                    return false;
+                }
+            }
+            if (std::any_of(visits.begin(), visits.end(), [](uint32_t v) { return v != 1; })) {
+                std::cerr << "Error: Not every index of " << count << " was run once with " << threadCount << " workers" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool verifyRecording(uint32_t threadCount, uint32_t drawCount)
+    {
+        std::vector<CommandStream> reference(1);
+        recordDraws(reference[0], 0, drawCount, drawCount);
+
+        Recorder recorder(threadCount);
+        recorder.record(drawCount);
+        if (drawCommands(recorder.recorded()) != drawCommands(reference)) {
+            std::cerr << "Error: " << drawCount << " draws recorded on " << threadCount << " threads differ from one thread" << std::endl;
+            return false;
+        }
+        for (const CommandStream & stream : recorder.recorded()) {
+            if (!startsWithState(stream)) {
+                std::cerr << "Error: A part of " << drawCount << " draws on " << threadCount << " threads doesn't set its state" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double measure(uint32_t threadCount, uint32_t drawCount, uint32_t iterations)
+    {
+        Recorder recorder(threadCount);
+        // The first frame grows the streams
+        recorder.record(drawCount);
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            recorder.record(drawCount);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            best = i == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = argc > 1 ? (uint32_t) std::strtoul(argv[1], nullptr, 10) : 20;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    const uint32_t threadCounts[] = { 1, 2, 4, 8 };
+    bool passed = true;
+    for (uint32_t threadCount : threadCounts) {
+        passed &= verifyPool(threadCount);
+        for (uint32_t drawCount : { 1u, 3u, 1000u, 9999u }) {
+            passed &= verifyRecording(threadCount, drawCount);
+        }
+    }
+    std::cout << "Verification of parts and recorded draws against one thread: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    std::cout << "Recording time (best of " << iterations << ", " << std::thread::hardware_concurrency() << " hardware threads):" << std::endl;
+    std::cout << std::right << std::setw(10) << "draws" << std::setw(10) << "threads" << std::setw(10) << "ms"
+              << std::setw(10) << "ns/draw" << std::setw(10) << "speedup" << std::endl;
+    for (uint32_t drawCount : { 1000u, 10000u, 100000u }) {
+        double singleMs = 0.0;
+        for (uint32_t threadCount : threadCounts) {
+            double ms = measure(threadCount, drawCount, iterations);
+            if (threadCount == 1) {
+                singleMs = ms;
+            }
+            std::cout << std::setw(10) << drawCount << std::setw(10) << threadCount << std::fixed << std::setprecision(3)
+                      << std::setw(10) << ms << std::setprecision(1) << std::setw(10) << ms * 1e6 / drawCount
+                      << std::setprecision(2) << std::setw(9) << singleMs / ms << "x" << std::endl;
+        }
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
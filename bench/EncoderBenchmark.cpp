@@ -0,0 +1,338 @@
+/*
+* Image encoder benchmark
+*
+* Measures throughput and compression ratio of the ppm, pam, QOI and PNG encoders in src/ImageEncoder.cpp. Every
+* encoded file is decoded again and compared with the source to make sure the encoders are lossless. No Vulkan
+* device is required.
+*
+* Without input files a synthetic frame resembling the example's triangle is encoded at 1080p and 4K. Captured
+* frames can be passed as binary ppm files, e.g. screenshots written by screenshot-headless.
+*
+* Usage: encoder-bench [output directory] [iterations] [frame.ppm ...]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "../src/ImageEncoder.hpp"
+
+namespace
+{
+    struct Frame
+    {
+        std::string name;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        /** @brief R8G8B8A8 texels without row padding */
+        std::vector<uint8_t> texels;
+    };
+
+    struct EncoderCase
+    {
+        vks::image::ImageFormat format;
+        int compressionLevel;
+    };
+
+    // Dark blue background with a red, green and blue shaded triangle, as rendered by the example
+    Frame createTriangleFrame(const char * name, uint32_t width, uint32_t height)
+    {
+        Frame frame;
+        frame.name = name;
+        frame.width = width;
+        frame.height = height;
+        frame.texels.resize(size_t(width) * height * 4);
+
+        const float x[3] = { 0.75f * width, 0.25f * width, 0.5f * width };
+        const float y[3] = { 0.8f * height, 0.8f * height, 0.2f * height };
+        const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+        uint8_t * texel = frame.texels.data();
+        for (uint32_t py = 0; py < height; py++) {
+            for (uint32_t px = 0; px < width; px++, texel += 4) {
+                float cx = px + 0.5f;
+                float cy = py + 0.5f;
+                float w0 = ((x[1] - cx) * (y[2] - cy) - (x[2] - cx) * (y[1] - cy)) / area;
+                float w1 = ((x[2] - cx) * (y[0] - cy) - (x[0] - cx) * (y[2] - cy)) / area;
+                float w2 = 1.0f - w0 - w1;
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f) {
+                    texel[0] = uint8_t(w0 * 255.0f + 0.5f);
+                    texel[1] = uint8_t(w1 * 255.0f + 0.5f);
+                    texel[2] = uint8_t(w2 * 255.0f + 0.5f);
+                } else {
+                    texel[0] = 0;
+                    texel[1] = 0;
+                    texel[2] = 51;
+                }
+                texel[3] = 255;
+            }
+        }
+        return frame;
+    }
+
+    bool loadPPM(const std::string & filename, Frame & frame)
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        std::string magic;
+        uint32_t maxValue = 0;
+        file >> magic >> frame.width >> frame.height >> maxValue;
+        file.get();
+        if (!file || magic != "P6" || maxValue != 255) {
+            return false;
+        }
+
+        std::vector<uint8_t> rgb(size_t(frame.width) * frame.height * 3);
+        file.read((char *) rgb.data(), rgb.size());
+        if (!file) {
+            return false;
+        }
+        frame.name = filename.substr(filename.find_last_of('/') + 1);
+        frame.texels.resize(size_t(frame.width) * frame.height * 4);
+        for (size_t i = 0; i < size_t(frame.width) * frame.height; i++) {
+            std::copy(&rgb[i * 3], &rgb[i * 3] + 3, &frame.texels[i * 4]);
+            frame.texels[i * 4 + 3] = 255;
+        }
+        return true;
+    }
+
+    uint32_t loadBigEndian(const uint8_t * src)
+    {
+        return uint32_t(src[0]) << 24 | uint32_t(src[1]) << 16 | uint32_t(src[2]) << 8 | src[3];
+    }
+
+    std::vector<uint8_t> decodeQOI(const std::vector<uint8_t> & file, size_t pixelCount)
+    {
+        std::vector<uint8_t> rgb;
+        rgb.reserve(pixelCount * 3);
+        uint8_t index[64][4] = {};
+        uint8_t pixel[4] = { 0, 0, 0, 255 };
+        size_t pos = 14;
+        while (rgb.size() < pixelCount * 3 && pos < file.size()) {
+            uint8_t op = file[pos++];
+            uint32_t run = 1;
+            if (op == 0xfe) {
+                pixel[0] = file[pos++];
+                pixel[1] = file[pos++];
+                pixel[2] = file[pos++];
+            } else if (op == 0xff) {
+                std::copy(&file[pos], &file[pos] + 4, pixel);
+                pos += 4;
+            } else if ((op & 0xc0) == 0x00) {
+                std::copy(index[op], index[op] + 4, pixel);
+            } else if ((op & 0xc0) == 0x40) {
+                pixel[0] += ((op >> 4) & 3) - 2;
+                pixel[1] += ((op >> 2) & 3) - 2;
+                pixel[2] += (op & 3) - 2;
+            } else if ((op & 0xc0) == 0x80) {
+                int dg = (op & 0x3f) - 32;
+                uint8_t next = file[pos++];
+                pixel[0] += dg + (next >> 4) - 8;
+                pixel[1] += dg;
+                pixel[2] += dg + (next & 0x0f) - 8;
+            } else {
+                run = (op & 0x3f) + 1;
+            }
+            std::copy(pixel, pixel + 4, index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64]);
+            for (uint32_t i = 0; i < run; i++) {
+                rgb.insert(rgb.end(), pixel, pixel + 3);
+            }
+        }
+        return rgb;
+    }
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+        return uint8_t(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+    }
+
+    std::vector<uint8_t> decodePNG(const std::vector<uint8_t> & file, uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> idat;
+        for (size_t pos = 8; pos + 12 <= file.size();) {
+            uint32_t size = loadBigEndian(&file[pos]);
+            if (memcmp(&file[pos + 4], "IDAT", 4) == 0) {
+                idat.insert(idat.end(), &file[pos + 8], &file[pos + 8] + size);
+            }
+            pos += size + 12;
+        }
+
+        const size_t rowSize = size_t(width) * 3;
+        std::vector<uint8_t> filtered((rowSize + 1) * height);
+        uLongf filteredSize = filtered.size();
+        if (uncompress(filtered.data(), &filteredSize, idat.data(), idat.size()) != Z_OK || filteredSize != filtered.size()) {
+            return {};
+        }
+
+        std::vector<uint8_t> rgb(rowSize * height);
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t filterType = filtered[y * (rowSize + 1)];
+            const uint8_t * src = &filtered[y * (rowSize + 1) + 1];
+            uint8_t * dst = &rgb[y * rowSize];
+            for (size_t i = 0; i < rowSize; i++) {
+                int left = i >= 3 ? dst[i - 3] : 0;
+                int up = y > 0 ? dst[i - rowSize] : 0;
+                int upLeft = y > 0 && i >= 3 ? dst[i - rowSize - 3] : 0;
+                switch (filterType) {
+                    case 0: dst[i] = src[i]; break;
+                    case 1: dst[i] = uint8_t(src[i] + left); break;
+                    case 2: dst[i] = uint8_t(src[i] + up); break;
+                    case 3: dst[i] = uint8_t(src[i] + (left + up) / 2); break;
+                    case 4: dst[i] = uint8_t(src[i] + paeth(left, up, upLeft)); break;
+                }
+            }
+        }
+        return rgb;
+    }
+
+    // Decode an encoded file back to packed RGB
+    std::vector<uint8_t> decode(vks::image::ImageFormat format, const std::vector<uint8_t> & file, uint32_t width, uint32_t height)
+    {
+        switch (format) {
+            case vks::image::ImageFormat::PPM: {
+                size_t headerSize = vks::image::ppmHeader(width, height).size();
+                return std::vector<uint8_t>(file.begin() + std::min(headerSize, file.size()), file.end());
+            }
+            case vks::image::ImageFormat::PAM: {
+                // The source is R8G8B8A8, so the file holds RGB_ALPHA tuples
+                std::vector<uint8_t> rgb;
+                for (size_t i = vks::image::pamHeader(width, height, 4).size(); i + 4 <= file.size(); i += 4) {
+                    rgb.insert(rgb.end(), &file[i], &file[i] + 3);
+                }
+                return rgb;
+            }
+            case vks::image::ImageFormat::QOI:
+                return decodeQOI(file, size_t(width) * height);
+            case vks::image::ImageFormat::PNG:
+                return decodePNG(file, width, height);
+        }
+        return {};
+    }
+
+    std::vector<uint8_t> readFile(const std::string & filename)
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    template<typename Function>
+    double measure(uint32_t iterations, Function function)
+    {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::string outputPath = argc > 1 ? argv[1] : ".";
+    uint32_t iterations = argc > 2 ? (uint32_t) std::strtoul(argv[2], nullptr, 10) : 3;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    std::vector<Frame> frames;
+    for (int i = 3; i < argc; i++) {
+        Frame frame;
+        if (!loadPPM(argv[i], frame)) {
+            std::cerr << "Error: Could not read binary ppm \"" << argv[i] << "\"" << std::endl;
+            return EXIT_FAILURE;
+        }
+        frames.push_back(std::move(frame));
+    }
+    if (frames.empty()) {
+        frames.push_back(createTriangleFrame("1080p", 1920, 1080));
+        frames.push_back(createTriangleFrame("4K", 3840, 2160));
+    }
+
+    const std::vector<EncoderCase> encoderCases = {
+        { vks::image::ImageFormat::PPM, 0 },
+        { vks::image::ImageFormat::PAM, 0 },
+        { vks::image::ImageFormat::QOI, 0 },
+        { vks::image::ImageFormat::PNG, 1 },
+        { vks::image::ImageFormat::PNG, 6 },
+        { vks::image::ImageFormat::PNG, 9 },
+    };
+
+    std::cout << "Best of " << iterations << " iterations, throughput in MB of raw RGB per second" << std::endl;
+    std::cout << std::left << std::setw(16) << "frame" << std::setw(10) << "encoder"
+              << std::right << std::setw(12) << "time (ms)" << std::setw(10) << "MB/s" << std::setw(14) << "size (KB)" << std::setw(10) << "ratio" << std::endl;
+
+    bool lossless = true;
+    for (auto & frame : frames) {
+        vks::image::MappedImage image;
+        image.data = frame.texels.data();
+        image.width = frame.width;
+        image.height = frame.height;
+        image.rowPitch = uint64_t(frame.width) * 4;
+        image.layout = vks::pixels::PixelLayout::R8G8B8A8;
+
+        std::vector<uint8_t> reference(size_t(frame.width) * frame.height * 3);
+        vks::image::packRows(image, 0, frame.height, reference.data());
+        double rawMegabytes = reference.size() / (1024.0 * 1024.0);
+
+        for (auto & encoderCase : encoderCases) {
+            auto encoder = vks::image::createEncoder(encoderCase.format, encoderCase.compressionLevel);
+
+            // Encoding into memory leaves the disk out of the comparison
+            std::ostringstream stream;
+            double ms = measure(iterations, [&] {
+                stream.str("");
+                encoder->encode(stream, image);
+            });
+            std::string encoded = stream.str();
+            std::vector<uint8_t> file(encoded.begin(), encoded.end());
+
+            if (decode(encoderCase.format, file, frame.width, frame.height) != reference) {
+                std::cerr << "Error: Decoded " << vks::image::formatName(encoderCase.format) << " differs from the source for " << frame.name << std::endl;
+                lossless = false;
+            }
+
+            std::string encoderName = vks::image::formatName(encoderCase.format);
+            if (encoderCase.format == vks::image::ImageFormat::PNG) {
+                encoderName += " " + std::to_string(encoderCase.compressionLevel);
+            }
+            std::cout << std::left << std::setw(16) << frame.name << std::setw(10) << encoderName
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << ms << std::setw(10) << rawMegabytes / (ms / 1000.0)
+                      << std::setw(14) << file.size() / 1024.0 << std::setw(9) << double(reference.size()) / file.size() << "x" << std::endl;
+
+            // Writing through a file has to produce the same bytes as encoding into memory
+            std::string filename = outputPath + "/bench_encoder" + vks::image::formatExtension(encoderCase.format);
+            uint64_t fileSize = 0;
+            if (!vks::image::writeImage(filename.c_str(), image, *encoder, nullptr, &fileSize) || fileSize != file.size() || readFile(filename) != file) {
+                std::cerr << "Error: Written " << vks::image::formatName(encoderCase.format) << " file differs for " << frame.name << std::endl;
+                lossless = false;
+            }
+            std::remove(filename.c_str());
+        }
+    }
+
+    return lossless ? EXIT_SUCCESS : EXIT_FAILURE;
+}
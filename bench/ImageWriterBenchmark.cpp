@@ -0,0 +1,149 @@
+/*
+* Screenshot image writer benchmark
+*
+* Compares the original per-pixel ofstream::write loop of ScreenshotExample::saveScreenshot with the
+* block based vks::image::writePPM on synthetic mapped buffers. No Vulkan device is required.
+*
+* Usage: image-writer-bench [output directory] [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/ImageWriter.hpp"
+
+namespace
+{
+    struct Resolution
+    {
+        const char * name;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // Row pitch alignment as commonly reported for linear images
+    const uint64_t rowPitchAlignment = 256;
+
+    // Fill a buffer the way a mapped linear image would look like, including row padding
+    std::vector<uint8_t> createMappedBuffer(uint32_t height, uint64_t rowPitch)
+    {
+        std::vector<uint8_t> buffer(rowPitch * height);
+        uint32_t seed = 0x12345678;
+        for (auto & byte : buffer) {
+            seed = seed * 1664525u + 1013904223u;
+            byte = uint8_t(seed >> 24);
+        }
+        return buffer;
+    }
+
+    // The loop saveScreenshot used before the image writer was introduced
+    void writeLegacy(const char * filename, const vks::image::MappedImage & image)
+    {
+        const char * data = (const char *) image.data;
+        bool swizzle = image.layout == vks::pixels::PixelLayout::B8G8R8A8;
+        std::ofstream file(filename, std::ios::out | std::ios::binary);
+
+        file << "P6\n" << image.width << "\n" << image.height << "\n" << 255 << "\n";
+
+        for (uint32_t y = 0; y < image.height; y++) {
+            unsigned int * row = (unsigned int *) data;
+            for (uint32_t x = 0; x < image.width; x++) {
+                if (swizzle) {
+                    file.write((char *) row + 2, 1);
+                    file.write((char *) row + 1, 1);
+                    file.write((char *) row, 1);
+                } else {
+                    file.write((char *) row, 3);
+                }
+                row++;
+            }
+            data += image.rowPitch;
+        }
+        file.close();
+    }
+
+    std::vector<char> readFile(const std::string & filename)
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    template<typename Function>
+    double measure(uint32_t iterations, Function function)
+    {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::string outputPath = argc > 1 ? argv[1] : ".";
+    uint32_t iterations = argc > 2 ? (uint32_t) std::strtoul(argv[2], nullptr, 10) : 3;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    const std::vector<Resolution> resolutions = {
+        { "800x600", 800, 600 },
+        { "1080p", 1920, 1080 },
+        { "4K", 3840, 2160 },
+    };
+
+    std::string legacyFile = outputPath + "/bench_legacy.ppm";
+    std::string blockFile = outputPath + "/bench_block.ppm";
+
+    std::cout << "Best of " << iterations << " iterations" << std::endl;
+    std::cout << std::left << std::setw(10) << "size" << std::setw(10) << "swizzle"
+              << std::right << std::setw(14) << "legacy (ms)" << std::setw(14) << "block (ms)" << std::setw(10) << "speedup" << std::endl;
+
+    bool identical = true;
+    for (auto & resolution : resolutions) {
+        uint64_t rowPitch = (uint64_t(resolution.width) * 4 + rowPitchAlignment - 1) / rowPitchAlignment * rowPitchAlignment;
+        std::vector<uint8_t> buffer = createMappedBuffer(resolution.height, rowPitch);
+
+        for (bool swizzle : { false, true }) {
+            vks::image::MappedImage image;
+            image.data = buffer.data();
+            image.width = resolution.width;
+            image.height = resolution.height;
+            image.rowPitch = rowPitch;
+            image.layout = swizzle ? vks::pixels::PixelLayout::B8G8R8A8 : vks::pixels::PixelLayout::R8G8B8A8;
+
+            double legacyMs = measure(iterations, [&] { writeLegacy(legacyFile.c_str(), image); });
+            double blockMs = measure(iterations, [&] { vks::image::writePPM(blockFile.c_str(), image); });
+
+            if (readFile(legacyFile) != readFile(blockFile)) {
+                std::cerr << "Error: Output of the block writer differs for " << resolution.name << std::endl;
+                identical = false;
+            }
+
+            std::cout << std::left << std::setw(10) << resolution.name << std::setw(10) << (swizzle ? "yes" : "no")
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(14) << legacyMs << std::setw(14) << blockMs << std::setw(9) << legacyMs / blockMs << "x" << std::endl;
+        }
+    }
+
+    std::remove(legacyFile.c_str());
+    std::remove(blockFile.c_str());
+
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,106 @@
+/*
+* Instance update benchmark
+*
+* Measures the per-frame CPU cost of the instanced draw path: updating the model matrix of every instance with
+* src/Instancing.cpp, written in place as into the mapped instance buffer and, for comparison, into a host copy that is
+* then copied into the buffer the way a uniform or staging upload would. The instance counts go from a thousand to
+* a million, beyond the point where the matrices fall out of the caches. The matrices are checked against a double
+* precision reference first.
+*
+* Usage: instance-update-bench [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/Instancing.hpp"
+
+namespace
+{
+    bool verify(const std::vector<vks::instances::InstanceState> & instances, float time)
+    {
+        std::vector<float> transforms(instances.size() * 16);
+        vks::instances::updateTransforms(instances.data(), static_cast<uint32_t>(instances.size()), time, transforms.data());
+
+        double maxError = 0.0;
+        for (size_t i = 0; i < instances.size(); i++) {
+            const vks::instances::InstanceState & instance = instances[i];
+            double angle = double(instance.phase) + double(instance.speed) * time;
+            double c = std::cos(angle) * instance.scale;
+            double s = std::sin(angle) * instance.scale;
+            const double expected[16] = { c, s, 0, 0, -s, c, 0, 0, 0, 0, instance.scale, 0, instance.position[0], instance.position[1], 0, 1 };
+            for (int j = 0; j < 16; j++) {
+                maxError = std::max(maxError, std::fabs(expected[j] - transforms[i * 16 + j]));
+            }
+        }
+        // The float angle loses precision with time, a few float ulps of the angle scaled by the instance
+        bool passed = maxError <= 1e-5;
+        if (!passed) {
+            std::cerr << "Error: Transforms at time " << time << " differ from the reference by " << maxError << std::endl;
+        }
+        return passed;
+    }
+
+    template<typename Update>
+    double measure(Update update, uint32_t iterations)
+    {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            update(float(i) / 60.0f);
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = argc > 1 ? (uint32_t) std::strtoul(argv[1], nullptr, 10) : 20;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    std::vector<vks::instances::InstanceState> grid = vks::instances::createGrid(10000, 1.8f);
+    bool passed = verify(grid, 0.0f) && verify(grid, 1.0f) && verify(grid, 60.0f);
+    std::cout << "Verification against double precision reference: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    std::cout << "Best of " << iterations << " iterations, " << vks::instances::transformSize << " bytes per instance" << std::endl;
+    std::cout << std::right << std::setw(10) << "instances" << std::setw(10) << "MB"
+              << std::setw(12) << "in place" << std::setw(10) << "ns/inst" << std::setw(10) << "MB/s"
+              << std::setw(12) << "copied" << std::setw(10) << "ns/inst" << std::setw(12) << "60Hz frame" << std::endl;
+    for (uint32_t count : { 1000u, 4000u, 16000u, 64000u, 256000u, 1000000u }) {
+        std::vector<vks::instances::InstanceState> instances = vks::instances::createGrid(count, 1.8f);
+        std::vector<float> mapped(size_t(count) * 16);
+        std::vector<float> hostCopy(size_t(count) * 16);
+        size_t bytes = size_t(count) * vks::instances::transformSize;
+
+        double inPlaceMs = measure([&](float time) {
+            vks::instances::updateTransforms(instances.data(), count, time, mapped.data());
+        }, iterations);
+        double copiedMs = measure([&](float time) {
+            vks::instances::updateTransforms(instances.data(), count, time, hostCopy.data());
+            memcpy(mapped.data(), hostCopy.data(), bytes);
+        }, iterations);
+
+        double megaBytes = bytes / (1024.0 * 1024.0);
+        std::cout << std::setw(10) << count << std::fixed << std::setprecision(2) << std::setw(10) << megaBytes
+                  << std::setw(10) << inPlaceMs << "ms" << std::setw(10) << inPlaceMs * 1e6 / count << std::setw(10) << std::setprecision(0) << megaBytes / (inPlaceMs / 1000.0)
+                  << std::setprecision(2) << std::setw(10) << copiedMs << "ms" << std::setw(10) << copiedMs * 1e6 / count
+                  << std::setw(11) << std::setprecision(1) << 100.0 * inPlaceMs / (1000.0 / 60.0) << "%" << std::endl;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
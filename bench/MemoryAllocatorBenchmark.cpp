@@ -0,0 +1,223 @@
+/*
+* Memory sub-allocation benchmark
+*
+* Runs a random workload of buffer and image allocations and frees through the block sub-allocator used by
+* vks::MemoryAllocator, for several bufferImageGranularity values. Every allocation is checked for alignment, overlap
+* and the granularity separation of linear and optimal neighbours, then the workload is repeated to measure the cost
+* per call. Reports how many device memory allocations the blocks replace and how much of the reserved memory is in
+* use. No Vulkan device is required.
+*
+* Usage: memory-allocator-bench [operations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "../src/BlockSuballocator.hpp"
+
+namespace
+{
+    // Matches vks::MemoryAllocator::defaultBlockSize, larger resources get a dedicated allocation
+    const uint64_t blockSize = 64 * 1024 * 1024;
+    // Resources alive at the same time, once reached every allocation is preceded by a free
+    const uint32_t liveTarget = 2000;
+
+    struct Allocation
+    {
+        uint32_t block;
+        uint64_t offset;
+        uint64_t size;
+        vks::ResourceTiling tiling;
+    };
+
+    struct Result
+    {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        double allocateNs = 0.0;
+        double freeNs = 0.0;
+        uint32_t peakLive = 0;
+        uint32_t peakBlocks = 0;
+        uint64_t peakReserved = 0;
+        uint64_t peakUsed = 0;
+        bool valid = true;
+    };
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : state(seed)
+        {}
+
+        uint32_t next()
+        {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        }
+
+    private:
+        uint32_t state;
+    };
+
+    // Mostly small buffers with some large images, sizes spread evenly on a log scale from 256 bytes to 8 MiB
+    uint64_t randomSize(Random & random)
+    {
+        uint32_t shift = 8 + random.next() % 16;
+        return (uint64_t(1) << shift) + random.next() % (uint64_t(1) << shift);
+    }
+
+    bool check(const Allocation & allocation, uint64_t alignment, uint64_t granularity, const std::map<uint64_t, Allocation> & live)
+    {
+        if (allocation.offset % alignment != 0 || allocation.offset + allocation.size > blockSize) {
+            std::cerr << "Error: Misaligned or out of bounds allocation at " << allocation.offset << std::endl;
+            return false;
+        }
+        auto next = live.lower_bound(allocation.offset);
+        if (next != live.end()) {
+            const Allocation & other = next->second;
+            if (allocation.offset + allocation.size > other.offset) {
+                std::cerr << "Error: Allocation at " << allocation.offset << " overlaps the one at " << other.offset << std::endl;
+                return false;
+            }
+            if (other.tiling != allocation.tiling && (allocation.offset + allocation.size - 1) / granularity == other.offset / granularity) {
+                std::cerr << "Error: Allocation at " << allocation.offset << " shares a granularity page with the one at " << other.offset << std::endl;
+                return false;
+            }
+        }
+        if (next != live.begin()) {
+            const Allocation & other = std::prev(next)->second;
+            if (other.offset + other.size > allocation.offset) {
+                std::cerr << "Error: Allocation at " << allocation.offset << " overlaps the one at " << other.offset << std::endl;
+                return false;
+            }
+            if (other.tiling != allocation.tiling && (other.offset + other.size - 1) / granularity == allocation.offset / granularity) {
+                std::cerr << "Error: Allocation at " << allocation.offset << " shares a granularity page with the one at " << other.offset << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Result run(uint32_t operations, uint64_t granularity, bool verify)
+    {
+        const uint64_t alignments[] = { 4, 16, 256, 4096, 65536 };
+
+        Result result;
+        Random random(0x12345678);
+        std::vector<std::unique_ptr<vks::BlockSuballocator>> blocks;
+        std::vector<std::map<uint64_t, Allocation>> liveByBlock;
+        std::vector<Allocation> live;
+
+        for (uint32_t i = 0; i < operations; i++) {
+            bool doFree = !live.empty() && (live.size() >= liveTarget || random.next() % 3 == 0);
+            if (doFree) {
+                size_t index = random.next() % live.size();
+                Allocation allocation = live[index];
+                live[index] = live.back();
+                live.pop_back();
+
+                auto start = std::chrono::high_resolution_clock::now();
+                blocks[allocation.block]->free(allocation.offset);
+                result.freeNs += std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+                result.frees++;
+                if (verify) {
+                    liveByBlock[allocation.block].erase(allocation.offset);
+                }
+                continue;
+            }
+
+            Allocation allocation;
+            allocation.size = randomSize(random);
+            allocation.tiling = random.next() % 4 == 0 ? vks::ResourceTiling::Optimal : vks::ResourceTiling::Linear;
+            uint64_t alignment = alignments[random.next() % 5];
+
+            // First fit over the existing blocks, a new block if none has room, the same way MemoryAllocator picks one
+            auto start = std::chrono::high_resolution_clock::now();
+            bool placed = false;
+            for (uint32_t b = 0; b < blocks.size() && !placed; b++) {
+                if (blocks[b]->allocate(allocation.size, alignment, allocation.tiling, allocation.offset)) {
+                    allocation.block = b;
+                    placed = true;
+                }
+            }
+            if (!placed) {
+                blocks.emplace_back(new vks::BlockSuballocator(blockSize, granularity));
+                liveByBlock.emplace_back();
+                allocation.block = static_cast<uint32_t>(blocks.size() - 1);
+                placed = blocks.back()->allocate(allocation.size, alignment, allocation.tiling, allocation.offset);
+            }
+            result.allocateNs += std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+            result.allocations++;
+
+            if (!placed) {
+                std::cerr << "Error: A fresh block could not hold " << allocation.size << " bytes" << std::endl;
+                result.valid = false;
+                continue;
+            }
+            if (verify) {
+                if (!check(allocation, alignment, granularity, liveByBlock[allocation.block])) {
+                    result.valid = false;
+                }
+                liveByBlock[allocation.block][allocation.offset] = allocation;
+            }
+            live.push_back(allocation);
+
+            uint64_t used = 0;
+            for (auto & block : blocks) {
+                used += block->used();
+            }
+            result.peakLive = std::max(result.peakLive, static_cast<uint32_t>(live.size()));
+            result.peakBlocks = std::max(result.peakBlocks, static_cast<uint32_t>(blocks.size()));
+            result.peakReserved = std::max(result.peakReserved, blocks.size() * blockSize);
+            result.peakUsed = std::max(result.peakUsed, used);
+        }
+
+        // Freeing everything has to leave every block empty and in one piece
+        for (const Allocation & allocation : live) {
+            blocks[allocation.block]->free(allocation.offset);
+        }
+        for (auto & block : blocks) {
+            if (!block->empty() || block->largestFreeRange() != blockSize) {
+                std::cerr << "Error: Block not empty after freeing all allocations" << std::endl;
+                result.valid = false;
+            }
+        }
+        return result;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t operations = argc > 1 ? (uint32_t) std::strtoul(argv[1], nullptr, 10) : 200000;
+    if (operations == 0) {
+        operations = 1;
+    }
+
+    std::cout << operations << " operations, " << liveTarget << " resources alive at most, " << blockSize / (1024 * 1024) << " MB blocks" << std::endl;
+    std::cout << std::right << std::setw(12) << "granularity" << std::setw(14) << "alloc (ns)" << std::setw(12) << "free (ns)"
+              << std::setw(14) << "peak live" << std::setw(14) << "peak blocks" << std::setw(16) << "peak used %" << std::endl;
+
+    bool valid = true;
+    for (uint64_t granularity : { 1, 1024, 65536 }) {
+        Result verified = run(operations, granularity, true);
+        Result timed = run(operations, granularity, false);
+        valid = valid && verified.valid && timed.valid;
+
+        std::cout << std::setw(12) << granularity << std::fixed << std::setprecision(1)
+                  << std::setw(14) << timed.allocateNs / timed.allocations << std::setw(12) << timed.freeNs / std::max<uint64_t>(timed.frees, 1)
+                  << std::setw(14) << timed.peakLive << std::setw(14) << timed.peakBlocks
+                  << std::setw(16) << 100.0 * timed.peakUsed / timed.peakReserved << std::endl;
+    }
+    std::cout << "Peak live resources would each need a vkAllocateMemory call without sub-allocation, peak blocks is what's used instead" << std::endl;
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
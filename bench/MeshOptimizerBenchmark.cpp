@@ -0,0 +1,209 @@
+/*
+* Mesh optimization benchmark
+*
+* Runs the vertex cache, overdraw and vertex fetch passes of src/MeshOptimizer.cpp on generated meshes (a grid and a
+* sphere, both in scanline and in shuffled triangle order) and on any .obj or .mesh files passed on the command line.
+* Reports ACMR and ATVR of a simulated 16 entry FIFO cache before and after, the share of triangles the overdraw pass
+* moved to another position, and the time per pass. Every pass is
+* checked to keep the set of triangles and their winding, the fetch pass also to keep each triangle's vertices.
+*
+* Usage: mesh-optimizer-bench [mesh files]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/MeshOptimizer.hpp"
+
+namespace
+{
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : state(seed)
+        {}
+
+        uint32_t next()
+        {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        }
+
+    private:
+        uint32_t state;
+    };
+
+    double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    vks::Mesh createGrid(uint32_t side)
+    {
+        vks::Mesh mesh;
+        for (uint32_t y = 0; y < side; y++) {
+            for (uint32_t x = 0; x < side; x++) {
+                float u = float(x) / (side - 1);
+                float v = float(y) / (side - 1);
+                mesh.vertices.push_back({ { u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f }, { u, v, 1.0f } });
+            }
+        }
+        for (uint32_t y = 0; y + 1 < side; y++) {
+            for (uint32_t x = 0; x + 1 < side; x++) {
+                uint32_t i = y * side + x;
+                uint32_t quad[6] = { i, i + 1, i + side, i + 1, i + side + 1, i + side };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+        return mesh;
+    }
+
+    // Closed mesh, so half of it faces away from any viewer and the overdraw pass has something to order
+    vks::Mesh createSphere(uint32_t rings, uint32_t segments)
+    {
+        vks::Mesh mesh;
+        for (uint32_t r = 0; r <= rings; r++) {
+            float theta = float(M_PI) * r / rings;
+            for (uint32_t s = 0; s <= segments; s++) {
+                float phi = 2.0f * float(M_PI) * s / segments;
+                float x = std::sin(theta) * std::cos(phi);
+                float y = std::cos(theta);
+                float z = std::sin(theta) * std::sin(phi);
+                mesh.vertices.push_back({ { x, y, z }, { x * 0.5f + 0.5f, y * 0.5f + 0.5f, z * 0.5f + 0.5f } });
+            }
+        }
+        for (uint32_t r = 0; r < rings; r++) {
+            for (uint32_t s = 0; s < segments; s++) {
+                uint32_t i = r * (segments + 1) + s;
+                uint32_t quad[6] = { i, i + segments + 1, i + 1, i + 1, i + segments + 1, i + segments + 2 };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+        return mesh;
+    }
+
+    // Same triangles in random order, like a mesh exported without any care for the vertex cache
+    vks::Mesh shuffled(vks::Mesh mesh)
+    {
+        Random random(0x2545F491);
+        size_t triangleCount = mesh.indices.size() / 3;
+        for (size_t i = triangleCount - 1; i > 0; i--) {
+            size_t j = random.next() % (i + 1);
+            std::swap_ranges(mesh.indices.begin() + i * 3, mesh.indices.begin() + i * 3 + 3, mesh.indices.begin() + j * 3);
+        }
+        return mesh;
+    }
+
+    // Triangles rotated so the smallest index comes first, which keeps the winding, then sorted
+    std::vector<std::array<uint32_t, 3>> canonicalTriangles(const std::vector<uint32_t> & indices)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+        for (size_t t = 0; t < triangles.size(); t++) {
+            const uint32_t * i = &indices[t * 3];
+            int first = i[0] <= i[1] && i[0] <= i[2] ? 0 : (i[1] <= i[2] ? 1 : 2);
+            triangles[t] = { i[first], i[(first + 1) % 3], i[(first + 2) % 3] };
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    bool sameTriangles(const std::vector<uint32_t> & a, const std::vector<uint32_t> & b)
+    {
+        return a.size() == b.size() && canonicalTriangles(a) == canonicalTriangles(b);
+    }
+
+    // The fetch pass only renames vertices, every index has to point at a vertex equal to the one it pointed at before
+    bool sameVertices(const vks::Mesh & before, const vks::Mesh & after)
+    {
+        if (before.indices.size() != after.indices.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < before.indices.size(); i++) {
+            if (memcmp(&before.vertices[before.indices[i]], &after.vertices[after.indices[i]], sizeof(vks::MeshVertex)) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool run(const std::string & name, const vks::Mesh & source)
+    {
+        vks::Mesh mesh = source;
+        vks::VertexCacheStats before = vks::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        vks::optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        double cacheMs = elapsedMs(start);
+        vks::VertexCacheStats cache = vks::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        bool valid = sameTriangles(source.indices, mesh.indices);
+
+        std::vector<uint32_t> cacheOrder = mesh.indices;
+        start = std::chrono::high_resolution_clock::now();
+        vks::optimizeOverdraw(mesh.indices, mesh.vertices);
+        double overdrawMs = elapsedMs(start);
+        size_t moved = 0;
+        for (size_t i = 0; i < cacheOrder.size(); i += 3) {
+            moved += !std::equal(cacheOrder.begin() + i, cacheOrder.begin() + i + 3, mesh.indices.begin() + i);
+        }
+        vks::VertexCacheStats overdraw = vks::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        valid = valid && sameTriangles(source.indices, mesh.indices);
+
+        vks::Mesh ordered = mesh;
+        start = std::chrono::high_resolution_clock::now();
+        vks::optimizeVertexFetch(mesh);
+        double fetchMs = elapsedMs(start);
+        valid = valid && sameVertices(ordered, mesh);
+
+        double triangles = mesh.indices.size() / 3 / 1000000.0;
+        std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(8) << before.acmr << std::setw(8) << before.atvr
+                  << std::setw(8) << cache.acmr << std::setw(8) << cache.atvr
+                  << std::setw(8) << overdraw.acmr << std::setw(8) << overdraw.atvr
+                  << std::setprecision(1) << std::setw(8) << 100.0 * moved / (cacheOrder.size() / 3) << std::setw(10) << cacheMs << std::setw(10) << overdrawMs << std::setw(10) << fetchMs
+                  << std::setw(10) << triangles / ((cacheMs + overdrawMs + fetchMs) / 1000.0) << std::endl;
+        if (!valid) {
+            std::cerr << "Error: Optimizing " << name << " changed its triangles" << std::endl;
+        }
+        return valid;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::cout << "ACMR and ATVR of a " << vks::defaultCacheSize << " entry FIFO cache, pass times in ms" << std::endl;
+    std::cout << std::left << std::setw(18) << "mesh" << std::right << std::setw(16) << "input" << std::setw(16) << "vertex cache"
+              << std::setw(16) << "+ overdraw" << std::setw(8) << "moved%" << std::setw(10) << "cache" << std::setw(10) << "overdraw" << std::setw(10) << "fetch"
+              << std::setw(10) << "Mtris/s" << std::endl;
+
+    bool valid = true;
+    vks::Mesh grid = createGrid(1000);
+    vks::Mesh sphere = createSphere(500, 1000);
+    valid &= run("grid 1M", grid);
+    valid &= run("grid 1M shuffled", shuffled(grid));
+    valid &= run("sphere 500K", sphere);
+    valid &= run("sphere shuffled", shuffled(sphere));
+
+    for (int i = 1; i < argc; i++) {
+        vks::Mesh mesh;
+        if (!vks::loadMesh(argv[i], mesh)) {
+            valid = false;
+            continue;
+        }
+        std::string name = argv[i];
+        size_t separator = name.find_last_of('/');
+        valid &= run(separator == std::string::npos ? name : name.substr(separator + 1), mesh);
+    }
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,244 @@
+/*
+* Mesh upload benchmark
+*
+* Generates grid meshes with millions of vertices, writes them as .mesh and .obj files and measures how fast the
+* loaders in src/Mesh.cpp read them back. The loaded geometry is then staged the way vks::StagingRing does it, in
+* chunks through a 32 MB ring handed out by vks::RingAllocator with the copy regions of a batch applied at submit, and
+* compared with the previous path of one staging buffer per resource sized to fit all of it. Loaded and staged data is
+* checked against the generated mesh. No Vulkan device is required, the GPU copy is a memcpy.
+*
+* Usage: mesh-upload-bench [output directory] [million vertices]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/Mesh.hpp"
+#include "../src/RingAllocator.hpp"
+
+namespace
+{
+    // Matches vks::StagingRing::defaultSize and batchCount
+    const uint64_t ringSize = 32 * 1024 * 1024;
+    const uint32_t batchCount = 4;
+
+    struct Region
+    {
+        uint8_t * destination;
+        uint64_t ringOffset;
+        uint64_t size;
+    };
+
+    struct StagingResult
+    {
+        double ms = 0.0;
+        uint32_t submits = 0;
+        uint64_t regions = 0;
+        uint64_t peakStaging = 0;
+    };
+
+    double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Square grid of two triangles per cell, colored by position
+    vks::Mesh createGrid(uint32_t vertexCount)
+    {
+        uint32_t side = std::max<uint32_t>(2, static_cast<uint32_t>(std::sqrt(double(vertexCount))));
+        vks::Mesh mesh;
+        mesh.vertices.reserve(size_t(side) * side);
+        for (uint32_t y = 0; y < side; y++) {
+            for (uint32_t x = 0; x < side; x++) {
+                float u = float(x) / (side - 1);
+                float v = float(y) / (side - 1);
+                mesh.vertices.push_back({ { u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.25f * u * v }, { u, v, 1.0f - u } });
+            }
+        }
+        mesh.indices.reserve(size_t(side - 1) * (side - 1) * 6);
+        for (uint32_t y = 0; y + 1 < side; y++) {
+            for (uint32_t x = 0; x + 1 < side; x++) {
+                uint32_t i = y * side + x;
+                uint32_t quad[6] = { i, i + 1, i + side, i + 1, i + side + 1, i + side };
+                mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+            }
+        }
+        return mesh;
+    }
+
+    // Floats are printed with enough digits to round trip exactly, so the loaded mesh can be compared bit for bit
+    bool saveObj(const std::string & filename, const vks::Mesh & mesh)
+    {
+        FILE * file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        for (const vks::MeshVertex & vertex : mesh.vertices) {
+            fprintf(file, "v %.9g %.9g %.9g %.9g %.9g %.9g\n", vertex.position[0], vertex.position[1], vertex.position[2],
+                    vertex.color[0], vertex.color[1], vertex.color[2]);
+        }
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            fprintf(file, "f %u %u %u\n", mesh.indices[i] + 1, mesh.indices[i + 1] + 1, mesh.indices[i + 2] + 1);
+        }
+        return fclose(file) == 0;
+    }
+
+    bool equal(const vks::Mesh & a, const vks::Mesh & b)
+    {
+        return a.vertices.size() == b.vertices.size() && a.indices == b.indices
+            && memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(vks::MeshVertex)) == 0;
+    }
+
+    // Mirrors StagingRing::upload and submit, a batch is submitted once it holds a quarter of the ring and its ranges are
+    // released right away, as if the GPU kept up
+    void stageThroughRing(std::vector<uint8_t> & ring, vks::RingAllocator & allocator, uint8_t * destination, const uint8_t * source,
+                          uint64_t size, std::vector<Region> & batch, uint64_t & staged, StagingResult & result)
+    {
+        uint64_t batchSize = allocator.size() / batchCount;
+        while (size > 0) {
+            uint64_t chunk = std::min(size, batchSize - staged);
+            uint64_t offset = 0;
+            if (!allocator.allocate(chunk, 64, offset)) {
+                std::cerr << "Error: Ring allocation of " << chunk << " bytes failed with every batch released" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            memcpy(ring.data() + offset, source, chunk);
+            batch.push_back({ destination, offset, chunk });
+            staged += chunk;
+            source += chunk;
+            destination += chunk;
+            size -= chunk;
+
+            if (staged >= batchSize) {
+                for (const Region & region : batch) {
+                    memcpy(region.destination, ring.data() + region.ringOffset, region.size);
+                }
+                result.regions += batch.size();
+                result.submits++;
+                batch.clear();
+                staged = 0;
+                allocator.release(allocator.head());
+            }
+        }
+    }
+
+    StagingResult stageRing(const vks::Mesh & mesh, std::vector<uint8_t> & vertexBuffer, std::vector<uint8_t> & indexBuffer)
+    {
+        StagingResult result;
+        std::vector<uint8_t> ring(ringSize);
+        vks::RingAllocator allocator(ringSize);
+        std::vector<Region> batch;
+        uint64_t staged = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        stageThroughRing(ring, allocator, vertexBuffer.data(), reinterpret_cast<const uint8_t *>(mesh.vertices.data()), vertexBuffer.size(), batch, staged, result);
+        stageThroughRing(ring, allocator, indexBuffer.data(), reinterpret_cast<const uint8_t *>(mesh.indices.data()), indexBuffer.size(), batch, staged, result);
+        for (const Region & region : batch) {
+            memcpy(region.destination, ring.data() + region.ringOffset, region.size);
+        }
+        if (!batch.empty()) {
+            result.regions += batch.size();
+            result.submits++;
+        }
+        result.ms = elapsedMs(start);
+        result.peakStaging = ringSize;
+        return result;
+    }
+
+    // The previous path, a staging buffer per resource that is allocated, filled, copied and freed
+    StagingResult stagePerResource(const vks::Mesh & mesh, std::vector<uint8_t> & vertexBuffer, std::vector<uint8_t> & indexBuffer)
+    {
+        StagingResult result;
+        auto start = std::chrono::high_resolution_clock::now();
+        const void * sources[2] = { mesh.vertices.data(), mesh.indices.data() };
+        std::vector<uint8_t> * destinations[2] = { &vertexBuffer, &indexBuffer };
+        for (int i = 0; i < 2; i++) {
+            std::vector<uint8_t> staging(destinations[i]->size());
+            memcpy(staging.data(), sources[i], staging.size());
+            memcpy(destinations[i]->data(), staging.data(), staging.size());
+            result.peakStaging = std::max<uint64_t>(result.peakStaging, staging.size());
+            result.regions++;
+        }
+        result.submits = 1;
+        result.ms = elapsedMs(start);
+        return result;
+    }
+
+    bool matches(const vks::Mesh & mesh, const std::vector<uint8_t> & vertexBuffer, const std::vector<uint8_t> & indexBuffer)
+    {
+        return memcmp(vertexBuffer.data(), mesh.vertices.data(), vertexBuffer.size()) == 0
+            && memcmp(indexBuffer.data(), mesh.indices.data(), indexBuffer.size()) == 0;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::string outputPath = argc > 1 ? argv[1] : ".";
+    double millions = argc > 2 ? std::strtod(argv[2], nullptr) : 4.0;
+    if (millions <= 0.0) {
+        millions = 1.0;
+    }
+
+    bool valid = true;
+    std::cout << std::fixed << std::setprecision(1);
+    for (double scale : { 0.25, 1.0 }) {
+        vks::Mesh mesh = createGrid(static_cast<uint32_t>(millions * scale * 1000000.0));
+        double vertexMillions = mesh.vertices.size() / 1000000.0;
+        double megabytes = (mesh.vertices.size() * sizeof(vks::MeshVertex) + mesh.indices.size() * sizeof(uint32_t)) / (1024.0 * 1024.0);
+        std::cout << vertexMillions << "M vertices, " << mesh.indices.size() / 3 / 1000000.0 << "M triangles, " << megabytes << " MB" << std::endl;
+
+        std::string binaryFilename = outputPath + "/mesh-upload-bench.mesh";
+        std::string objFilename = outputPath + "/mesh-upload-bench.obj";
+        if (!vks::saveBinaryMesh(binaryFilename, mesh) || !saveObj(objFilename, mesh)) {
+            std::cerr << "Error: Could not write the meshes to " << outputPath << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const char * names[2] = { "load .mesh", "load .obj" };
+        const std::string * filenames[2] = { &binaryFilename, &objFilename };
+        for (int i = 0; i < 2; i++) {
+            vks::Mesh loaded;
+            auto start = std::chrono::high_resolution_clock::now();
+            bool loadedOk = vks::loadMesh(*filenames[i], loaded);
+            double ms = elapsedMs(start);
+            if (!loadedOk || !equal(mesh, loaded)) {
+                std::cerr << "Error: " << *filenames[i] << " does not load back as the generated mesh" << std::endl;
+                valid = false;
+            }
+            std::cout << "  " << std::left << std::setw(22) << names[i] << std::right << std::setw(10) << ms << " ms"
+                      << std::setw(10) << vertexMillions / (ms / 1000.0) << " Mvertices/s" << std::endl;
+        }
+        remove(binaryFilename.c_str());
+        remove(objFilename.c_str());
+
+        std::vector<uint8_t> vertexBuffer(mesh.vertices.size() * sizeof(vks::MeshVertex));
+        std::vector<uint8_t> indexBuffer(mesh.indices.size() * sizeof(uint32_t));
+        const char * stagingNames[2] = { "stage per resource", "stage through ring" };
+        for (int i = 0; i < 2; i++) {
+            std::fill(vertexBuffer.begin(), vertexBuffer.end(), 0);
+            std::fill(indexBuffer.begin(), indexBuffer.end(), 0);
+            StagingResult result = i == 0 ? stagePerResource(mesh, vertexBuffer, indexBuffer) : stageRing(mesh, vertexBuffer, indexBuffer);
+            if (!matches(mesh, vertexBuffer, indexBuffer)) {
+                std::cerr << "Error: " << stagingNames[i] << " did not reproduce the mesh" << std::endl;
+                valid = false;
+            }
+            std::cout << "  " << std::left << std::setw(22) << stagingNames[i] << std::right << std::setw(10) << result.ms << " ms"
+                      << std::setw(10) << megabytes / (result.ms / 1000.0) << " MB/s, " << result.submits << " submits, "
+                      << result.regions << " regions, " << result.peakStaging / (1024.0 * 1024.0) << " MB staging memory" << std::endl;
+        }
+    }
+    std::cout << "The ring bounds staging memory and lets the GPU copy one batch while the next is filled, the per resource path needs"
+              << " staging memory for the whole mesh and waits for the copy" << std::endl;
+
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,145 @@
+/*
+* Pixel conversion kernel benchmark
+*
+* Verifies every vectorized kernel supported by the running cpu bit-for-bit against the scalar reference
+* (including odd lengths, unaligned pointers and writes past the end of the destination) and then measures
+* the conversion throughput of each kernel on a 4K image
+*
+* Usage: pixel-conversion-bench [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/PixelConversion.hpp"
+
+using vks::pixels::Isa;
+using vks::pixels::PixelLayout;
+
+namespace
+{
+    const PixelLayout layouts[] = { PixelLayout::R8G8B8A8, PixelLayout::B8G8R8A8, PixelLayout::A2B10G10R10, PixelLayout::A2R10G10B10 };
+    const Isa isas[] = { Isa::Scalar, Isa::SSSE3, Isa::AVX2, Isa::NEON };
+
+    // Guard bytes placed behind the destination to catch kernels writing past the end
+    const size_t guardSize = 64;
+    const uint8_t guardValue = 0xCD;
+
+    std::vector<uint8_t> createTexels(size_t count)
+    {
+        std::vector<uint8_t> texels(count * 4);
+        uint32_t seed = 0x9E3779B9;
+        for (auto & byte : texels) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            byte = uint8_t(seed);
+        }
+        return texels;
+    }
+
+    bool verify(PixelLayout layout, Isa isa, const std::vector<uint8_t> & texels)
+    {
+        vks::pixels::ConvertFunction reference = vks::pixels::getKernel(layout, Isa::Scalar);
+        vks::pixels::ConvertFunction kernel = vks::pixels::getKernel(layout, isa);
+
+        std::vector<uint32_t> counts;
+        for (uint32_t count = 0; count <= 130; count++) {
+            counts.push_back(count);
+        }
+        counts.push_back(800);
+        counts.push_back(1921);
+        counts.push_back(3840);
+
+        for (uint32_t count : counts) {
+            for (uint32_t srcOffset = 0; srcOffset < 4; srcOffset++) {
+                for (uint32_t dstOffset = 0; dstOffset < 4; dstOffset++) {
+                    std::vector<uint8_t> expected(dstOffset + count * 3 + guardSize, guardValue);
+                    std::vector<uint8_t> actual(expected.size(), guardValue);
+                    reference(texels.data() + srcOffset, expected.data() + dstOffset, count);
+                    kernel(texels.data() + srcOffset, actual.data() + dstOffset, count);
+                    if (expected != actual) {
+                        std::cerr << "Error: " << vks::pixels::isaName(isa) << " kernel for " << vks::pixels::layoutName(layout)
+                                  << " differs from the scalar reference (count " << count
+                                  << ", source offset " << srcOffset << ", destination offset " << dstOffset << ")" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    double measure(vks::pixels::ConvertFunction kernel, const std::vector<uint8_t> & texels, std::vector<uint8_t> & rgb, uint32_t iterations)
+    {
+        uint32_t count = static_cast<uint32_t>(texels.size() / 4);
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            kernel(texels.data(), rgb.data(), count);
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = argc > 1 ? (uint32_t) std::strtoul(argv[1], nullptr, 10) : 10;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    std::cout << "Runtime selected kernel: " << vks::pixels::isaName(vks::pixels::bestIsa()) << std::endl;
+
+    // Verification
+    std::vector<uint8_t> verifyTexels = createTexels(4096);
+    bool passed = true;
+    for (PixelLayout layout : layouts) {
+        for (Isa isa : isas) {
+            if (isa == Isa::Scalar || !vks::pixels::isaSupported(isa)) {
+                continue;
+            }
+            passed &= verify(layout, isa, verifyTexels);
+        }
+    }
+    std::cout << "Verification against scalar reference: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    // Throughput on a 4K image
+    const uint32_t width = 3840;
+    const uint32_t height = 2160;
+    std::vector<uint8_t> texels = createTexels(size_t(width) * height);
+    std::vector<uint8_t> rgb(size_t(width) * height * 3);
+    const double megaBytes = double(texels.size()) / (1024.0 * 1024.0);
+
+    std::cout << "Best of " << iterations << " iterations, " << width << "x" << height << std::endl;
+    std::cout << std::left << std::setw(14) << "layout" << std::setw(10) << "kernel"
+              << std::right << std::setw(10) << "ms" << std::setw(12) << "MB/s" << std::setw(10) << "speedup" << std::endl;
+    for (PixelLayout layout : layouts) {
+        double scalarMs = 0.0;
+        for (Isa isa : isas) {
+            vks::pixels::ConvertFunction kernel = vks::pixels::getKernel(layout, isa);
+            if (!kernel) {
+                continue;
+            }
+            double ms = measure(kernel, texels, rgb, iterations);
+            if (isa == Isa::Scalar) {
+                scalarMs = ms;
+            }
+            std::cout << std::left << std::setw(14) << vks::pixels::layoutName(layout) << std::setw(10) << vks::pixels::isaName(isa)
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(10) << ms << std::setw(12) << megaBytes / (ms / 1000.0) << std::setw(9) << scalarMs / ms << "x" << std::endl;
+        }
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,133 @@
+/*
+* Striped image writer benchmark
+*
+* Compares the single threaded vks::image::writePPM with vks::image::writePPMStriped at 1, 2, 4 and 8 threads
+* on synthetic 4K and 8K mapped buffers and checks that every variant writes the same file. No Vulkan device
+* is required. The speedup is bounded by the number of cores and by how fast the disk takes the data.
+*
+* Usage: striped-writer-bench [output directory] [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/ImageWriter.hpp"
+#include "../src/ThreadPool.hpp"
+
+namespace
+{
+    struct Resolution
+    {
+        const char * name;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // Row pitch alignment as commonly reported for linear images
+    const uint64_t rowPitchAlignment = 256;
+
+    // Fill a buffer the way a mapped linear image would look like, including row padding
+    std::vector<uint8_t> createMappedBuffer(uint32_t height, uint64_t rowPitch)
+    {
+        std::vector<uint8_t> buffer(rowPitch * height);
+        uint32_t seed = 0x12345678;
+        for (auto & byte : buffer) {
+            seed = seed * 1664525u + 1013904223u;
+            byte = uint8_t(seed >> 24);
+        }
+        return buffer;
+    }
+
+    std::vector<char> readFile(const std::string & filename)
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    template<typename Function>
+    double measure(uint32_t iterations, Function function)
+    {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::string outputPath = argc > 1 ? argv[1] : ".";
+    uint32_t iterations = argc > 2 ? (uint32_t) std::strtoul(argv[2], nullptr, 10) : 3;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    const std::vector<Resolution> resolutions = {
+        { "4K", 3840, 2160 },
+        { "8K", 7680, 4320 },
+    };
+    const std::vector<uint32_t> threadCounts = { 1, 2, 4, 8 };
+
+    std::string referenceFile = outputPath + "/bench_reference.ppm";
+    std::string stripedFile = outputPath + "/bench_striped.ppm";
+
+    std::cout << "Best of " << iterations << " iterations, " << vks::ThreadPool::defaultThreadCount() << " hardware threads" << std::endl;
+    std::cout << std::left << std::setw(10) << "size" << std::setw(10) << "threads"
+              << std::right << std::setw(14) << "time (ms)" << std::setw(12) << "MB/s" << std::setw(10) << "speedup" << std::endl;
+
+    bool identical = true;
+    for (auto & resolution : resolutions) {
+        uint64_t rowPitch = (uint64_t(resolution.width) * 4 + rowPitchAlignment - 1) / rowPitchAlignment * rowPitchAlignment;
+        std::vector<uint8_t> buffer = createMappedBuffer(resolution.height, rowPitch);
+        double megabytes = vks::image::ppmFileSize(resolution.width, resolution.height) / (1024.0 * 1024.0);
+
+        vks::image::MappedImage image;
+        image.data = buffer.data();
+        image.width = resolution.width;
+        image.height = resolution.height;
+        image.rowPitch = rowPitch;
+        image.layout = vks::pixels::PixelLayout::B8G8R8A8;
+
+        double referenceMs = measure(iterations, [&] { vks::image::writePPM(referenceFile.c_str(), image); });
+        std::vector<char> reference = readFile(referenceFile);
+
+        std::cout << std::left << std::setw(10) << resolution.name << std::setw(10) << "writePPM"
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(14) << referenceMs << std::setw(12) << megabytes / (referenceMs / 1000.0) << std::setw(9) << 1.0 << "x" << std::endl;
+
+        for (uint32_t threadCount : threadCounts) {
+            vks::ThreadPool pool(threadCount);
+            double stripedMs = measure(iterations, [&] { vks::image::writePPMStriped(stripedFile.c_str(), image, pool); });
+
+            if (readFile(stripedFile) != reference) {
+                std::cerr << "Error: Output of the striped writer differs for " << resolution.name << " with " << threadCount << " threads" << std::endl;
+                identical = false;
+            }
+
+            std::cout << std::left << std::setw(10) << resolution.name << std::setw(10) << threadCount
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(14) << stripedMs << std::setw(12) << megabytes / (stripedMs / 1000.0) << std::setw(9) << referenceMs / stripedMs << "x" << std::endl;
+        }
+    }
+
+    std::remove(referenceFile.c_str());
+    std::remove(stripedFile.c_str());
+
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
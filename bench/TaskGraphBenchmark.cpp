@@ -0,0 +1,166 @@
+/*
+* Task graph benchmark
+*
+* Checks that src/TaskGraph.cpp runs every task exactly once, after all of its dependencies and main thread tasks on
+* the calling thread, then measures the scheduling overhead per task on a long chain and a wide fan, and the time to
+* run a graph shaped like prepare() (a chain of swapchain setup steps next to pipeline compilation and uploads, with
+* busy waits standing in for the work) with 1 to 8 threads, next to its critical path.
+*
+* Usage: task-graph-bench [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/TaskGraph.hpp"
+
+namespace
+{
+    void spin(double ms)
+    {
+        auto end = std::chrono::high_resolution_clock::now() + std::chrono::duration<double, std::milli>(ms);
+        while (std::chrono::high_resolution_clock::now() < end) {
+        }
+    }
+
+    // Random graph where every task records when it ran, compared against the finishing order of its dependencies
+    bool verify(uint32_t threadCount)
+    {
+        const uint32_t taskCount = 500;
+        std::atomic<uint32_t> clock { 0 };
+        std::vector<uint32_t> started(taskCount, 0);
+        std::vector<uint32_t> finished(taskCount, 0);
+        std::vector<uint32_t> runs(taskCount, 0);
+        std::vector<std::vector<uint32_t>> dependencies(taskCount);
+        std::vector<bool> mainThreadTasks(taskCount);
+        const std::thread::id mainThread = std::this_thread::get_id();
+        std::atomic<bool> wrongThread { false };
+
+        vks::TaskGraph graph;
+        uint32_t state = 0x2545F491;
+        for (uint32_t id = 0; id < taskCount; id++) {
+            for (uint32_t i = 0; id > 0 && i < 3; i++) {
+                state = state * 1664525u + 1013904223u;
+                dependencies[id].push_back((state >> 8) % id);
+            }
+            std::sort(dependencies[id].begin(), dependencies[id].end());
+            dependencies[id].erase(std::unique(dependencies[id].begin(), dependencies[id].end()), dependencies[id].end());
+            mainThreadTasks[id] = id % 17 == 0;
+            graph.add("task", [&, id] {
+                started[id] = ++clock;
+                runs[id]++;
+                if (mainThreadTasks[id] && std::this_thread::get_id() != mainThread) {
+                    wrongThread = true;
+                }
+                finished[id] = ++clock;
+            }, dependencies[id], mainThreadTasks[id]);
+        }
+        graph.run(threadCount);
+
+        for (uint32_t id = 0; id < taskCount; id++) {
+            if (runs[id] != 1) {
+                std::cerr << "Error: Task " << id << " ran " << runs[id] << " times with " << threadCount << " threads" << std::endl;
+                return false;
+            }
+            for (uint32_t dependency : dependencies[id]) {
+                if (finished[dependency] > started[id]) {
+                    std::cerr << "Error: Task " << id << " started before its dependency " << dependency << " finished" << std::endl;
+                    return false;
+                }
+            }
+        }
+        if (wrongThread) {
+            std::cerr << "Error: A main thread task ran on a worker with " << threadCount << " threads" << std::endl;
+        }
+        return !wrongThread;
+    }
+
+    // Microseconds per task of a graph of empty tasks, best of a few runs
+    double overhead(bool chain, uint32_t threadCount, uint32_t iterations)
+    {
+        const uint32_t taskCount = 10000;
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            vks::TaskGraph graph;
+            for (uint32_t id = 0; id < taskCount; id++) {
+                graph.add("empty", [] {}, chain && id > 0 ? std::vector<vks::TaskGraph::TaskId> { id - 1 } : std::vector<vks::TaskGraph::TaskId> {});
+            }
+            graph.run(threadCount);
+            double us = graph.elapsedMs() * 1000.0 / taskCount;
+            best = i == 0 ? us : std::min(best, us);
+        }
+        return best;
+    }
+
+    // Durations in ms loosely after a headless run with a cold pipeline cache and a large mesh
+    void buildPrepareGraph(vks::TaskGraph & graph)
+    {
+        auto swapchain = graph.add("swapchain", [] { spin(3.0); }, {}, true);
+        graph.add("frameSync", [] { spin(0.2); });
+        auto renderPass = graph.add("renderPass", [] { spin(0.3); }, { swapchain });
+        auto frameBuffers = graph.add("frameBuffers", [] { spin(0.5); }, { renderPass });
+        auto vertices = graph.add("vertices", [] { spin(12.0); }, { swapchain });
+        auto uniforms = graph.add("uniforms", [] { spin(0.5); }, { swapchain });
+        auto layouts = graph.add("descriptorSetLayout", [] { spin(0.2); });
+        auto cache = graph.add("pipelineCache", [] { spin(1.0); });
+        auto pipelines = graph.add("pipelines", [] { spin(15.0); }, { renderPass, layouts, cache });
+        auto pool = graph.add("descriptorPool", [] { spin(0.1); });
+        auto descriptorSet = graph.add("descriptorSet", [] { spin(0.1); }, { pool, layouts, uniforms });
+        auto profiler = graph.add("profiler", [] { spin(0.5); }, { swapchain });
+        graph.add("commandBuffers", [] { spin(1.0); }, { frameBuffers, pipelines, descriptorSet, vertices, uniforms, profiler });
+        graph.add("screenshotWorker", [] { spin(0.3); });
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = argc > 1 ? (uint32_t) std::strtoul(argv[1], nullptr, 10) : 5;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    bool passed = true;
+    for (uint32_t threadCount : { 1u, 2u, 4u, 8u }) {
+        passed &= verify(threadCount);
+    }
+    std::cout << "Verification of run counts, dependency order and main thread tasks: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    std::cout << "Scheduling overhead (us per empty task, best of " << iterations << "):" << std::endl;
+    std::cout << std::right << std::setw(10) << "threads" << std::setw(10) << "chain" << std::setw(10) << "fan" << std::endl;
+    for (uint32_t threadCount : { 1u, 2u, 4u, 8u }) {
+        std::cout << std::setw(10) << threadCount << std::fixed << std::setprecision(2)
+                  << std::setw(10) << overhead(true, threadCount, iterations) << std::setw(10) << overhead(false, threadCount, iterations) << std::endl;
+    }
+
+    std::cout << "prepare() shaped graph (ms, best of " << iterations << "):" << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(10) << "elapsed" << std::setw(16) << "critical path" << std::setw(10) << "speedup" << std::endl;
+    double serialMs = 0.0;
+    for (uint32_t threadCount : { 1u, 2u, 3u, 4u, 8u }) {
+        double best = 0.0;
+        double criticalPath = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            vks::TaskGraph graph;
+            buildPrepareGraph(graph);
+            graph.run(threadCount);
+            if (i == 0 || graph.elapsedMs() < best) {
+                best = graph.elapsedMs();
+                criticalPath = graph.criticalPathMs();
+            }
+        }
+        if (threadCount == 1) {
+            serialMs = best;
+        }
+        std::cout << std::setw(10) << threadCount << std::setprecision(2) << std::setw(10) << best << std::setw(16) << criticalPath
+                  << std::setw(9) << serialMs / best << "x" << std::endl;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+/*
+* Vertex packing kernel benchmark
+*
+* Verifies every vectorized packing kernel supported by the running cpu bit-for-bit against the scalar reference,
+* including values that round to denormal halves, overflow or saturate, and checks the round trip error of the
+* half and snorm16 formats on a fitted mesh against the precision of the format. Then measures the packing throughput
+* on a mesh of four million vertices and reports the vertex and index memory of each format.
+*
+* Usage: vertex-packing-bench [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/VertexPacking.hpp"
+
+using vks::vertices::Isa;
+using vks::vertices::VertexFormat;
+
+namespace
+{
+    const VertexFormat formats[] = { VertexFormat::Half, VertexFormat::Snorm16 };
+    const Isa isas[] = { Isa::Scalar, Isa::F16C, Isa::NEON };
+
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed)
+            : state(seed)
+        {}
+
+        // Uniform in [low, high)
+        float next(float low, float high)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return low + (high - low) * float(state >> 8) / float(1u << 24);
+        }
+
+    private:
+        uint32_t state;
+    };
+
+    // Positions within the unit cube the renderer fits meshes into
+    std::vector<vks::MeshVertex> createVertices(size_t count)
+    {
+        std::vector<vks::MeshVertex> vertices(count);
+        Random random(0x9E3779B9);
+        for (auto & vertex : vertices) {
+            for (int axis = 0; axis < 3; axis++) {
+                vertex.position[axis] = random.next(-1.0f, 1.0f);
+                vertex.color[axis] = random.next(0.0f, 1.0f);
+            }
+        }
+        return vertices;
+    }
+
+    // Magnitudes across the whole half range and beyond, colors and positions outside of the ranges they are clamped to
+    std::vector<vks::MeshVertex> createEdgeVertices()
+    {
+        std::vector<float> values = { 0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 1.0f / 3.0f, 65504.0f, 65519.0f, 65520.0f, 70000.0f, 1e30f,
+                                      INFINITY, -INFINITY, 6.1e-5f, 6.0e-5f, 3.0e-8f, 2.9e-8f, 1e-10f, 1.0000001f, -1.0000001f, 2.0f, -2.0f };
+        Random random(0x12345678);
+        for (int i = 0; i < 4096; i++) {
+            values.push_back(std::ldexp(random.next(-1.0f, 1.0f), static_cast<int>(random.next(-30.0f, 20.0f))));
+        }
+
+        std::vector<vks::MeshVertex> vertices(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                vertices[i].position[axis] = values[(i + axis) % values.size()];
+                vertices[i].color[axis] = values[(i + axis + 7) % values.size()];
+            }
+        }
+        return vertices;
+    }
+
+    bool verify(VertexFormat format, Isa isa, const std::vector<vks::MeshVertex> & vertices)
+    {
+        vks::vertices::PackFunction reference = vks::vertices::getKernel(format, Isa::Scalar);
+        vks::vertices::PackFunction kernel = vks::vertices::getKernel(format, isa);
+
+        std::vector<vks::vertices::CompactVertex> expected(vertices.size());
+        std::vector<vks::vertices::CompactVertex> actual(vertices.size());
+        reference(vertices.data(), expected.data(), static_cast<uint32_t>(vertices.size()));
+        kernel(vertices.data(), actual.data(), static_cast<uint32_t>(vertices.size()));
+        for (size_t i = 0; i < vertices.size(); i++) {
+            if (memcmp(&expected[i], &actual[i], sizeof(vks::vertices::CompactVertex)) != 0) {
+                std::cerr << "Error: " << vks::vertices::isaName(isa) << " kernel for " << vks::vertices::formatName(format)
+                          << " differs from the scalar reference for vertex " << i << " (" << vertices[i].position[0] << ", "
+                          << vertices[i].position[1] << ", " << vertices[i].position[2] << ")" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Half floats keep 11 significant bits, half an ulp in [0.5, 1) is 2^-12. Snorm16 steps are 1/32767 over the whole range
+    bool verifyRoundTrip(VertexFormat format, const std::vector<vks::MeshVertex> & vertices, double & maxPositionError, double & maxColorError)
+    {
+        std::vector<vks::vertices::CompactVertex> packed(vertices.size());
+        std::vector<vks::MeshVertex> unpacked(vertices.size());
+        vks::vertices::pack(format, vertices.data(), packed.data(), static_cast<uint32_t>(vertices.size()));
+        vks::vertices::unpack(format, packed.data(), unpacked.data(), static_cast<uint32_t>(vertices.size()));
+
+        maxPositionError = 0.0;
+        maxColorError = 0.0;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                maxPositionError = std::max(maxPositionError, std::fabs(double(vertices[i].position[axis]) - unpacked[i].position[axis]));
+                maxColorError = std::max(maxColorError, std::fabs(double(vertices[i].color[axis]) - unpacked[i].color[axis]));
+            }
+        }
+        double positionBound = format == VertexFormat::Half ? std::ldexp(1.0, -12) : 0.5 / 32767.0;
+        double colorBound = 0.5 / 255.0;
+        // Allow for the rounding of the float multiplication before the conversion, a float ulp at 1
+        double slack = std::ldexp(1.0, -23);
+        return maxPositionError <= positionBound + slack && maxColorError <= colorBound + slack;
+    }
+
+    double measure(vks::vertices::PackFunction kernel, const std::vector<vks::MeshVertex> & vertices,
+                   std::vector<vks::vertices::CompactVertex> & packed, uint32_t iterations)
+    {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            kernel(vertices.data(), packed.data(), static_cast<uint32_t>(vertices.size()));
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t iterations = argc > 1 ? (uint32_t) std::strtoul(argv[1], nullptr, 10) : 10;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    std::cout << "Runtime selected kernel: " << vks::vertices::isaName(vks::vertices::bestIsa()) << std::endl;
+
+    // Verification
+    std::vector<vks::MeshVertex> edgeVertices = createEdgeVertices();
+    std::vector<vks::MeshVertex> fittedVertices = createVertices(100000);
+    bool passed = true;
+    for (VertexFormat format : formats) {
+        for (Isa isa : isas) {
+            if (isa == Isa::Scalar || !vks::vertices::isaSupported(isa)) {
+                continue;
+            }
+            passed &= verify(format, isa, edgeVertices);
+            passed &= verify(format, isa, fittedVertices);
+        }
+    }
+    std::cout << "Verification against scalar reference: " << (passed ? "passed" : "FAILED") << std::endl;
+
+    for (VertexFormat format : formats) {
+        double positionError, colorError;
+        bool withinBounds = verifyRoundTrip(format, fittedVertices, positionError, colorError);
+        passed &= withinBounds;
+        std::cout << "Round trip " << std::left << std::setw(8) << vks::vertices::formatName(format) << std::right << std::scientific
+                  << std::setprecision(2) << " max position error " << positionError << ", max color error " << colorError
+                  << (withinBounds ? "" : " EXCEEDS THE FORMAT PRECISION") << std::endl;
+    }
+
+    // Throughput on four million vertices
+    std::vector<vks::MeshVertex> vertices = createVertices(4 * 1024 * 1024);
+    std::vector<vks::vertices::CompactVertex> packed(vertices.size());
+    const double megaBytes = double(vertices.size() * sizeof(vks::MeshVertex)) / (1024.0 * 1024.0);
+
+    std::cout << "Best of " << iterations << " iterations, " << vertices.size() << " vertices" << std::endl;
+    std::cout << std::left << std::setw(10) << "format" << std::setw(10) << "kernel"
+              << std::right << std::setw(10) << "ms" << std::setw(12) << "MB/s" << std::setw(10) << "speedup" << std::endl;
+    for (VertexFormat format : formats) {
+        double scalarMs = 0.0;
+        for (Isa isa : isas) {
+            vks::vertices::PackFunction kernel = vks::vertices::getKernel(format, isa);
+            if (!kernel) {
+                continue;
+            }
+            double ms = measure(kernel, vertices, packed, iterations);
+            if (isa == Isa::Scalar) {
+                scalarMs = ms;
+            }
+            std::cout << std::left << std::setw(10) << vks::vertices::formatName(format) << std::setw(10) << vks::vertices::isaName(isa)
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(10) << ms << std::setw(12) << megaBytes / (ms / 1000.0) << std::setw(9) << scalarMs / ms << "x" << std::endl;
+        }
+    }
+
+    // Memory of a grid mesh, two triangles per vertex, with 32 bit and, where they fit, 16 bit indices
+    std::cout << "Vertex and index memory:" << std::endl;
+    for (uint64_t vertexCount : { uint64_t(65536), uint64_t(4 * 1024 * 1024) }) {
+        uint64_t indexCount = vertexCount * 6;
+        uint32_t indexSize = vks::vertices::fitsShortIndices(vertexCount) ? 2 : 4;
+        double floatMB = (vertexCount * vks::vertices::vertexStride(VertexFormat::Float32) + indexCount * 4) / (1024.0 * 1024.0);
+        double compactMB = (vertexCount * vks::vertices::vertexStride(VertexFormat::Snorm16) + indexCount * indexSize) / (1024.0 * 1024.0);
+        std::cout << "  " << vertexCount << " vertices: " << floatMB << " MB as float with 32 bit indices, " << compactMB << " MB compact with "
+                  << indexSize * 8 << " bit indices (" << 100.0 * compactMB / floatMB << "%)" << std::endl;
+    }
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,165 @@
+/*
+* Zero copy image writer benchmark
+*
+* Compares writing through a stream with the write paths that skip intermediate copies: converting straight into
+* a memory mapped ppm (vks::image::writePPMMapped) and handing R8G8B8A8 rows to the kernel without conversion as
+* a pam (vks::image::writePAMDirect). Runs on synthetic 4K and 8K mapped buffers, with and without row padding,
+* and checks that each zero copy path writes the same file as its stream counterpart. No Vulkan device is required.
+*
+* Usage: zero-copy-writer-bench [output directory] [iterations]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/ImageEncoder.hpp"
+#include "../src/ImageWriter.hpp"
+#include "../src/ThreadPool.hpp"
+
+namespace
+{
+    struct Resolution
+    {
+        const char * name;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct WritePath
+    {
+        const char * name;
+        /** @brief Name of the path whose output has to match, nullptr for the reference of a format */
+        const char * reference;
+        std::function<bool(const char *, const vks::image::MappedImage &)> write;
+    };
+
+    // Row pitch alignment as commonly reported for linear images
+    const uint64_t rowPitchAlignment = 256;
+
+    // Fill a buffer the way a mapped linear image would look like, including row padding
+    std::vector<uint8_t> createMappedBuffer(uint32_t height, uint64_t rowPitch)
+    {
+        std::vector<uint8_t> buffer(rowPitch * height);
+        uint32_t seed = 0x12345678;
+        for (auto & byte : buffer) {
+            seed = seed * 1664525u + 1013904223u;
+            byte = uint8_t(seed >> 24);
+        }
+        return buffer;
+    }
+
+    std::vector<char> readFile(const std::string & filename)
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    template<typename Function>
+    double measure(uint32_t iterations, Function function)
+    {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            function();
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(end - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    std::string outputPath = argc > 1 ? argv[1] : ".";
+    uint32_t iterations = argc > 2 ? (uint32_t) std::strtoul(argv[2], nullptr, 10) : 3;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    const std::vector<Resolution> resolutions = {
+        { "4K", 3840, 2160 },
+        { "8K", 7680, 4320 },
+    };
+
+    vks::ThreadPool pool;
+    vks::image::PAMEncoder pamEncoder;
+    const std::vector<WritePath> writePaths = {
+        { "ppm stream", nullptr, [](const char * filename, const vks::image::MappedImage & image) {
+            return vks::image::writePPM(filename, image);
+        } },
+        { "ppm mmap", "ppm stream", [](const char * filename, const vks::image::MappedImage & image) {
+            return vks::image::writePPMMapped(filename, image);
+        } },
+        { "ppm mmap mt", "ppm stream", [&](const char * filename, const vks::image::MappedImage & image) {
+            return vks::image::writePPMMapped(filename, image, &pool);
+        } },
+        { "pam stream", nullptr, [&](const char * filename, const vks::image::MappedImage & image) {
+            std::ofstream file(filename, std::ios::out | std::ios::binary);
+            return pamEncoder.encode(file, image);
+        } },
+        { "pam writev", "pam stream", [](const char * filename, const vks::image::MappedImage & image) {
+            return vks::image::writePAMDirect(filename, image);
+        } },
+    };
+
+    std::cout << "Best of " << iterations << " iterations, " << pool.size() << " threads for mt" << std::endl;
+    std::cout << std::left << std::setw(10) << "size" << std::setw(10) << "padding" << std::setw(14) << "path"
+              << std::right << std::setw(12) << "time (ms)" << std::setw(10) << "MB/s" << std::endl;
+
+    bool identical = true;
+    for (auto & resolution : resolutions) {
+        for (bool padded : { false, true }) {
+            uint64_t rowPitch = uint64_t(resolution.width) * 4;
+            if (padded) {
+                rowPitch = (rowPitch + rowPitchAlignment) / rowPitchAlignment * rowPitchAlignment;
+            }
+            std::vector<uint8_t> buffer = createMappedBuffer(resolution.height, rowPitch);
+
+            vks::image::MappedImage image;
+            image.data = buffer.data();
+            image.width = resolution.width;
+            image.height = resolution.height;
+            image.rowPitch = rowPitch;
+            image.layout = vks::pixels::PixelLayout::R8G8B8A8;
+
+            for (size_t i = 0; i < writePaths.size(); i++) {
+                const WritePath & path = writePaths[i];
+                std::string filename = outputPath + "/bench_zero_copy_" + std::to_string(i);
+                double ms = measure(iterations, [&] { path.write(filename.c_str(), image); });
+
+                std::vector<char> written = readFile(filename);
+                if (path.reference) {
+                    for (size_t j = 0; j < i; j++) {
+                        if (std::string(path.reference) == writePaths[j].name && readFile(outputPath + "/bench_zero_copy_" + std::to_string(j)) != written) {
+                            std::cerr << "Error: Output of " << path.name << " differs from " << path.reference << " for " << resolution.name << std::endl;
+                            identical = false;
+                        }
+                    }
+                }
+
+                std::cout << std::left << std::setw(10) << resolution.name << std::setw(10) << (padded ? "yes" : "no") << std::setw(14) << path.name
+                          << std::right << std::fixed << std::setprecision(2)
+                          << std::setw(12) << ms << std::setw(10) << written.size() / (1024.0 * 1024.0) / (ms / 1000.0) << std::endl;
+            }
+
+            for (size_t i = 0; i < writePaths.size(); i++) {
+                std::remove((outputPath + "/bench_zero_copy_" + std::to_string(i)).c_str());
+            }
+        }
+    }
+
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,8 @@
 find_package(Vulkan REQUIRED)
 find_program(GLSLC glslc HINTS ${VULKAN_SDK}/bin)
-find_program(IBTOOL NAMES ibtool)
+if (APPLE)
+    find_program(IBTOOL NAMES ibtool)
+endif()
 
 if (NOT Vulkan_FOUND)
     message(FATAL_ERROR "Vulkan not found")
@@ -10,12 +12,14 @@ if (NOT GLSLC)
     message(FATAL_ERROR "GLSLC not found")
 endif()
 
-if (NOT IBTOOL)
-    message(FATAL_ERROR "IBTOOL not found")
-endif()
+if (APPLE)
+    if (NOT IBTOOL)
+        message(FATAL_ERROR "IBTOOL not found")
+    endif()
 
-string(REGEX MATCHALL "(.*)\\/(.*)" RESOURCE_MATCH ${Vulkan_LIBRARY})
-set(MVK_LIB ${CMAKE_MATCH_1}/libMoltenVK.dylib)
+    string(REGEX MATCHALL "(.*)\\/(.*)" RESOURCE_MATCH ${Vulkan_LIBRARY})
+    set(MVK_LIB ${CMAKE_MATCH_1}/libMoltenVK.dylib)
+endif()
 
 function(compile_shader)
     set(options USE_RELATIVE_PATHS)
@@ -34,6 +38,25 @@ function(compile_shader)
         VERBATIM)
 endfunction(compile_shader)
 
+# Compiles a shader into a list of SPIR-V words (e.g. triangle.vert.inc) that src/EmbeddedShaders.cpp includes
+function(embed_shader)
+    set(oneValueArgs SHADER OUTPUT_PATH)
+    set(multiValueArgs TARGET)
+    cmake_parse_arguments(EMBED_SHADER "" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
+    string(REGEX MATCHALL "(.*)\\/(.*)" SHADER_MATCH ${EMBED_SHADER_SHADER})
+    set(SHADER_NAME ${CMAKE_MATCH_2})
+    set(SHADER_OUT ${EMBED_SHADER_OUTPUT_PATH}/${SHADER_NAME}.inc)
+    add_custom_command(
+        OUTPUT ${SHADER_OUT}
+        COMMAND ${CMAKE_COMMAND} -E make_directory "${EMBED_SHADER_OUTPUT_PATH}"
+        COMMAND ${GLSLC} -mfmt=num ${EMBED_SHADER_SHADER} -o ${SHADER_OUT}
+        COMMENT "Embedding SHADER\n source: ${EMBED_SHADER_SHADER}\n target: ${SHADER_OUT}"
+        DEPENDS ${EMBED_SHADER_SHADER}
+        VERBATIM)
+    target_sources(${EMBED_SHADER_TARGET} PRIVATE ${SHADER_OUT})
+    target_include_directories(${EMBED_SHADER_TARGET} PRIVATE ${EMBED_SHADER_OUTPUT_PATH})
+endfunction(embed_shader)
+
 function(copy_resource)
     set(options USE_RELATIVE_PATHS)
     set(oneValueArgs RESOURCE OUTPUT_PATH)
@@ -0,0 +1,27 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+// Per-instance model matrix from the instance-rate binding, a mat4 takes four consecutive locations
+layout (location = 2) in mat4 inModel;
+
+layout (binding = 0) uniform UBO
+{
+    mat4 projectionMatrix;
+    mat4 modelMatrix;
+    mat4 viewMatrix;
+} ubo;
+
+layout (location = 0) out vec3 outColor;
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+
+void main()
+{
+    outColor = inColor;
+    gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * inModel * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,112 @@
+/*
+* Sub-allocation of a memory block
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "BlockSuballocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vks
+{
+    static uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    BlockSuballocator::BlockSuballocator(uint64_t size, uint64_t granularity)
+        : blockSize(size), granularity(std::max<uint64_t>(granularity, 1))
+    {
+        ranges.push_back({ 0, size, true, ResourceTiling::Linear });
+    }
+
+    bool BlockSuballocator::allocate(uint64_t size, uint64_t alignment, ResourceTiling tiling, uint64_t & offset)
+    {
+        if (size == 0) {
+            return false;
+        }
+        alignment = std::max<uint64_t>(alignment, 1);
+
+        for (size_t i = 0; i < ranges.size(); i++) {
+            const Range & range = ranges[i];
+            if (!range.free || range.size < size) {
+                continue;
+            }
+            uint64_t start = alignUp(range.offset, alignment);
+
+            // A resource of the other tiling ending on the page this range would start on pushes the start to the next page
+            if (i > 0 && ranges[i - 1].tiling != tiling && samePage(ranges[i - 1].offset + ranges[i - 1].size - 1, start)) {
+                start = alignUp(alignUp(start, granularity), alignment);
+            }
+            uint64_t end = start + size;
+            if (end > range.offset + range.size) {
+                continue;
+            }
+            // The next resource can't be moved, so one of the other tiling starting on the last page rules this range out
+            if (i + 1 < ranges.size() && ranges[i + 1].tiling != tiling && samePage(end - 1, ranges[i + 1].offset)) {
+                continue;
+            }
+
+            // Split into leading padding, the allocation and the remainder, the padding stays usable for small allocations
+            Range allocated { start, size, false, tiling };
+            uint64_t remainderSize = range.offset + range.size - end;
+            uint64_t paddingSize = start - range.offset;
+            size_t index = i;
+            if (paddingSize > 0) {
+                ranges[index].size = paddingSize;
+                index++;
+                ranges.insert(ranges.begin() + index, allocated);
+            } else {
+                ranges[index] = allocated;
+            }
+            if (remainderSize > 0) {
+                ranges.insert(ranges.begin() + index + 1, Range { end, remainderSize, true, ResourceTiling::Linear });
+            }
+
+            usedBytes += size;
+            allocations++;
+            offset = start;
+            return true;
+        }
+        return false;
+    }
+
+    void BlockSuballocator::free(uint64_t offset)
+    {
+        auto it = std::lower_bound(ranges.begin(), ranges.end(), offset, [](const Range & range, uint64_t value) {
+            return range.offset < value;
+        });
+        assert(it != ranges.end() && it->offset == offset && !it->free);
+        if (it == ranges.end() || it->offset != offset || it->free) {
+            return;
+        }
+
+        usedBytes -= it->size;
+        allocations--;
+        it->free = true;
+        it->tiling = ResourceTiling::Linear;
+
+        size_t index = it - ranges.begin();
+        if (index + 1 < ranges.size() && ranges[index + 1].free) {
+            ranges[index].size += ranges[index + 1].size;
+            ranges.erase(ranges.begin() + index + 1);
+        }
+        if (index > 0 && ranges[index - 1].free) {
+            ranges[index - 1].size += ranges[index].size;
+            ranges.erase(ranges.begin() + index);
+        }
+    }
+
+    uint64_t BlockSuballocator::largestFreeRange() const
+    {
+        uint64_t largest = 0;
+        for (const Range & range : ranges) {
+            if (range.free) {
+                largest = std::max(largest, range.size);
+            }
+        }
+        return largest;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+* Sub-allocation of a memory block
+*
+* Bookkeeping for handing out aligned ranges of one large device memory block, kept free of Vulkan calls so the
+* logic can be exercised on the CPU. Ranges of linear and optimal resources are kept bufferImageGranularity apart
+* wherever they would otherwise share a granularity page
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vks
+{
+    /** @brief Tiling of the resource bound to a range, linear and optimal resources must not share a granularity page */
+    enum class ResourceTiling
+    {
+        /** @brief Buffers and linear images */
+        Linear,
+        /** @brief Optimal tiled images */
+        Optimal,
+    };
+
+    class BlockSuballocator
+    {
+    public:
+        /**
+        * @param size Size of the block in bytes
+        * @param granularity bufferImageGranularity of the device, must be a power of two
+        */
+        BlockSuballocator(uint64_t size, uint64_t granularity);
+
+        /**
+        * Find and reserve a free range, first fit
+        *
+        * @param size Size of the range in bytes
+        * @param alignment Required alignment of the offset, must be a power of two
+        * @param tiling Tiling of the resource the range is bound to
+        * @param offset Set to the offset of the range within the block
+        *
+        * @return False if no free range is large enough
+        */
+        bool allocate(uint64_t size, uint64_t alignment, ResourceTiling tiling, uint64_t & offset);
+
+        /** @brief Return the range starting at offset, merging it with free neighbours */
+        void free(uint64_t offset);
+
+        uint64_t size() const
+        { return blockSize; }
+
+        /** @brief Bytes of all allocated ranges, excluding alignment padding */
+        uint64_t used() const
+        { return usedBytes; }
+
+        uint32_t allocationCount() const
+        { return allocations; }
+
+        bool empty() const
+        { return allocations == 0; }
+
+        /** @brief Size of the largest free range, an upper bound for the next allocation */
+        uint64_t largestFreeRange() const;
+
+    private:
+        struct Range
+        {
+            uint64_t offset;
+            uint64_t size;
+            bool free;
+            ResourceTiling tiling;
+        };
+
+        uint64_t blockSize;
+        uint64_t granularity;
+        uint64_t usedBytes = 0;
+        uint32_t allocations = 0;
+        // Sorted by offset and covering the whole block, adjacent free ranges are always merged
+        std::vector<Range> ranges;
+
+        bool samePage(uint64_t a, uint64_t b) const
+        { return a / granularity == b / granularity; }
+    };
+}
@@ -0,0 +1,73 @@
+/*
+* Ring of per-frame command pools
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "CommandPoolRing.hpp"
+
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    CommandPoolRing::~CommandPoolRing()
+    {
+        destroy();
+    }
+
+    void CommandPoolRing::create(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount)
+    {
+        destroy();
+        this->device = device;
+        poolStats = CommandPoolStats();
+
+        // Transient: the command buffers are short lived. No per command buffer reset, the pool is only reset as a whole
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        frames.resize(frameCount);
+        for (Frame & frame : frames) {
+            VK_CHECK_RESULT(vkCreateCommandPool(device, &poolInfo, nullptr, &frame.pool));
+        }
+        current = 0;
+    }
+
+    void CommandPoolRing::destroy()
+    {
+        // Destroying a pool frees the command buffers allocated from it
+        for (Frame & frame : frames) {
+            vkDestroyCommandPool(device, frame.pool, nullptr);
+        }
+        frames.clear();
+    }
+
+    void CommandPoolRing::begin(uint32_t frame)
+    {
+        current = frame;
+        Frame & target = frames[frame];
+        // Puts every command buffer of the pool back into the initial state, without releasing the memory they have grown to
+        VK_CHECK_RESULT(vkResetCommandPool(device, target.pool, 0));
+        target.used[0] = 0;
+        target.used[1] = 0;
+        poolStats.resets++;
+    }
+
+    VkCommandBuffer CommandPoolRing::acquire(VkCommandBufferLevel level)
+    {
+        Frame & frame = frames[current];
+        uint32_t index = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+        std::vector<VkCommandBuffer> & buffers = frame.buffers[index];
+        if (frame.used[index] == buffers.size()) {
+            VkCommandBufferAllocateInfo allocateInfo = vks::initializers::commandBufferAllocateInfo(frame.pool, level, 1);
+            VkCommandBuffer commandBuffer;
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+            buffers.push_back(commandBuffer);
+            poolStats.allocated++;
+        }
+        poolStats.acquired++;
+        return buffers[frame.used[index]++];
+    }
+}
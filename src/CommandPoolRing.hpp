@@ -0,0 +1,78 @@
+/*
+* Ring of per-frame command pools
+*
+* One command pool per frame in flight for command buffers that are recorded anew every frame. Once the fence of a
+* frame has signaled, its whole pool is reset with a single vkResetCommandPool instead of resetting or freeing every
+* command buffer, and the command buffers allocated from it are handed out again in the same order. A frame only
+* allocates when it needs more command buffers than any earlier frame on the same pool, so after the first frames
+* recording costs no allocations at all
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    struct CommandPoolStats
+    {
+        /** @brief Bulk resets of a frame's pool */
+        uint64_t resets = 0;
+        /** @brief Command buffers handed out, from the pool's free list or newly allocated */
+        uint64_t acquired = 0;
+        /** @brief Command buffers allocated, stays at the high-water mark of a frame once the ring is warm */
+        uint64_t allocated = 0;
+    };
+
+    class CommandPoolRing
+    {
+    public:
+        ~CommandPoolRing();
+
+        /**
+        * Create the pools, destroying the previous ones if the ring has already been created
+        *
+        * @param device Device to create the command pools on
+        * @param queueFamilyIndex Queue family the command buffers are submitted to
+        * @param frameCount Number of pools, one per frame that may be in flight at the same time
+        */
+        void create(VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCount);
+
+        void destroy();
+
+        uint32_t size() const
+        { return static_cast<uint32_t>(frames.size()); }
+
+        /**
+        * Reset the pool of a frame and start handing out its command buffers from the first one
+        *
+        * @note The command buffers of the previous use of the frame must have completed, e.g. by waiting for its fence first
+        */
+        void begin(uint32_t frame);
+
+        /** @brief Next command buffer of the frame begun last, in the initial state */
+        VkCommandBuffer acquire(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+        CommandPoolStats stats() const
+        { return poolStats; }
+
+    private:
+        struct Frame
+        {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            // Allocated command buffers of each level in the order they were first handed out, and how many are in use
+            std::vector<VkCommandBuffer> buffers[2];
+            uint32_t used[2] = { 0, 0 };
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        std::vector<Frame> frames;
+        uint32_t current = 0;
+        CommandPoolStats poolStats;
+    };
+}
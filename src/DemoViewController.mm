@@ -15,8 +15,9 @@ const std::string getAssetPath() {
     return [NSBundle.mainBundle.resourcePath stringByAppendingString: @"/data/"].UTF8String;
 }
 
+// Screenshots and recordings are written next to the app bundle
 const std::string getOutputPath() {
-    return NSBundle.mainBundle.bundlePath.UTF8String;
+    return NSBundle.mainBundle.bundlePath.stringByDeletingLastPathComponent.UTF8String;
 }
 
 /** Rendering loop callback function for use with a CVDisplayLink. */
@@ -48,7 +49,9 @@ static CVReturn DisplayLinkCallback(CVDisplayLinkRef displayLink,
     _screenshotExample = new ScreenshotExample();
     _screenshotExample->initVulkan();
     _screenshotExample->setupWindow((__bridge void *) self.view);
-    _screenshotExample->prepare();
+    if (!_screenshotExample->prepare()) {
+        exit(-1);
+    }
 
     CVDisplayLinkCreateWithActiveCGDisplays(&_displayLink);
     CVDisplayLinkSetOutputCallback(_displayLink, &DisplayLinkCallback, _screenshotExample);
@@ -0,0 +1,51 @@
+/*
+* Shaders compiled into the executable
+*
+* With -DSCREENSHOT_EMBED_SHADERS=ON the build compiles every shader with glslc -mfmt=num into a list of words that is
+* included here, shaders added to the pipelines have to be added to the table as well
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ShaderLibrary.hpp"
+
+namespace vks
+{
+#ifdef VKS_EMBEDDED_SHADERS
+    namespace
+    {
+        constexpr uint32_t triangleVert[] = {
+#include "triangle.vert.inc"
+        };
+
+        constexpr uint32_t triangleInstancedVert[] = {
+#include "triangle_instanced.vert.inc"
+        };
+
+        constexpr uint32_t triangleFrag[] = {
+#include "triangle.frag.inc"
+        };
+
+        constexpr EmbeddedShader embeddedShaders[] = {
+            { "triangle/triangle.vert.spv", triangleVert, sizeof(triangleVert) },
+            { "triangle/triangle_instanced.vert.spv", triangleInstancedVert, sizeof(triangleInstancedVert) },
+            { "triangle/triangle.frag.spv", triangleFrag, sizeof(triangleFrag) },
+        };
+    }
+
+    const EmbeddedShader * findEmbeddedShader(const std::string & name)
+    {
+        for (const EmbeddedShader & shader : embeddedShaders) {
+            if (name == shader.name) {
+                return &shader;
+            }
+        }
+        return nullptr;
+    }
+#else
+    const EmbeddedShader * findEmbeddedShader(const std::string &)
+    {
+        return nullptr;
+    }
+#endif
+}
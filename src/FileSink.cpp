@@ -0,0 +1,555 @@
+/*
+* Asynchronous file sinks for captured frames
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "FileSink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef VKS_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace vks
+{
+    /*
+        Aligned buffers
+    */
+
+    AlignedBuffer::AlignedBuffer(size_t size)
+    {
+        resize(size);
+    }
+
+    AlignedBuffer::~AlignedBuffer()
+    {
+        free(memory);
+    }
+
+    AlignedBuffer::AlignedBuffer(AlignedBuffer && other) noexcept
+        : memory(other.memory), used(other.used), allocated(other.allocated)
+    {
+        other.memory = nullptr;
+        other.used = 0;
+        other.allocated = 0;
+    }
+
+    AlignedBuffer & AlignedBuffer::operator=(AlignedBuffer && other) noexcept
+    {
+        if (this != &other) {
+            free(memory);
+            memory = other.memory;
+            used = other.used;
+            allocated = other.allocated;
+            other.memory = nullptr;
+            other.used = 0;
+            other.allocated = 0;
+        }
+        return *this;
+    }
+
+    void AlignedBuffer::resize(size_t size)
+    {
+        if (size > allocated) {
+            // Grow geometrically, encoders append to the buffer a few bytes at a time
+            reserve(std::max(size, allocated * 2));
+        }
+        used = size;
+    }
+
+    void AlignedBuffer::reserve(size_t capacity)
+    {
+        capacity = (capacity + fileAlignment - 1) / fileAlignment * fileAlignment;
+        if (capacity <= allocated) {
+            return;
+        }
+        void * grown = nullptr;
+        if (posix_memalign(&grown, fileAlignment, capacity) != 0) {
+            throw std::bad_alloc();
+        }
+        if (used > 0) {
+            memcpy(grown, memory, used);
+        }
+        free(memory);
+        memory = static_cast<uint8_t *>(grown);
+        allocated = capacity;
+    }
+
+    AlignedBufferStream::AlignedBufferStream(AlignedBuffer & buffer)
+        : std::ostream(nullptr), streambuf(buffer)
+    {
+        rdbuf(&streambuf);
+    }
+
+    std::streamsize AlignedBufferStream::Streambuf::xsputn(const char * data, std::streamsize count)
+    {
+        size_t offset = buffer.size();
+        buffer.resize(offset + count);
+        memcpy(buffer.data() + offset, data, count);
+        return count;
+    }
+
+    AlignedBufferStream::Streambuf::int_type AlignedBufferStream::Streambuf::overflow(int_type c)
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            char value = traits_type::to_char_type(c);
+            xsputn(&value, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    AlignedBufferStream::Streambuf::pos_type AlignedBufferStream::Streambuf::seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode)
+    {
+        // Only reporting the position is supported, e.g. for tellp
+        if (offset == 0 && direction == std::ios_base::cur && (mode & std::ios_base::out)) {
+            return pos_type(off_type(buffer.size()));
+        }
+        return pos_type(off_type(-1));
+    }
+
+    /*
+        Common file handling
+    */
+
+    // Direct I/O is switched off for file systems that don't support it (e.g. tmpfs), direct is updated accordingly
+    static int openForWrite(const std::string & filename, bool & direct)
+    {
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+        if (direct) {
+            int fd = open(filename.c_str(), flags | O_DIRECT, 0644);
+            if (fd >= 0 || errno != EINVAL) {
+                return fd;
+            }
+            direct = false;
+        }
+#endif
+        int fd = open(filename.c_str(), flags, 0644);
+#ifdef F_NOCACHE
+        if (fd >= 0 && direct) {
+            fcntl(fd, F_NOCACHE, 1);
+        }
+#endif
+        return fd;
+    }
+
+    // Direct writes are padded to the alignment, the padding is cut off again before closing
+    // The errors are returned instead of left in errno, which later system calls on the same thread overwrite
+    static int closeFile(int fd, size_t size, size_t written)
+    {
+        int error = written == size || ftruncate(fd, size) == 0 ? 0 : errno;
+        if (close(fd) != 0 && error == 0) {
+            error = errno;
+        }
+        return error;
+    }
+
+    // Returns 0 once the file has been written, otherwise the errno of the step that failed
+    static int writeFile(const FileWrite & write, bool direct)
+    {
+        int fd = openForWrite(write.filename, direct);
+        if (fd < 0) {
+            return errno;
+        }
+        const size_t length = direct ? write.data.alignedSize() : write.data.size();
+        const uint8_t * data = write.data.data();
+        size_t offset = 0;
+        while (offset < length) {
+            ssize_t written = pwrite(fd, data + offset, length - offset, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                int error = errno;
+                close(fd);
+                return error;
+            }
+            offset += written;
+        }
+        return closeFile(fd, write.data.size(), length);
+    }
+
+    void FileSink::complete(FileWrite & write, int error)
+    {
+        bool success = error == 0;
+        if (success) {
+            writtenBytes += write.data.size();
+        } else {
+            failedFiles++;
+            std::cerr << "Error: Could not write \"" << write.filename << "\": " << strerror(error) << std::endl;
+        }
+        if (write.done) {
+            write.done(success);
+        }
+    }
+
+    /*
+        Synchronous sink
+    */
+
+    SyncFileSink::SyncFileSink(const FileSinkSettings & settings)
+        : settings(settings)
+    {
+    }
+
+    void SyncFileSink::submit(FileWrite write)
+    {
+        complete(write, writeFile(write, settings.directIO));
+    }
+
+    /*
+        Threaded sink
+    */
+
+    ThreadedFileSink::ThreadedFileSink(const FileSinkSettings & settings)
+        : settings(settings)
+    {
+        for (uint32_t i = 0; i < std::max(settings.threads, 1u); i++) {
+            threads.emplace_back(&ThreadedFileSink::run, this);
+        }
+    }
+
+    ThreadedFileSink::~ThreadedFileSink()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        writeAvailable.notify_all();
+        for (auto & thread : threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadedFileSink::submit(FileWrite write)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            writeFinished.wait(lock, [this] { return inFlight < std::max(settings.queueDepth, 1u); });
+            inFlight++;
+            writes.push_back(std::move(write));
+        }
+        writeAvailable.notify_one();
+    }
+
+    void ThreadedFileSink::waitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        writeFinished.wait(lock, [this] { return inFlight == 0; });
+    }
+
+    void ThreadedFileSink::run()
+    {
+        for (;;) {
+            FileWrite write;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                writeAvailable.wait(lock, [this] { return stop || !writes.empty(); });
+                // Queued files are always written before the threads stop
+                if (writes.empty()) {
+                    return;
+                }
+                write = std::move(writes.front());
+                writes.pop_front();
+            }
+
+            complete(write, writeFile(write, settings.directIO));
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inFlight--;
+            }
+            writeFinished.notify_all();
+        }
+    }
+
+    /*
+        io_uring sink
+
+        Talks to the kernel through the raw system calls, so no liburing is required. Files are split into chunks
+        that are each submitted as a write, a reaper thread waits for their completions and closes finished files
+    */
+
+#ifdef VKS_HAVE_IO_URING
+    // Size of the writes a file is split into, a multiple of the direct I/O alignment
+    static const size_t ioUringChunkSize = 1024 * 1024;
+    static const uint32_t ioUringEntries = 64;
+
+    static int ioUringSetup(uint32_t entries, io_uring_params * params)
+    {
+        return (int) syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    static int ioUringEnter(int ringFd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+    {
+        return (int) syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+    }
+
+    std::unique_ptr<IoUringFileSink> IoUringFileSink::create(const FileSinkSettings & settings)
+    {
+        std::unique_ptr<IoUringFileSink> sink(new IoUringFileSink());
+        if (!sink->setup(settings)) {
+            return nullptr;
+        }
+        return sink;
+    }
+
+    bool IoUringFileSink::setup(const FileSinkSettings & settings)
+    {
+        this->settings = settings;
+
+        io_uring_params params = {};
+        ringFd = ioUringSetup(ioUringEntries, &params);
+        if (ringFd < 0) {
+            return false;
+        }
+        sqEntries = params.sq_entries;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMapping) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            sqRing = nullptr;
+            return false;
+        }
+        if (singleMapping) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                cqRing = nullptr;
+                return false;
+            }
+        }
+        sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+        sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqeMemory == MAP_FAILED) {
+            sqeMemory = nullptr;
+            return false;
+        }
+
+        uint8_t * sq = static_cast<uint8_t *>(sqRing);
+        sqTail = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+        uint8_t * cq = static_cast<uint8_t *>(cqRing);
+        cqHead = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+        cqes = cq + params.cq_off.cqes;
+
+        reaper = std::thread(&IoUringFileSink::run, this);
+        return true;
+    }
+
+    IoUringFileSink::~IoUringFileSink()
+    {
+        if (reaper.joinable()) {
+            waitIdle();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+                // Wakes the reaper up from waiting for a completion
+                queueEntry(IORING_OP_NOP, -1, nullptr, 0, 0, 0);
+            }
+            reaper.join();
+        }
+        if (sqeMemory) {
+            munmap(sqeMemory, sqeMemorySize);
+        }
+        if (cqRing && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (ringFd >= 0) {
+            close(ringFd);
+        }
+    }
+
+    void IoUringFileSink::queueEntry(uint8_t opcode, int fd, const uint8_t * data, uint32_t length, uint64_t offset, uint64_t userData)
+    {
+        // Only ever called with the mutex held, so this thread owns the tail of the submission queue
+        uint32_t tail = *sqTail;
+        uint32_t index = tail & sqMask;
+        io_uring_sqe * sqe = static_cast<io_uring_sqe *>(sqeMemory) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        inFlightEntries++;
+
+        while (ioUringEnter(ringFd, 1, 0, 0) < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void IoUringFileSink::queueWrite(const Chunk & chunk, std::unique_lock<std::mutex> & lock)
+    {
+        // Never more entries in flight than the submission queue holds, the completion queue is twice as large
+        progress.wait(lock, [this] { return inFlightEntries < sqEntries; });
+        const uint8_t * data = chunk.file->write.data.data() + chunk.offset;
+        queueEntry(IORING_OP_WRITE, chunk.file->fd, data, chunk.length, chunk.offset, reinterpret_cast<uint64_t>(&chunk));
+    }
+
+    void IoUringFileSink::submit(FileWrite write)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            progress.wait(lock, [this] { return inFlightFiles < std::max(settings.queueDepth, 1u); });
+            inFlightFiles++;
+        }
+
+        PendingFile * file = new PendingFile();
+        file->write = std::move(write);
+        bool direct = settings.directIO;
+        file->fd = openForWrite(file->write.filename, direct);
+        if (file->fd < 0) {
+            file->error = errno;
+            finish(file);
+            return;
+        }
+
+        // Chunks are created up front, the completions point at them
+        file->length = direct ? file->write.data.alignedSize() : file->write.data.size();
+        for (size_t offset = 0; offset < file->length; offset += ioUringChunkSize) {
+            file->chunks.push_back({ file, offset, uint32_t(std::min(ioUringChunkSize, file->length - offset)) });
+        }
+        file->remainingChunks = uint32_t(file->chunks.size());
+        if (file->chunks.empty()) {
+            finish(file);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for (const Chunk & chunk : file->chunks) {
+            queueWrite(chunk, lock);
+        }
+    }
+
+    void IoUringFileSink::waitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        progress.wait(lock, [this] { return inFlightFiles == 0; });
+    }
+
+    void IoUringFileSink::run()
+    {
+        for (;;) {
+            uint32_t head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (stop && inFlightEntries == 0) {
+                        return;
+                    }
+                }
+                ioUringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+                continue;
+            }
+
+            io_uring_cqe cqe = static_cast<io_uring_cqe *>(cqes)[head & cqMask];
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+            PendingFile * finished = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                inFlightEntries--;
+                Chunk * chunk = reinterpret_cast<Chunk *>(cqe.user_data);
+                if (chunk) {
+                    if (cqe.res < 0) {
+                        if (chunk->file->error == 0) {
+                            chunk->file->error = -cqe.res;
+                        }
+                    } else if (uint32_t(cqe.res) < chunk->length) {
+                        // Short write, the rest of the chunk is submitted again
+                        chunk->offset += cqe.res;
+                        chunk->length -= cqe.res;
+                        queueWrite(*chunk, lock);
+                        continue;
+                    }
+                    if (--chunk->file->remainingChunks == 0) {
+                        finished = chunk->file;
+                    }
+                }
+            }
+            progress.notify_all();
+
+            if (finished) {
+                finish(finished);
+            }
+        }
+    }
+
+    void IoUringFileSink::finish(PendingFile * file)
+    {
+        int error = file->error;
+        if (file->fd >= 0) {
+            int closeError = closeFile(file->fd, file->write.data.size(), file->length);
+            error = error != 0 ? error : closeError;
+        }
+        complete(file->write, error);
+        delete file;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlightFiles--;
+        }
+        progress.notify_all();
+    }
+#endif
+
+    const char * fileSinkName(FileSinkType type)
+    {
+        switch (type) {
+            case FileSinkType::Sync: return "sync";
+            case FileSinkType::Threaded: return "threaded";
+            case FileSinkType::IoUring: return "io_uring";
+        }
+        return "unknown";
+    }
+
+    std::unique_ptr<FileSink> createFileSink(FileSinkType type, const FileSinkSettings & settings)
+    {
+        switch (type) {
+            case FileSinkType::Sync:
+                return std::make_unique<SyncFileSink>(settings);
+            case FileSinkType::Threaded:
+                return std::make_unique<ThreadedFileSink>(settings);
+            case FileSinkType::IoUring: {
+#ifdef VKS_HAVE_IO_URING
+                std::unique_ptr<FileSink> sink = IoUringFileSink::create(settings);
+                if (sink) {
+                    return sink;
+                }
+#endif
+                std::cerr << "io_uring is not available, falling back to threaded writes" << std::endl;
+                return std::make_unique<ThreadedFileSink>(settings);
+            }
+        }
+        return nullptr;
+    }
+}
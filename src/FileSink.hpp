@@ -0,0 +1,294 @@
+/*
+* Asynchronous file sinks for captured frames
+*
+* A sink takes complete encoded files and writes them to disk without blocking the caller on the disk, keeping
+* several files in flight. Writes go through io_uring on Linux (5.6 or newer), through a small pool of threads using pwrite
+* everywhere else, or synchronously on the calling thread for comparison
+*
+* Buffers are aligned so files can optionally be written with O_DIRECT (F_NOCACHE on macOS), bypassing the page
+* cache for long captures that would otherwise evict everything else from it
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define VKS_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace vks
+{
+    /** @brief Heap buffer whose start and capacity are aligned to fileAlignment, as required for direct I/O */
+    class AlignedBuffer
+    {
+    public:
+        /** @brief Alignment of buffer addresses, file offsets and write sizes for direct I/O */
+        static const size_t fileAlignment = 4096;
+
+        AlignedBuffer() = default;
+        explicit AlignedBuffer(size_t size);
+        ~AlignedBuffer();
+
+        AlignedBuffer(AlignedBuffer && other) noexcept;
+        AlignedBuffer & operator=(AlignedBuffer && other) noexcept;
+        AlignedBuffer(const AlignedBuffer &) = delete;
+        AlignedBuffer & operator=(const AlignedBuffer &) = delete;
+
+        uint8_t * data()
+        { return memory; }
+
+        const uint8_t * data() const
+        { return memory; }
+
+        /** @brief Number of bytes in use */
+        size_t size() const
+        { return used; }
+
+        /** @brief Size rounded up to fileAlignment, always within the allocation */
+        size_t alignedSize() const
+        { return (used + fileAlignment - 1) / fileAlignment * fileAlignment; }
+
+        /** @brief Change the number of bytes in use, growing the allocation if needed while keeping the contents */
+        void resize(size_t size);
+
+        /** @brief Make room for at least capacity bytes without changing the size */
+        void reserve(size_t capacity);
+
+    private:
+        uint8_t * memory = nullptr;
+        size_t used = 0;
+        size_t allocated = 0;
+    };
+
+    /** @brief Output stream appending to an AlignedBuffer, lets encoders write a complete file into memory */
+    class AlignedBufferStream : public std::ostream
+    {
+    public:
+        explicit AlignedBufferStream(AlignedBuffer & buffer);
+
+    private:
+        class Streambuf : public std::streambuf
+        {
+        public:
+            explicit Streambuf(AlignedBuffer & buffer)
+                : buffer(buffer)
+            {}
+
+        protected:
+            std::streamsize xsputn(const char * data, std::streamsize count) override;
+            int_type overflow(int_type c) override;
+            pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode) override;
+
+        private:
+            AlignedBuffer & buffer;
+        };
+
+        Streambuf streambuf;
+    };
+
+    /** @brief A complete file handed to a sink, the sink owns the data until the write has finished */
+    struct FileWrite
+    {
+        std::string filename;
+        AlignedBuffer data;
+        /** @brief Called once the file has been written and closed, on a thread of the sink */
+        std::function<void(bool success)> done;
+    };
+
+    enum class FileSinkType
+    {
+        /** @brief Write on the thread that submits, blocks the caller for the duration of the write */
+        Sync,
+        /** @brief Write with pwrite on a small pool of threads, portable */
+        Threaded,
+        /** @brief Write through an io_uring submission queue, Linux only */
+        IoUring,
+    };
+
+    struct FileSinkSettings
+    {
+        /** @brief Number of files that may be in flight before submit blocks */
+        uint32_t queueDepth = 4;
+        /** @brief Bypass the page cache (O_DIRECT, F_NOCACHE on macOS), falls back to cached writes if the file system refuses */
+        bool directIO = false;
+        /** @brief Writer threads of the threaded sink */
+        uint32_t threads = 2;
+    };
+
+    class FileSink
+    {
+    public:
+        virtual ~FileSink() = default;
+
+        virtual FileSinkType type() const = 0;
+
+        /**
+        * Queue a file for writing
+        *
+        * @note Blocks while queueDepth files are in flight, so a caller producing faster than the disk is slowed
+        * down instead of buffering without bound
+        */
+        virtual void submit(FileWrite write) = 0;
+
+        /** @brief Block until all submitted files have been written */
+        virtual void waitIdle() = 0;
+
+        /** @brief Bytes of all files written successfully so far */
+        uint64_t bytesWritten() const
+        { return writtenBytes.load(); }
+
+        /** @brief Files that could not be written */
+        uint64_t failures() const
+        { return failedFiles.load(); }
+
+    protected:
+        std::atomic<uint64_t> writtenBytes { 0 };
+        std::atomic<uint64_t> failedFiles { 0 };
+
+        /**
+        * Record the result of a write and notify the submitter
+        *
+        * @param error errno of the step that failed, 0 if the file has been written
+        */
+        void complete(FileWrite & write, int error);
+    };
+
+    class SyncFileSink : public FileSink
+    {
+    public:
+        explicit SyncFileSink(const FileSinkSettings & settings);
+
+        FileSinkType type() const override
+        { return FileSinkType::Sync; }
+
+        void submit(FileWrite write) override;
+        void waitIdle() override {}
+
+    private:
+        FileSinkSettings settings;
+    };
+
+    class ThreadedFileSink : public FileSink
+    {
+    public:
+        explicit ThreadedFileSink(const FileSinkSettings & settings);
+
+        /** @brief Writes all queued files before joining the threads */
+        ~ThreadedFileSink();
+
+        FileSinkType type() const override
+        { return FileSinkType::Threaded; }
+
+        void submit(FileWrite write) override;
+        void waitIdle() override;
+
+    private:
+        FileSinkSettings settings;
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable writeAvailable;
+        std::condition_variable writeFinished;
+        std::deque<FileWrite> writes;
+        uint32_t inFlight = 0;
+        bool stop = false;
+
+        void run();
+    };
+
+#ifdef VKS_HAVE_IO_URING
+    class IoUringFileSink : public FileSink
+    {
+    public:
+        /** @brief Returns nullptr if io_uring is not available, e.g. on old kernels or when blocked by seccomp */
+        static std::unique_ptr<IoUringFileSink> create(const FileSinkSettings & settings);
+
+        /** @brief Writes all queued files before tearing the ring down */
+        ~IoUringFileSink();
+
+        FileSinkType type() const override
+        { return FileSinkType::IoUring; }
+
+        void submit(FileWrite write) override;
+        void waitIdle() override;
+
+    private:
+        struct PendingFile;
+        struct Chunk
+        {
+            PendingFile * file;
+            uint64_t offset;
+            uint32_t length;
+        };
+        struct PendingFile
+        {
+            FileWrite write;
+            int fd = -1;
+            /** @brief Bytes written to the file, padded to the alignment for direct I/O */
+            size_t length = 0;
+            std::vector<Chunk> chunks;
+            uint32_t remainingChunks = 0;
+            /** @brief errno of the first step that failed, 0 while all succeeded */
+            int error = 0;
+        };
+
+        FileSinkSettings settings;
+        int ringFd = -1;
+        uint32_t sqEntries = 0;
+        void * sqRing = nullptr;
+        size_t sqRingSize = 0;
+        void * cqRing = nullptr;
+        size_t cqRingSize = 0;
+        void * sqeMemory = nullptr;
+        size_t sqeMemorySize = 0;
+        uint32_t * sqTail = nullptr;
+        uint32_t sqMask = 0;
+        uint32_t * sqArray = nullptr;
+        uint32_t * cqHead = nullptr;
+        uint32_t * cqTail = nullptr;
+        uint32_t cqMask = 0;
+        void * cqes = nullptr;
+
+        std::thread reaper;
+        std::mutex mutex;
+        std::condition_variable progress;
+        // Submission queue entries handed to the kernel whose completion has not been reaped
+        uint32_t inFlightEntries = 0;
+        uint32_t inFlightFiles = 0;
+        std::atomic<bool> stop { false };
+
+        IoUringFileSink() = default;
+        bool setup(const FileSinkSettings & settings);
+        void queueWrite(const Chunk & chunk, std::unique_lock<std::mutex> & lock);
+        void queueEntry(uint8_t opcode, int fd, const uint8_t * data, uint32_t length, uint64_t offset, uint64_t userData);
+        void run();
+        void finish(PendingFile * file);
+    };
+#endif
+
+    /** @brief Returns a readable name for a sink type */
+    const char * fileSinkName(FileSinkType type);
+
+    /**
+    * Create a sink of the given type
+    *
+    * @note Falls back to a threaded sink if io_uring is requested but not available
+    */
+    std::unique_ptr<FileSink> createFileSink(FileSinkType type, const FileSinkSettings & settings = FileSinkSettings());
+}
@@ -0,0 +1,147 @@
+/*
+* Continuous frame recorder
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "FrameRecorder.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    FrameRecorder::FrameRecorder(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkCommandPool commandPool, uint32_t width, uint32_t height,
+                                 vks::pixels::PixelLayout layout, const std::string & directory, const Settings & settings)
+        : device(vulkanDevice->logicalDevice), settings(settings), directory(directory), queue(settings.queueDepth)
+    {
+        if (this->settings.interval == 0) {
+            this->settings.interval = 1;
+        }
+        // Without a readback image nothing could be captured, and back pressure would wait for one forever
+        if (this->settings.queueDepth == 0) {
+            this->settings.queueDepth = 1;
+        }
+
+        // Every readback image must fit into the queue, so pushing a captured frame never fails
+        readbackImages = readbackRing.create(vulkanDevice, allocator, commandPool, width, height, VK_FORMAT_R8G8B8A8_UNORM, this->settings.queueDepth);
+        image.width = width;
+        image.height = height;
+        image.layout = layout;
+
+        encoder = vks::image::createEncoder(settings.format, settings.compressionLevel);
+        if (settings.output == Output::ImageSequence) {
+            vks::FileSinkSettings sinkSettings;
+            sinkSettings.directIO = settings.directIO;
+            fileSink = vks::createFileSink(settings.sink, sinkSettings);
+        }
+        if (settings.output == Output::RawVideo) {
+            std::string filename = directory + "/recording.rgb";
+            videoStream.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!videoStream.is_open()) {
+                std::cerr << "Error: Could not open \"" << filename << "\" for writing" << std::endl;
+            }
+        }
+
+        writer = std::thread(&FrameRecorder::run, this);
+    }
+
+    FrameRecorder::~FrameRecorder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stop = true;
+        }
+        frameQueued.notify_one();
+        writer.join();
+        fileSink.reset();
+        readbackRing.destroy();
+    }
+
+    vks::ReadbackSlot * FrameRecorder::acquire(uint64_t frameIndex)
+    {
+        if (frameIndex % settings.interval != 0) {
+            return nullptr;
+        }
+        vks::ReadbackSlot * slot = readbackRing.acquire(settings.policy == OverflowPolicy::BackPressure);
+        if (!slot) {
+            droppedFrames++;
+        }
+        return slot;
+    }
+
+    void FrameRecorder::push(vks::ReadbackSlot * slot)
+    {
+        Frame frame;
+        frame.slot = slot;
+        frame.sequence = capturedFrames++;
+        // Can't fail, there are never more slots in flight than the queue holds
+        queue.tryPush(std::move(frame));
+        // Taking the lock orders the push before the writer's check of the queue, so the notification can't be missed
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+        }
+        frameQueued.notify_one();
+    }
+
+    void FrameRecorder::run()
+    {
+        Frame frame;
+        for (;;) {
+            if (queue.tryPop(frame)) {
+                write(frame);
+                continue;
+            }
+            // Queued frames are always written before the writer stops
+            if (stop) {
+                if (!queue.tryPop(frame)) {
+                    break;
+                }
+                write(frame);
+                continue;
+            }
+            // Sleep until the next frame is pushed instead of polling, the writer is idle for most of every frame
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            frameQueued.wait(lock, [this] { return queue.size() > 0 || stop; });
+        }
+    }
+
+    void FrameRecorder::write(const Frame & frame)
+    {
+        VK_CHECK_RESULT(vkWaitForFences(device, 1, &frame.slot->fence, VK_TRUE, UINT64_MAX));
+
+        vks::image::MappedImage mappedImage = image;
+        mappedImage.data = frame.slot->data;
+        mappedImage.rowPitch = frame.slot->rowPitch;
+
+        if (settings.output == Output::RawVideo) {
+            bool success = videoStream.is_open() && vks::image::writeRGB(videoStream, mappedImage);
+            readbackRing.release(frame.slot);
+            if (success) {
+                writtenFrames++;
+            }
+            return;
+        }
+
+        char filename[32];
+        snprintf(filename, sizeof(filename), "/frame_%06llu", (unsigned long long) frame.sequence);
+        vks::FileWrite fileWrite;
+        fileWrite.filename = directory + filename + vks::image::formatExtension(settings.format);
+        fileWrite.data.reserve(vks::image::pamHeader(image.width, image.height, 4).size() + size_t(image.width) * image.height * 4);
+        vks::AlignedBufferStream stream(fileWrite.data);
+        bool encoded = encoder->encode(stream, mappedImage);
+
+        // The frame has been copied into the file data, the readback image can be reused while the file is written
+        readbackRing.release(frame.slot);
+        if (encoded) {
+            fileWrite.done = [this](bool success) {
+                if (success) {
+                    writtenFrames++;
+                }
+            };
+            fileSink->submit(std::move(fileWrite));
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/*
+* Continuous frame recorder
+*
+* Captures every Nth frame into its own ring of readback images and hands them to a writer thread through a
+* bounded lock-free queue. The writer stores the frames as a numbered ppm, QOI or PNG image sequence or appends
+* them to a single raw RGB24 video stream. Image sequence files are encoded into memory and handed to a file sink,
+* so neither the render thread nor the writer thread waits for the disk
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+#include "FileSink.hpp"
+#include "ImageEncoder.hpp"
+#include "ImageWriter.hpp"
+#include "ReadbackRing.hpp"
+#include "SPSCQueue.hpp"
+
+namespace vks
+{
+    class FrameRecorder
+    {
+    public:
+        enum class Output
+        {
+            /** @brief One file per frame in the format given in the settings, named frame_000000.ppm, frame_000001.ppm, ... */
+            ImageSequence,
+            /** @brief All frames appended to recording.rgb, e.g. ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i recording.rgb */
+            RawVideo
+        };
+
+        /** @brief What happens to a frame that is due for capture while all readback images are in use */
+        enum class OverflowPolicy
+        {
+            /** @brief Skip the frame and count it as dropped, rendering is never slowed down */
+            DropFrames,
+            /** @brief Block the render thread until the writer has released a readback image */
+            BackPressure
+        };
+
+        struct Settings
+        {
+            /** @brief Capture every Nth frame, 1 captures every frame */
+            uint32_t interval = 1;
+            Output output = Output::ImageSequence;
+            /** @brief Format of the files of an image sequence */
+            vks::image::ImageFormat format = vks::image::ImageFormat::PPM;
+            /** @brief Compression level of image sequence formats that have one, from 0 (fastest) to 9 (smallest) */
+            int compressionLevel = vks::image::defaultCompressionLevel;
+            /** @brief How image sequence files are written, io_uring falls back to threaded writes where it is not available */
+            vks::FileSinkType sink = vks::FileSinkType::Threaded;
+            /** @brief Write image sequence files with direct I/O, bypassing the page cache */
+            bool directIO = false;
+            OverflowPolicy policy = OverflowPolicy::DropFrames;
+            /** @brief Number of readback images and queue entries, i.e. how many frames may wait for the writer, at least 1 */
+            uint32_t queueDepth = 8;
+        };
+
+        /**
+        * Allocate the readback images and start the writer thread
+        *
+        * @param vulkanDevice Device to create the readback images on
+        * @param allocator Allocator the readback image memory is taken from
+        * @param commandPool Pool to allocate the copy command buffers from
+        * @param width Width of the captured frames
+        * @param height Height of the captured frames
+        * @param layout Texel layout of the readback images after the copy
+        * @param directory Existing directory the recording is written to
+        * @param settings Capture interval, output format and overflow policy
+        */
+        FrameRecorder(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkCommandPool commandPool, uint32_t width, uint32_t height,
+                      vks::pixels::PixelLayout layout, const std::string & directory, const Settings & settings);
+
+        /** @brief Writes all queued frames and waits for the file sink before joining the writer thread and freeing the readback images */
+        ~FrameRecorder();
+
+        /**
+        * Get a readback image for the given frame
+        *
+        * @param frameIndex Index of the frame that has just been submitted
+        *
+        * @return Slot to copy the frame into, nullptr if the frame is not due for capture or has been dropped
+        */
+        vks::ReadbackSlot * acquire(uint64_t frameIndex);
+
+        /** @brief Queue a frame whose copy into the slot has been submitted, the writer waits on the slot's fence */
+        void push(vks::ReadbackSlot * slot);
+
+        /** @brief False if the readback images could not be allocated, nothing can be captured then */
+        bool valid() const
+        { return readbackImages; }
+
+        /** @brief Frames copied into a readback image */
+        uint64_t captured() const
+        { return capturedFrames.load(); }
+
+        /** @brief Frames due for capture that were skipped because no readback image was free */
+        uint64_t dropped() const
+        { return droppedFrames.load(); }
+
+        /** @brief Frames written to disk */
+        uint64_t written() const
+        { return writtenFrames.load(); }
+
+    private:
+        struct Frame
+        {
+            vks::ReadbackSlot * slot = nullptr;
+            /** @brief Number of the frame in the recording, consecutive even if frames have been dropped */
+            uint64_t sequence = 0;
+        };
+
+        VkDevice device;
+        Settings settings;
+        std::string directory;
+        vks::image::MappedImage image;
+        std::unique_ptr<vks::image::ImageEncoder> encoder;
+        std::unique_ptr<vks::FileSink> fileSink;
+        vks::ReadbackRing readbackRing;
+        bool readbackImages = false;
+        vks::SPSCQueue<Frame> queue;
+        std::ofstream videoStream;
+        std::thread writer;
+        std::atomic<bool> stop { false };
+        // Wakes the writer once the queue has run empty, the frames themselves still only pass through the queue
+        std::mutex wakeMutex;
+        std::condition_variable frameQueued;
+        std::atomic<uint64_t> capturedFrames { 0 };
+        std::atomic<uint64_t> droppedFrames { 0 };
+        std::atomic<uint64_t> writtenFrames { 0 };
+
+        void run();
+        void write(const Frame & frame);
+    };
+}
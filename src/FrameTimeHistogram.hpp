@@ -0,0 +1,81 @@
+/*
+* Frame time histogram
+*
+* Fixed size histogram of frame times, used to compare frame time percentiles with and without screenshots being captured
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace vks
+{
+    class FrameTimeHistogram
+    {
+    public:
+        /** @brief Width of a bucket in milliseconds */
+        static constexpr double bucketWidth = 0.1;
+        /** @brief Number of buckets, frames slower than bucketCount * bucketWidth end up in the last bucket */
+        static constexpr uint32_t bucketCount = 1000;
+
+        /** @brief Add a frame time in milliseconds */
+        void add(double ms)
+        {
+            uint32_t bucket = std::min(static_cast<uint32_t>(std::max(ms, 0.0) / bucketWidth), bucketCount - 1);
+            buckets[bucket]++;
+            samples++;
+            total += ms;
+            maximum = std::max(maximum, ms);
+        }
+
+        uint64_t count() const
+        { return samples; }
+
+        double mean() const
+        { return samples > 0 ? total / samples : 0.0; }
+
+        double max() const
+        { return maximum; }
+
+        /**
+        * Get a percentile of the recorded frame times
+        *
+        * @param percentile Percentile in the range [0, 100]
+        *
+        * @return Upper bound in milliseconds of the bucket containing the percentile, 0 if no frame has been recorded
+        */
+        double percentile(double percentile) const
+        {
+            if (samples == 0) {
+                return 0.0;
+            }
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(samples * percentile / 100.0 + 0.5));
+            uint64_t accumulated = 0;
+            for (uint32_t i = 0; i < bucketCount; i++) {
+                accumulated += buckets[i];
+                if (accumulated >= rank) {
+                    return std::min((i + 1) * bucketWidth, maximum);
+                }
+            }
+            return maximum;
+        }
+
+        void reset()
+        {
+            buckets.fill(0);
+            samples = 0;
+            total = 0.0;
+            maximum = 0.0;
+        }
+
+    private:
+        std::array<uint64_t, bucketCount> buckets {};
+        uint64_t samples = 0;
+        double total = 0.0;
+        double maximum = 0.0;
+    };
+}
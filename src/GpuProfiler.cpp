@@ -0,0 +1,178 @@
+/*
+* GPU timestamp profiler
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    GpuProfiler::~GpuProfiler()
+    {
+        destroy();
+    }
+
+    bool GpuProfiler::create(vks::VulkanDevice * vulkanDevice, uint32_t queueFamilyIndex, uint32_t maxSlots)
+    {
+        destroy();
+
+        // Queues without valid timestamp bits can't write timestamps at all
+        uint32_t validBits = queueFamilyIndex < vulkanDevice->queueFamilyProperties.size()
+            ? vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits
+            : 0;
+        if (validBits == 0 || vulkanDevice->properties.limits.timestampPeriod <= 0.0f) {
+            std::cerr << "Queue family " << queueFamilyIndex << " does not support timestamps, GPU profiling is disabled" << std::endl;
+            return false;
+        }
+
+        device = vulkanDevice->logicalDevice;
+        timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        queryCount = maxSlots * 2;
+        usedQueries = 0;
+
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = queryCount;
+        VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+        return true;
+    }
+
+    void GpuProfiler::destroy()
+    {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, queryPool, nullptr);
+            queryPool = VK_NULL_HANDLE;
+        }
+        scopes.clear();
+    }
+
+    uint32_t GpuProfiler::addScope(const std::string & name, uint32_t slotCount)
+    {
+        Scope scope;
+        scope.name = name;
+        if (enabled()) {
+            if (usedQueries + slotCount * 2 > queryCount) {
+                std::cerr << "Error: No query slots left for GPU scope \"" << name << "\", it won't be measured" << std::endl;
+                slotCount = 0;
+            }
+            scope.firstQuery = usedQueries;
+            scope.slotCount = slotCount;
+            scope.pending.assign(slotCount, false);
+            usedQueries += slotCount * 2;
+        }
+        scopes.push_back(std::move(scope));
+        return static_cast<uint32_t>(scopes.size() - 1);
+    }
+
+    uint32_t GpuProfiler::nextSlot(uint32_t scope)
+    {
+        Scope & s = scopes[scope];
+        if (s.slotCount == 0) {
+            return 0;
+        }
+        uint32_t slot = s.nextSlot;
+        s.nextSlot = (s.nextSlot + 1) % s.slotCount;
+
+        collect(scope, slot);
+        if (s.pending[slot]) {
+            s.pending[slot] = false;
+            s.dropped++;
+        }
+        return slot;
+    }
+
+    void GpuProfiler::begin(VkCommandBuffer cmdBuffer, uint32_t scope, uint32_t slot, VkPipelineStageFlagBits stage)
+    {
+        const Scope & s = scopes[scope];
+        if (slot >= s.slotCount) {
+            return;
+        }
+        uint32_t query = s.firstQuery + slot * 2;
+        vkCmdResetQueryPool(cmdBuffer, queryPool, query, 2);
+        vkCmdWriteTimestamp(cmdBuffer, stage, queryPool, query);
+    }
+
+    void GpuProfiler::end(VkCommandBuffer cmdBuffer, uint32_t scope, uint32_t slot, VkPipelineStageFlagBits stage)
+    {
+        const Scope & s = scopes[scope];
+        if (slot >= s.slotCount) {
+            return;
+        }
+        vkCmdWriteTimestamp(cmdBuffer, stage, queryPool, s.firstQuery + slot * 2 + 1);
+    }
+
+    void GpuProfiler::submitted(uint32_t scope, uint32_t slot)
+    {
+        Scope & s = scopes[scope];
+        if (slot < s.slotCount) {
+            s.pending[slot] = true;
+        }
+    }
+
+    void GpuProfiler::collect(uint32_t scope, uint32_t slot)
+    {
+        Scope & s = scopes[scope];
+        if (slot >= s.slotCount || !s.pending[slot]) {
+            return;
+        }
+
+        // Each timestamp is followed by its availability, without VK_QUERY_RESULT_WAIT_BIT this returns right away
+        uint64_t results[4] = {};
+        VkResult result = vkGetQueryPoolResults(device, queryPool, s.firstQuery + slot * 2, 2, sizeof(results), results, 2 * sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if ((result != VK_SUCCESS && result != VK_NOT_READY) || results[1] == 0 || results[3] == 0) {
+            return;
+        }
+        s.pending[slot] = false;
+
+        uint64_t ticks = ((results[2] & timestampMask) - (results[0] & timestampMask)) & timestampMask;
+        double ms = ticks * timestampPeriod / 1000000.0;
+        if (s.window.size() < windowSize) {
+            s.window.push_back(ms);
+        } else {
+            s.window[s.samples % windowSize] = ms;
+        }
+        s.samples++;
+    }
+
+    void GpuProfiler::update()
+    {
+        for (uint32_t scope = 0; scope < scopes.size(); scope++) {
+            for (uint32_t slot = 0; slot < scopes[scope].slotCount; slot++) {
+                collect(scope, slot);
+            }
+        }
+    }
+
+    std::vector<GpuScopeStats> GpuProfiler::stats() const
+    {
+        std::vector<GpuScopeStats> result;
+        for (const Scope & s : scopes) {
+            GpuScopeStats stats;
+            stats.name = s.name;
+            stats.samples = s.samples;
+            stats.dropped = s.dropped;
+            if (!s.window.empty()) {
+                std::vector<double> sorted = s.window;
+                std::sort(sorted.begin(), sorted.end());
+                stats.minMs = sorted.front();
+                for (double ms : sorted) {
+                    stats.avgMs += ms;
+                }
+                stats.avgMs /= sorted.size();
+                size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99));
+                stats.p99Ms = sorted[rank];
+            }
+            result.push_back(stats);
+        }
+        return result;
+    }
+}
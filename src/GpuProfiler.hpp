@@ -0,0 +1,121 @@
+/*
+* GPU timestamp profiler
+*
+* Measures the GPU time of named scopes with pairs of vkCmdWriteTimestamp. Every scope owns a ring of query pairs in a
+* shared query pool, results are only read once the GPU has written them so reading never stalls the render thread.
+* The durations of the last samples of each scope are kept to report a rolling min, average and 99th percentile
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+    struct GpuScopeStats
+    {
+        std::string name;
+        /** @brief Number of samples taken since the scope was added */
+        uint64_t samples = 0;
+        /** @brief Samples whose query slot was reused before the GPU had written the result */
+        uint64_t dropped = 0;
+        /** @brief Statistics in milliseconds over the last GpuProfiler::windowSize samples */
+        double minMs = 0.0;
+        double avgMs = 0.0;
+        double p99Ms = 0.0;
+    };
+
+    class GpuProfiler
+    {
+    public:
+        /** @brief Number of recent samples the rolling statistics are computed from */
+        static constexpr uint32_t windowSize = 256;
+
+        ~GpuProfiler();
+
+        /**
+        * Create the query pool
+        *
+        * @param vulkanDevice Device to create the query pool on
+        * @param queueFamilyIndex Queue family the measured command buffers are submitted to
+        * @param maxSlots Total number of query pairs of all scopes added later on
+        *
+        * @return False if the queue family doesn't support timestamps, all other calls do nothing in that case
+        */
+        bool create(vks::VulkanDevice * vulkanDevice, uint32_t queueFamilyIndex, uint32_t maxSlots);
+
+        void destroy();
+
+        bool enabled() const
+        { return queryPool != VK_NULL_HANDLE; }
+
+        /**
+        * Add a named scope
+        *
+        * @param name Name used when reporting the scope
+        * @param slotCount Number of query pairs, at least the number of measurements of the scope that can be in flight
+        *
+        * @return Index of the scope
+        */
+        uint32_t addScope(const std::string & name, uint32_t slotCount);
+
+        /**
+        * Get the next slot of a scope's ring for a command buffer recorded every time it is submitted
+        *
+        * @note Collects the slot's previous result first, if the GPU hasn't written it yet that sample is dropped
+        */
+        uint32_t nextSlot(uint32_t scope);
+
+        /**
+        * Record resetting a slot and writing its start timestamp, must be recorded outside of a render pass
+        *
+        * @note Command buffers recorded once and submitted many times can keep a fixed slot, as long as collect() is
+        * called between submissions
+        */
+        void begin(VkCommandBuffer cmdBuffer, uint32_t scope, uint32_t slot, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+        /** @brief Record writing the end timestamp of a slot */
+        void end(VkCommandBuffer cmdBuffer, uint32_t scope, uint32_t slot, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+        /** @brief Mark a slot as submitted, its result is collected once the GPU has written it */
+        void submitted(uint32_t scope, uint32_t slot);
+
+        /** @brief Read the result of a submitted slot if the GPU has written it, never waits */
+        void collect(uint32_t scope, uint32_t slot);
+
+        /** @brief Collect all submitted slots whose results are available, call once per frame */
+        void update();
+
+        std::vector<GpuScopeStats> stats() const;
+
+    private:
+        struct Scope
+        {
+            std::string name;
+            uint32_t firstQuery = 0;
+            uint32_t slotCount = 0;
+            uint32_t nextSlot = 0;
+            std::vector<bool> pending;
+            // Ring of the last windowSize durations
+            std::vector<double> window;
+            uint64_t samples = 0;
+            uint64_t dropped = 0;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint32_t queryCount = 0;
+        uint32_t usedQueries = 0;
+        // Nanoseconds per timestamp tick
+        double timestampPeriod = 1.0;
+        uint64_t timestampMask = ~0ull;
+        std::vector<Scope> scopes;
+    };
+}
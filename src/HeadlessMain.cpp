@@ -0,0 +1,448 @@
+/*
+* Headless entry point
+*
+* Renders the example into offscreen images without a window, surface or swapchain and saves a screenshot of the
+* last frame. Runs on any Vulkan implementation, including software ones such as lavapipe
+*
+* With --pattern every frame is captured back to back into numbered files (e.g. --pattern out/frame_%05d.ppm)
+* and the capture throughput is reported along with where the time went
+*
+* Files are encoded as ppm, pam, QOI or PNG depending on their extension, --format selects the format of files without
+* a known extension and --level the PNG compression level (0-9). With --mmap ppm files are converted straight into
+* memory mapped files, pam files are always written straight from the readback memory when no swizzle is needed
+*
+* --frames-in-flight (1-3) sets how many frames the CPU may submit ahead of the GPU. Runs of more than one frame report
+* the frame rate and how long the CPU was blocked on frame fences, comparing 1 with 2 or 3 shows the gain of overlapping
+* CPU and GPU work
+*
+* The GPU time of the render pass and of the capture blit or copy is measured with timestamp queries and reported at
+* the end of every run
+*
+* --mesh renders a .obj or .mesh file instead of the triangle. Its vertices and indices are streamed to device local
+* buffers through the staging ring and the upload throughput is reported. --vertex-format half or snorm16 packs vertices
+* into 12 instead of 24 bytes, meshes of up to 65536 vertices always use 16 bit indices. --optimize reorders the mesh
+* for the vertex cache and vertex fetch (--optimize-overdraw also for less overdraw) and reports the simulated ACMR
+* and ATVR before and after
+*
+* --instances N draws N copies of the mesh on a grid in a single instanced draw, each with its own model matrix that is
+* rewritten every frame straight into the mapped instance buffer, and reports the CPU time per frame of that update
+*
+* The pipeline cache is loaded from pipeline_cache.bin in the output directory (or the file given with --pipeline-cache)
+* and saved back on exit. Every run reports the time to the first frame and the pipeline creation time, the first run
+* on a device compiles with a cold cache and the following ones with a warm cache
+*
+* prepare() runs its independent setup steps on --prepare-threads threads (4 by default, 1 runs them one after another),
+* the duration and thread of every step is reported with the startup times
+*
+* --draws N splits the instances into N draws and --record-threads N records them into secondary command buffers on N
+* threads, which the primary command buffer executes in order. The command buffer recording time is reported with the
+* startup times
+*
+* --record-sweep records the command buffers again with 1, 2, 4 and 8 recording threads before rendering and reports
+* the best recording time of each and the speedup over one thread, rendering then uses --record-threads again
+*
+* --rerecord records the command buffer of every frame anew, as a scene that changes every frame would, from one command
+* pool per frame in flight that is reset as a whole once the frame's fence has signaled. The recording time per frame
+* and the number of command buffers allocated over the run are reported
+*
+* With --trace the CPU trace markers are written to a Chrome trace JSON file on exit, which requires a build configured
+* with -DSCREENSHOT_TRACING=ON
+*
+* Usage: screenshot-headless [--frames N] [--width W] [--height H] [--pattern PATTERN] [--format ppm|pam|qoi|png] [--level N]
+*                            [--mmap] [--frames-in-flight N] [--trace FILE] [--mesh FILE]
+*                            [--vertex-format float|half|snorm16] [--optimize] [--optimize-overdraw] [--instances N]
+*                            [--pipeline-cache FILE] [--prepare-threads N] [--draws N] [--record-threads N] [--record-sweep]
+*                            [--rerecord] [--assets DIR] [--output DIR]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ScreenshotExample.hpp"
+#include "Trace.hpp"
+
+static std::string assetPath;
+static std::string outputPath = ".";
+
+const std::string getAssetPath()
+{
+    return assetPath;
+}
+
+const std::string getOutputPath()
+{
+    return outputPath;
+}
+
+// A pattern must contain exactly one integer conversion for the frame number, e.g. %d or %05u
+static bool isValidPattern(const std::string & pattern)
+{
+    uint32_t conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+            i++;
+            continue;
+        }
+        size_t end = pattern.find_first_not_of("0123456789", i + 1);
+        if (end == std::string::npos || (pattern[end] != 'd' && pattern[end] != 'u')) {
+            return false;
+        }
+        conversions++;
+        i = end;
+    }
+    return conversions == 1;
+}
+
+static std::string formatPattern(const std::string & pattern, uint32_t frame)
+{
+    char filename[4096];
+    snprintf(filename, sizeof(filename), pattern.c_str(), frame);
+    return filename;
+}
+
+static void printThroughput(ScreenshotExample & example, uint32_t frames, uint32_t width, uint32_t height, double totalMs)
+{
+    vks::ScreenshotStats stats = example.getScreenshotStats();
+    double seconds = totalMs / 1000.0;
+    double perFrame = stats.images > 0 ? 1.0 / stats.images : 0.0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Captured " << stats.images << " of " << frames << " frames in " << totalMs << " ms" << std::endl;
+    std::cout << "  " << stats.images / seconds << " frames/s, " << stats.bytes / (1024.0 * 1024.0) / seconds << " MB/s written" << std::endl;
+    if (stats.bytes > 0) {
+        double rawBytes = double(stats.images) * width * height * 3;
+        std::cout << "  " << rawBytes / stats.bytes << "x smaller than raw RGB" << std::endl;
+    }
+    std::cout << "Time per frame on the writer thread (ms):" << std::endl;
+    std::cout << "  gpu copy " << stats.copyMs * perFrame << " (waiting for the copy fence)" << std::endl;
+    std::cout << "  map      " << example.getReadbackMapTime() << " once at startup, readback images are persistently mapped" << std::endl;
+    std::cout << "  convert  " << stats.convertMs * perFrame << std::endl;
+    std::cout << "  write    " << stats.writeMs * perFrame << std::endl;
+}
+
+static void printFramePacing(ScreenshotExample & example, double totalMs)
+{
+    ScreenshotExample::FramePacingStats stats = example.getFramePacingStats();
+    double blocked = stats.frameMs > 0.0 ? std::min(stats.fenceWaitMs / stats.frameMs, 1.0) : 0.0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << stats.framesInFlight << " frames in flight: " << stats.frames / (totalMs / 1000.0) << " frames/s, "
+              << stats.frameMs << " ms per frame" << std::endl;
+    std::cout << "  CPU blocked on frame fences " << stats.fenceWaitMs << " ms per frame (" << blocked * 100.0 << "%), "
+              << "working alongside the GPU for the remaining " << (1.0 - blocked) * 100.0 << "%" << std::endl;
+}
+
+static void printMeshOptimization(ScreenshotExample & example)
+{
+    vks::MeshOptimizationStats stats = example.getMeshOptimizationStats();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Optimized the mesh in " << std::setprecision(2) << stats.ms << " ms, simulated " << vks::defaultCacheSize << " entry vertex cache:" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "  ACMR " << stats.before.acmr << " -> " << stats.after.acmr << " transformed vertices per triangle" << std::endl;
+    std::cout << "  ATVR " << stats.before.atvr << " -> " << stats.after.atvr << " transformed vertices per vertex" << std::endl;
+}
+
+static void printUploads(ScreenshotExample & example)
+{
+    double uploadMs;
+    vks::UploadStats stats = example.getUploadStats(uploadMs);
+    double megabytes = stats.bytes / (1024.0 * 1024.0);
+
+    std::cout << std::fixed << std::setprecision(2);
+    uint32_t indexBits = example.indices.type == VK_INDEX_TYPE_UINT16 ? 16 : 32;
+    std::cout << "Staged " << megabytes << " MB of geometry (" << vks::vertices::formatName(example.vertexFormat) << " vertices, "
+              << indexBits << " bit indices) in " << uploadMs << " ms (" << megabytes / (uploadMs / 1000.0) << " MB/s), "
+              << stats.submits << " submits with " << stats.regions << " copy regions, " << stats.stallMs << " ms waiting for ring space" << std::endl;
+}
+
+// Run twice to compare, the first run on a device writes the cache the second one starts from
+static void printStartup(ScreenshotExample & example)
+{
+    ScreenshotExample::StartupStats stats = example.getStartupStats();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "First frame after " << stats.firstFrameMs << " ms, prepare " << stats.prepareMs << " ms, pipeline creation "
+              << stats.pipelineMs << " ms with a " << (stats.pipelineCache.warm ? "warm" : "cold") << " pipeline cache";
+    if (stats.pipelineCache.warm) {
+        std::cout << " (" << stats.pipelineCache.loadedBytes / 1024.0 << " KB loaded in " << stats.pipelineCache.loadMs << " ms)";
+    } else if (stats.pipelineCache.rejected) {
+        std::cout << " (stored cache " << stats.pipelineCache.rejected << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "  " << stats.shaders.modules << " shader modules (" << stats.shaders.embedded << " embedded, "
+              << stats.shaders.mappedBytes / 1024.0 << " KB mapped, " << stats.shaders.deduplicated << " shared) in "
+              << stats.shaders.loadMs << " ms" << std::endl;
+    std::cout << "  " << example.drawCount << " draws per command buffer recorded in " << stats.recordMs << " ms on "
+              << example.recordThreads << (example.recordThreads == 1 ? " thread" : " threads") << std::endl;
+    std::cout << "  prepare steps (critical path " << stats.prepareCriticalPathMs << " ms):" << std::endl;
+    for (const auto & step : stats.prepareSteps) {
+        std::cout << "    " << std::left << std::setw(20) << step.name << std::right << "start " << std::setw(8) << step.startMs
+                  << ", " << std::setw(8) << step.durationMs << " ms on thread " << step.thread << std::endl;
+    }
+}
+
+static void printInstanceUpdates(ScreenshotExample & example)
+{
+    if (example.instanceCount == 0) {
+        return;
+    }
+    double updateMs = example.getInstanceUpdateTime();
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Updated " << example.instanceCount << " instance transforms in " << updateMs << " ms per frame ("
+              << updateMs * 1e6 / example.instanceCount << " ns per instance)" << std::endl;
+}
+
+// Allocations stop once every frame's pool holds as many command buffers as a frame needs
+static void printFrameRecording(ScreenshotExample & example)
+{
+    if (!example.rerecordEveryFrame) {
+        return;
+    }
+    vks::CommandPoolStats poolStats;
+    double recordMs = example.getFrameRecordTime(poolStats);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Recorded the command buffer of every frame in " << recordMs << " ms per frame, " << poolStats.resets << " pool resets, "
+              << poolStats.acquired << " command buffers used, " << poolStats.allocated << " allocated" << std::endl;
+}
+
+// Records the same draws through the real parallel recorder with more and more threads
+static void printRecordingSweep(ScreenshotExample & example, uint32_t recordThreads)
+{
+    const uint32_t iterations = 10;
+    std::cout << "Recording " << example.drawCount << " draws per command buffer (best of " << iterations << "):" << std::endl;
+    std::cout << std::fixed;
+    double singleMs = 0.0;
+    for (uint32_t threadCount : { 1u, 2u, 4u, 8u }) {
+        double ms = example.measureRecording(threadCount, iterations);
+        if (threadCount == 1) {
+            singleMs = ms;
+        }
+        std::cout << "  " << std::setw(2) << threadCount << (threadCount == 1 ? " thread " : " threads") << std::setprecision(3) << std::setw(10) << ms
+                  << " ms" << std::setprecision(2) << std::setw(8) << singleMs / ms << "x" << std::endl;
+    }
+    example.measureRecording(recordThreads, 1);
+}
+
+// Rolling GPU times of the render pass and the capture blit or copy, the larger of the two limits the capture rate
+static void printGpuTimes(ScreenshotExample & example)
+{
+    std::vector<vks::GpuScopeStats> scopes = example.getGpuScopeStats();
+    if (scopes.empty()) {
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "GPU time (ms) over the last " << vks::GpuProfiler::windowSize << " samples:" << std::endl;
+    for (const auto & scope : scopes) {
+        std::cout << "  " << std::left << std::setw(14) << scope.name << std::right
+                  << "min " << scope.minMs << ", avg " << scope.avgMs << ", p99 " << scope.p99Ms
+                  << " (" << scope.samples << " samples";
+        if (scope.dropped > 0) {
+            std::cout << ", " << scope.dropped << " dropped";
+        }
+        std::cout << ")" << std::endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t frames = 1;
+    uint32_t width = 800;
+    uint32_t height = 600;
+    std::string pattern;
+    vks::image::ImageFormat format = vks::image::ImageFormat::PPM;
+    int compressionLevel = vks::image::defaultCompressionLevel;
+    bool mappedWrites = false;
+    uint32_t framesInFlight = 2;
+    std::string traceFilename;
+    std::string meshFilename;
+    bool optimizeMesh = false;
+    bool optimizeOverdraw = false;
+    vks::vertices::VertexFormat vertexFormat = vks::vertices::VertexFormat::Float32;
+    uint32_t instanceCount = 0;
+    std::string pipelineCacheFilename;
+    uint32_t prepareThreads = 4;
+    uint32_t drawCount = 1;
+    uint32_t recordThreads = 1;
+    bool recordSweep = false;
+    bool rerecord = false;
+
+    // Shaders are compiled next to the executable by default
+    std::string executable = argv[0];
+    size_t separator = executable.find_last_of('/');
+    assetPath = (separator == std::string::npos ? std::string(".") : executable.substr(0, separator)) + "/data/";
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frames = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--width") == 0 && hasValue) {
+            width = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--height") == 0 && hasValue) {
+            height = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--pattern") == 0 && hasValue) {
+            pattern = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && hasValue) {
+            if (!vks::image::formatFromName(argv[++i], format)) {
+                std::cerr << "Error: Unknown format \"" << argv[i] << "\", expected ppm, pam, qoi or png" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--level") == 0 && hasValue) {
+            compressionLevel = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mmap") == 0) {
+            mappedWrites = true;
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && hasValue) {
+            framesInFlight = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--trace") == 0 && hasValue) {
+            traceFilename = argv[++i];
+        } else if (strcmp(argv[i], "--mesh") == 0 && hasValue) {
+            meshFilename = argv[++i];
+        } else if (strcmp(argv[i], "--vertex-format") == 0 && hasValue) {
+            if (!vks::vertices::formatFromName(argv[++i], vertexFormat)) {
+                std::cerr << "Error: Unknown vertex format \"" << argv[i] << "\", expected float, half or snorm16" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--optimize") == 0) {
+            optimizeMesh = true;
+        } else if (strcmp(argv[i], "--optimize-overdraw") == 0) {
+            optimizeMesh = true;
+            optimizeOverdraw = true;
+        } else if (strcmp(argv[i], "--instances") == 0 && hasValue) {
+            instanceCount = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--pipeline-cache") == 0 && hasValue) {
+            pipelineCacheFilename = argv[++i];
+        } else if (strcmp(argv[i], "--prepare-threads") == 0 && hasValue) {
+            prepareThreads = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--draws") == 0 && hasValue) {
+            drawCount = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--record-threads") == 0 && hasValue) {
+            recordThreads = (uint32_t) std::strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--record-sweep") == 0) {
+            recordSweep = true;
+        } else if (strcmp(argv[i], "--rerecord") == 0) {
+            rerecord = true;
+        } else if (strcmp(argv[i], "--assets") == 0 && hasValue) {
+            assetPath = std::string(argv[++i]) + "/";
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--frames N] [--width W] [--height H] [--pattern PATTERN] [--format ppm|pam|qoi|png] [--level N]"
+                      << " [--mmap] [--frames-in-flight N] [--trace FILE] [--mesh FILE]"
+                      << " [--vertex-format float|half|snorm16] [--optimize] [--optimize-overdraw] [--instances N]"
+                      << " [--pipeline-cache FILE] [--prepare-threads N] [--draws N] [--record-threads N] [--record-sweep]"
+                      << " [--rerecord] [--assets DIR] [--output DIR]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (frames == 0 || width == 0 || height == 0) {
+        std::cerr << "Error: Frame count, width and height must be greater than zero" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (compressionLevel < 0 || compressionLevel > 9) {
+        std::cerr << "Error: Compression level must be between 0 and 9" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (prepareThreads == 0 || recordThreads == 0) {
+        std::cerr << "Error: Prepare and record threads must be greater than zero" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (drawCount == 0 || drawCount > std::max(instanceCount, 1u)) {
+        std::cerr << "Error: Draws must be between 1 and the number of instances" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (framesInFlight < 1 || framesInFlight > ScreenshotExample::maxFramesInFlight) {
+        std::cerr << "Error: Frames in flight must be between 1 and " << ScreenshotExample::maxFramesInFlight << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!traceFilename.empty() && !vks::trace::enabled()) {
+        std::cerr << "Error: Tracing is not compiled in, configure with -DSCREENSHOT_TRACING=ON" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!pattern.empty() && !isValidPattern(pattern)) {
+        std::cerr << "Error: Pattern \"" << pattern << "\" must contain exactly one %d or %u for the frame number" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ScreenshotExample example(true, width, height);
+    example.optimizeMeshes = optimizeMesh;
+    example.optimizeOverdraw = optimizeOverdraw;
+    if (!meshFilename.empty() && !example.loadMesh(meshFilename)) {
+        return EXIT_FAILURE;
+    }
+    if (!meshFilename.empty() && optimizeMesh) {
+        printMeshOptimization(example);
+    }
+    if (!example.initVulkan()) {
+        return EXIT_FAILURE;
+    }
+    example.framesInFlight = framesInFlight;
+    example.traceFilename = traceFilename;
+    example.vertexFormat = vertexFormat;
+    example.instanceCount = instanceCount;
+    example.pipelineCacheFilename = pipelineCacheFilename;
+    example.prepareThreads = prepareThreads;
+    example.drawCount = drawCount;
+    example.recordThreads = recordThreads;
+    example.rerecordEveryFrame = rerecord;
+    if (!example.prepare()) {
+        return EXIT_FAILURE;
+    }
+    if (!meshFilename.empty()) {
+        printUploads(example);
+    }
+    if (recordSweep) {
+        printRecordingSweep(example, recordThreads);
+    }
+    example.screenshotFormat = format;
+    example.compressionLevel = compressionLevel;
+    example.mappedScreenshotWrites = mappedWrites;
+
+    if (pattern.empty()) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < frames; i++) {
+            // Capture the last frame, the screenshot is written by the time the example is destroyed
+            example.doScreenshot = i == frames - 1;
+            example.render();
+        }
+        if (frames > 1) {
+            printFramePacing(example, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        printStartup(example);
+        printInstanceUpdates(example);
+        printFrameRecording(example);
+        printGpuTimes(example);
+        return EXIT_SUCCESS;
+    }
+
+    // Capture every frame, rendering waits for a free readback image whenever the writer falls behind
+    example.waitForReadback = true;
+    example.announceScreenshots = false;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        example.screenshotFilename = formatPattern(pattern, i);
+        example.doScreenshot = true;
+        example.render();
+    }
+    example.waitForScreenshots();
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printThroughput(example, frames, width, height, totalMs);
+    printFramePacing(example, totalMs);
+    printStartup(example);
+    printInstanceUpdates(example);
+    printFrameRecording(example);
+    printGpuTimes(example);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,413 @@
+/*
+* Image encoders for screenshot readback data
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ImageEncoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <zlib.h>
+
+namespace vks::image
+{
+    // Rows are converted to RGB in blocks of about this size before being encoded
+    static const size_t encodeBlockSize = 1024 * 1024;
+    // Size of the IDAT chunks compressed PNG data is split into
+    static const size_t pngChunkSize = 256 * 1024;
+
+    static double elapsedMs(std::chrono::high_resolution_clock::time_point & start)
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    }
+
+    static uint32_t rowsPerBlock(const MappedImage & image)
+    {
+        return std::max<uint32_t>(1, static_cast<uint32_t>(encodeBlockSize / std::max<size_t>(size_t(image.width) * 3, 1)));
+    }
+
+    static void storeBigEndian(uint8_t * dst, uint32_t value)
+    {
+        dst[0] = uint8_t(value >> 24);
+        dst[1] = uint8_t(value >> 16);
+        dst[2] = uint8_t(value >> 8);
+        dst[3] = uint8_t(value);
+    }
+
+    static std::string toLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+        return text;
+    }
+
+    const char * formatName(ImageFormat format)
+    {
+        switch (format) {
+            case ImageFormat::PPM: return "ppm";
+            case ImageFormat::PAM: return "pam";
+            case ImageFormat::QOI: return "qoi";
+            case ImageFormat::PNG: return "png";
+        }
+        return "unknown";
+    }
+
+    const char * formatExtension(ImageFormat format)
+    {
+        switch (format) {
+            case ImageFormat::PPM: return ".ppm";
+            case ImageFormat::PAM: return ".pam";
+            case ImageFormat::QOI: return ".qoi";
+            case ImageFormat::PNG: return ".png";
+        }
+        return "";
+    }
+
+    bool formatFromFilename(const std::string & filename, ImageFormat & format)
+    {
+        size_t dot = filename.find_last_of('.');
+        if (dot == std::string::npos || filename.find('/', dot) != std::string::npos) {
+            return false;
+        }
+        return formatFromName(filename.substr(dot + 1), format);
+    }
+
+    bool formatFromName(const std::string & name, ImageFormat & format)
+    {
+        std::string lowerName = toLower(name);
+        for (ImageFormat candidate : { ImageFormat::PPM, ImageFormat::PAM, ImageFormat::QOI, ImageFormat::PNG }) {
+            if (lowerName == formatName(candidate)) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool PPMEncoder::encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings) const
+    {
+        std::string header = ppmHeader(image.width, image.height);
+        stream.write(header.data(), header.size());
+        return writeRGB(stream, image, timings);
+    }
+
+    bool PAMEncoder::encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings) const
+    {
+        if (image.layout != vks::pixels::PixelLayout::R8G8B8A8) {
+            std::string header = pamHeader(image.width, image.height, 3);
+            stream.write(header.data(), header.size());
+            return writeRGB(stream, image, timings);
+        }
+
+        std::string header = pamHeader(image.width, image.height, 4);
+        auto start = std::chrono::high_resolution_clock::now();
+        stream.write(header.data(), header.size());
+        const size_t rowSize = size_t(image.width) * 4;
+        if (image.rowPitch == rowSize) {
+            stream.write((const char *) image.data, rowSize * image.height);
+        } else {
+            for (uint32_t y = 0; y < image.height; y++) {
+                stream.write((const char *) image.data + y * image.rowPitch, rowSize);
+            }
+        }
+        if (timings) {
+            timings->writeMs += elapsedMs(start);
+        }
+        return !stream.fail();
+    }
+
+    /*
+        QOI
+    */
+
+    namespace
+    {
+        // Encoder state carried from one block of pixels to the next
+        struct QOIState
+        {
+            // Previously seen pixels, packed as r | g << 8 | b << 16 | a << 24
+            uint32_t index[64] = {};
+            uint8_t r = 0;
+            uint8_t g = 0;
+            uint8_t b = 0;
+            uint32_t run = 0;
+        };
+
+        const uint8_t qoiOpIndex = 0x00;
+        const uint8_t qoiOpDiff = 0x40;
+        const uint8_t qoiOpLuma = 0x80;
+        const uint8_t qoiOpRun = 0xc0;
+        const uint8_t qoiOpRGB = 0xfe;
+        const uint32_t qoiMaxRun = 62;
+        // Worst case size of an encoded pixel (QOI_OP_RGB)
+        const size_t qoiMaxPixelSize = 4;
+    }
+
+    // Encode packed RGB pixels, the alpha channel of every pixel is 255. Returns the end of the encoded data
+    static uint8_t * encodeQOIPixels(QOIState & state, const uint8_t * rgb, size_t count, uint8_t * out)
+    {
+        for (size_t i = 0; i < count; i++, rgb += 3) {
+            uint8_t r = rgb[0];
+            uint8_t g = rgb[1];
+            uint8_t b = rgb[2];
+
+            if (r == state.r && g == state.g && b == state.b) {
+                if (++state.run == qoiMaxRun) {
+                    *out++ = qoiOpRun | uint8_t(state.run - 1);
+                    state.run = 0;
+                }
+                continue;
+            }
+            if (state.run > 0) {
+                *out++ = qoiOpRun | uint8_t(state.run - 1);
+                state.run = 0;
+            }
+
+            uint32_t pixel = r | (g << 8) | (b << 16) | 0xff000000u;
+            uint32_t hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+            if (state.index[hash] == pixel) {
+                *out++ = qoiOpIndex | uint8_t(hash);
+            } else {
+                state.index[hash] = pixel;
+
+                int8_t dr = int8_t(r - state.r);
+                int8_t dg = int8_t(g - state.g);
+                int8_t db = int8_t(b - state.b);
+                int8_t drg = int8_t(dr - dg);
+                int8_t dbg = int8_t(db - dg);
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    *out++ = qoiOpDiff | uint8_t((dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+                    *out++ = qoiOpLuma | uint8_t(dg + 32);
+                    *out++ = uint8_t((drg + 8) << 4 | (dbg + 8));
+                } else {
+                    *out++ = qoiOpRGB;
+                    *out++ = r;
+                    *out++ = g;
+                    *out++ = b;
+                }
+            }
+            state.r = r;
+            state.g = g;
+            state.b = b;
+        }
+        return out;
+    }
+
+    bool QOIEncoder::encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings) const
+    {
+        uint8_t header[14] = { 'q', 'o', 'i', 'f' };
+        storeBigEndian(header + 4, image.width);
+        storeBigEndian(header + 8, image.height);
+        header[12] = 3;     // RGB
+        header[13] = 0;     // sRGB with linear alpha
+        stream.write((const char *) header, sizeof(header));
+
+        const size_t rowSize = size_t(image.width) * 3;
+        const uint32_t blockRows = std::min(rowsPerBlock(image), image.height);
+        std::vector<uint8_t> block(rowSize * blockRows);
+        std::vector<uint8_t> encoded(size_t(image.width) * blockRows * qoiMaxPixelSize + 1);
+
+        QOIState state;
+        WriteTimings blockTimings;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t y = 0; y < image.height; y += blockRows) {
+            uint32_t rowCount = std::min(blockRows, image.height - y);
+            packRows(image, y, rowCount, block.data());
+            uint8_t * end = encodeQOIPixels(state, block.data(), size_t(image.width) * rowCount, encoded.data());
+            blockTimings.convertMs += elapsedMs(start);
+            stream.write((const char *) encoded.data(), end - encoded.data());
+            blockTimings.writeMs += elapsedMs(start);
+        }
+
+        // A run still open at the end of the image and the end marker
+        std::vector<uint8_t> tail;
+        if (state.run > 0) {
+            tail.push_back(qoiOpRun | uint8_t(state.run - 1));
+        }
+        tail.insert(tail.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+        stream.write((const char *) tail.data(), tail.size());
+        blockTimings.writeMs += elapsedMs(start);
+
+        if (timings) {
+            timings->convertMs += blockTimings.convertMs;
+            timings->writeMs += blockTimings.writeMs;
+        }
+        return !stream.fail();
+    }
+
+    /*
+        PNG
+    */
+
+    static void writePNGChunk(std::ostream & stream, const char * type, const uint8_t * data, uint32_t size)
+    {
+        uint8_t header[8];
+        storeBigEndian(header, size);
+        std::copy(type, type + 4, header + 4);
+        uLong crc = crc32(0, header + 4, 4);
+        if (size > 0) {
+            crc = crc32(crc, data, size);
+        }
+        uint8_t footer[4];
+        storeBigEndian(footer, uint32_t(crc));
+
+        stream.write((const char *) header, sizeof(header));
+        stream.write((const char *) data, size);
+        stream.write((const char *) footer, sizeof(footer));
+    }
+
+    PNGEncoder::PNGEncoder(int compressionLevel)
+        : compressionLevel(std::clamp(compressionLevel, 0, 9))
+    {
+    }
+
+    bool PNGEncoder::encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings) const
+    {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        stream.write((const char *) signature, sizeof(signature));
+
+        uint8_t header[13];
+        storeBigEndian(header, image.width);
+        storeBigEndian(header + 4, image.height);
+        header[8] = 8;      // Bit depth
+        header[9] = 2;      // Truecolor (RGB)
+        header[10] = 0;     // Deflate
+        header[11] = 0;     // Adaptive filtering
+        header[12] = 0;     // No interlace
+        writePNGChunk(stream, "IHDR", header, sizeof(header));
+
+        z_stream zstream = {};
+        if (deflateInit(&zstream, compressionLevel) != Z_OK) {
+            std::cerr << "Error: Could not initialize zlib" << std::endl;
+            return false;
+        }
+
+        const size_t rowSize = size_t(image.width) * 3;
+        const uint32_t blockRows = std::min(rowsPerBlock(image), image.height);
+        std::vector<uint8_t> block(rowSize * blockRows);
+        // Every row is prefixed with its filter type
+        std::vector<uint8_t> filtered((rowSize + 1) * blockRows);
+        std::vector<uint8_t> previousRow(rowSize, 0);
+        std::vector<uint8_t> compressed(pngChunkSize);
+
+        WriteTimings blockTimings;
+        auto start = std::chrono::high_resolution_clock::now();
+        zstream.next_out = compressed.data();
+        zstream.avail_out = uInt(compressed.size());
+        // Compressed data is collected until a chunk is full, so chunks are only written with pngChunkSize bytes
+        auto deflateBlock = [&](const uint8_t * data, size_t size, int flush) {
+            zstream.next_in = const_cast<Bytef *>(data);
+            zstream.avail_in = uInt(size);
+            int result;
+            do {
+                result = deflate(&zstream, flush);
+                size_t produced = compressed.size() - zstream.avail_out;
+                if (zstream.avail_out == 0 || (result == Z_STREAM_END && produced > 0)) {
+                    blockTimings.convertMs += elapsedMs(start);
+                    writePNGChunk(stream, "IDAT", compressed.data(), uint32_t(produced));
+                    blockTimings.writeMs += elapsedMs(start);
+                    zstream.next_out = compressed.data();
+                    zstream.avail_out = uInt(compressed.size());
+                }
+            } while (zstream.avail_in > 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+        };
+
+        // The Up filter stores the difference to the row above, which is cheap and removes most of the
+        // redundancy of rendered images. Without compression filtering would only cost time
+        const uint8_t filterType = compressionLevel > 0 ? 2 : 0;
+        for (uint32_t y = 0; y < image.height; y += blockRows) {
+            uint32_t rowCount = std::min(blockRows, image.height - y);
+            packRows(image, y, rowCount, block.data());
+
+            uint8_t * dst = filtered.data();
+            for (uint32_t row = 0; row < rowCount; row++) {
+                const uint8_t * src = block.data() + row * rowSize;
+                const uint8_t * above = row > 0 ? src - rowSize : previousRow.data();
+                *dst++ = filterType;
+                if (filterType == 0) {
+                    std::copy(src, src + rowSize, dst);
+                } else {
+                    for (size_t i = 0; i < rowSize; i++) {
+                        dst[i] = uint8_t(src[i] - above[i]);
+                    }
+                }
+                dst += rowSize;
+            }
+            std::copy(block.data() + (rowCount - 1) * rowSize, block.data() + rowCount * rowSize, previousRow.begin());
+
+            deflateBlock(filtered.data(), (rowSize + 1) * rowCount, Z_NO_FLUSH);
+        }
+        deflateBlock(nullptr, 0, Z_FINISH);
+        deflateEnd(&zstream);
+        blockTimings.convertMs += elapsedMs(start);
+
+        writePNGChunk(stream, "IEND", nullptr, 0);
+        blockTimings.writeMs += elapsedMs(start);
+
+        if (timings) {
+            timings->convertMs += blockTimings.convertMs;
+            timings->writeMs += blockTimings.writeMs;
+        }
+        return !stream.fail();
+    }
+
+    std::unique_ptr<ImageEncoder> createEncoder(ImageFormat format, int compressionLevel)
+    {
+        switch (format) {
+            case ImageFormat::PPM: return std::make_unique<PPMEncoder>();
+            case ImageFormat::PAM: return std::make_unique<PAMEncoder>();
+            case ImageFormat::QOI: return std::make_unique<QOIEncoder>();
+            case ImageFormat::PNG: return std::make_unique<PNGEncoder>(compressionLevel);
+        }
+        return nullptr;
+    }
+
+    bool writeImage(const char * filename, const MappedImage & image, const ImageEncoder & encoder, WriteTimings * timings, uint64_t * fileSize)
+    {
+        if (encoder.format() == ImageFormat::PAM && image.layout == vks::pixels::PixelLayout::R8G8B8A8) {
+            if (!writePAMDirect(filename, image, timings)) {
+                return false;
+            }
+            if (fileSize) {
+                *fileSize = pamHeader(image.width, image.height, 4).size() + uint64_t(image.width) * image.height * 4;
+            }
+            return true;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::ofstream file(filename, std::ios::out | std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open \"" << filename << "\" for writing" << std::endl;
+            return false;
+        }
+
+        WriteTimings encodeTimings;
+        encoder.encode(file, image, &encodeTimings);
+        std::streamoff size = file.tellp();
+        file.close();
+
+        if (timings) {
+            timings->convertMs += encodeTimings.convertMs;
+            timings->writeMs += elapsedMs(start) - encodeTimings.convertMs;
+        }
+
+        if (!file) {
+            std::cerr << "Error: Could not write \"" << filename << "\"" << std::endl;
+            return false;
+        }
+        if (fileSize) {
+            *fileSize = uint64_t(size);
+        }
+        return true;
+    }
+}
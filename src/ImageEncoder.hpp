@@ -0,0 +1,150 @@
+/*
+* Image encoders for screenshot readback data
+*
+* Encodes a mapped, row pitched image as binary ppm, pam, QOI or PNG behind a common interface. The format is picked
+* from the file extension or chosen explicitly, the PNG compression level trades encoding time for file size
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "ImageWriter.hpp"
+
+namespace vks::image
+{
+    enum class ImageFormat
+    {
+        /** @brief Uncompressed binary ppm (P6), the fastest to write and the largest on disk */
+        PPM,
+        /** @brief Uncompressed pam (P7), R8G8B8A8 images are written as RGB_ALPHA straight from the mapped memory */
+        PAM,
+        /** @brief Quite OK Image format, lossless and much faster to encode than PNG at a somewhat larger size */
+        QOI,
+        /** @brief Deflate compressed PNG, the compression level selects the trade-off between speed and size */
+        PNG,
+    };
+
+    /** @brief Compression level used if none is given, matches the zlib default */
+    const int defaultCompressionLevel = 6;
+
+    /** @brief Returns a readable name for an image format */
+    const char * formatName(ImageFormat format);
+
+    /** @brief Returns the file extension of an image format, including the dot */
+    const char * formatExtension(ImageFormat format);
+
+    /**
+    * Get the image format matching the extension of a filename (case insensitive)
+    *
+    * @param filename Filename or path to check
+    * @param format Set to the matching format if the extension is known
+    *
+    * @return True if the extension is one of .ppm, .pam, .qoi or .png
+    */
+    bool formatFromFilename(const std::string & filename, ImageFormat & format);
+
+    /**
+    * Get the image format with the given name (case insensitive)
+    *
+    * @param name Format name as returned by formatName, e.g. "qoi"
+    * @param format Set to the matching format if the name is known
+    *
+    * @return True if the name is one of ppm, pam, qoi or png
+    */
+    bool formatFromName(const std::string & name, ImageFormat & format);
+
+    /** @brief Encodes a mapped image into a file format, implementations are stateless and can be shared between threads */
+    class ImageEncoder
+    {
+    public:
+        virtual ~ImageEncoder() = default;
+
+        virtual ImageFormat format() const = 0;
+
+        /**
+        * Encode a mapped image into a stream
+        *
+        * @param stream Binary stream to write the encoded file to
+        * @param image Mapped source image
+        * @param (Optional) timings Accumulates the time spent converting and encoding (convertMs) and writing (writeMs)
+        *
+        * @return True if the complete file has been handed to the stream without an error
+        */
+        virtual bool encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings = nullptr) const = 0;
+    };
+
+    class PPMEncoder : public ImageEncoder
+    {
+    public:
+        ImageFormat format() const override
+        { return ImageFormat::PPM; }
+
+        bool encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings = nullptr) const override;
+    };
+
+    /** @brief Writes R8G8B8A8 images as RGB_ALPHA pam files without conversion, other layouts are converted to RGB */
+    class PAMEncoder : public ImageEncoder
+    {
+    public:
+        ImageFormat format() const override
+        { return ImageFormat::PAM; }
+
+        bool encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings = nullptr) const override;
+    };
+
+    /** @brief Writes 3 channel sRGB QOI files (https://qoiformat.org/qoi-specification.pdf) */
+    class QOIEncoder : public ImageEncoder
+    {
+    public:
+        ImageFormat format() const override
+        { return ImageFormat::QOI; }
+
+        bool encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings = nullptr) const override;
+    };
+
+    /** @brief Writes 8 bit RGB PNG files, rows are filtered with the Up filter and compressed with zlib */
+    class PNGEncoder : public ImageEncoder
+    {
+    public:
+        /** @param compressionLevel zlib compression level from 0 (stored, no compression) to 9 (smallest) */
+        explicit PNGEncoder(int compressionLevel = defaultCompressionLevel);
+
+        ImageFormat format() const override
+        { return ImageFormat::PNG; }
+
+        bool encode(std::ostream & stream, const MappedImage & image, WriteTimings * timings = nullptr) const override;
+
+    private:
+        int compressionLevel;
+    };
+
+    /**
+    * Create the encoder for an image format
+    *
+    * @param format Format to encode to
+    * @param compressionLevel Compression level for formats that have one, from 0 (fastest) to 9 (smallest)
+    */
+    std::unique_ptr<ImageEncoder> createEncoder(ImageFormat format, int compressionLevel = defaultCompressionLevel);
+
+    /**
+    * Encode a mapped image into a file
+    *
+    * @param filename Path of the file to write
+    * @param image Mapped source image
+    * @param encoder Encoder for the file format
+    * @param (Optional) timings Accumulates the time spent encoding and writing, opening and closing the file counts as writing
+    * @param (Optional) fileSize Set to the size of the written file in bytes
+    *
+    * @note pam files of R8G8B8A8 images bypass the stream and are written straight from the mapped image with writePAMDirect
+    *
+    * @return True if the file has been written completely
+    */
+    bool writeImage(const char * filename, const MappedImage & image, const ImageEncoder & encoder,
+                    WriteTimings * timings = nullptr, uint64_t * fileSize = nullptr);
+}
@@ -0,0 +1,327 @@
+/*
+* Image writer for screenshot readback data
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ImageWriter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace vks::image
+{
+    // Size of the staging block that converted rows are collected in before being handed to the stream
+    static const size_t writeBlockSize = 4 * 1024 * 1024;
+    // Stripes handed out per thread, more than one evens out threads that are slowed down by the disk
+    static const uint32_t stripesPerThread = 4;
+
+    std::string ppmHeader(uint32_t width, uint32_t height)
+    {
+        return "P6\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+    }
+
+    size_t ppmFileSize(uint32_t width, uint32_t height)
+    {
+        return ppmHeader(width, height).size() + size_t(width) * height * 3;
+    }
+
+    std::string pamHeader(uint32_t width, uint32_t height, uint32_t depth)
+    {
+        return "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height) + "\nDEPTH " + std::to_string(depth)
+            + "\nMAXVAL 255\nTUPLTYPE " + (depth == 4 ? "RGB_ALPHA" : "RGB") + "\nENDHDR\n";
+    }
+
+    void packRow(const uint8_t * src, uint8_t * dst, uint32_t width, vks::pixels::PixelLayout layout)
+    {
+        vks::pixels::convertToRGB(layout, src, dst, width);
+    }
+
+    void packRows(const MappedImage & image, uint32_t firstRow, uint32_t rowCount, uint8_t * dst)
+    {
+        const uint8_t * src = image.data + firstRow * image.rowPitch;
+        // Rows without padding can be treated as one long row
+        if (image.rowPitch == uint64_t(image.width) * 4) {
+            packRow(src, dst, image.width * rowCount, image.layout);
+            return;
+        }
+        for (uint32_t y = 0; y < rowCount; y++) {
+            packRow(src, dst, image.width, image.layout);
+            src += image.rowPitch;
+            dst += image.width * 3;
+        }
+    }
+
+    static double elapsedMs(std::chrono::high_resolution_clock::time_point & start)
+    {
+        auto now = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    }
+
+    bool writeRGB(std::ostream & stream, const MappedImage & image, WriteTimings * timings)
+    {
+        // Convert as many rows as fit into one block, then write the block with a single call
+        const size_t rowSize = size_t(image.width) * 3;
+        const uint32_t rowsPerBlock = std::max<uint32_t>(1, static_cast<uint32_t>(writeBlockSize / std::max<size_t>(rowSize, 1)));
+        std::vector<uint8_t> block(rowSize * std::min(rowsPerBlock, image.height));
+
+        WriteTimings blockTimings;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t y = 0; y < image.height; y += rowsPerBlock) {
+            uint32_t rowCount = std::min(rowsPerBlock, image.height - y);
+            packRows(image, y, rowCount, block.data());
+            blockTimings.convertMs += elapsedMs(start);
+            stream.write((const char *) block.data(), rowSize * rowCount);
+            blockTimings.writeMs += elapsedMs(start);
+        }
+        if (timings) {
+            timings->convertMs += blockTimings.convertMs;
+            timings->writeMs += blockTimings.writeMs;
+        }
+        return !stream.fail();
+    }
+
+    bool writePPM(const char * filename, const MappedImage & image, WriteTimings * timings)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::ofstream file(filename, std::ios::out | std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open \"" << filename << "\" for writing" << std::endl;
+            return false;
+        }
+
+        std::string header = ppmHeader(image.width, image.height);
+        file.write(header.data(), header.size());
+        WriteTimings rowTimings;
+        writeRGB(file, image, &rowTimings);
+        file.close();
+
+        if (timings) {
+            timings->convertMs += rowTimings.convertMs;
+            timings->writeMs += elapsedMs(start) - rowTimings.convertMs;
+        }
+
+        if (!file) {
+            std::cerr << "Error: Could not write \"" << filename << "\"" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Enough stripes to keep every thread busy, but never larger than a single staging block
+    static uint32_t stripeRows(const MappedImage & image, uint32_t threadCount)
+    {
+        const size_t rowSize = size_t(image.width) * 3;
+        const uint32_t rowsPerBlock = std::max<uint32_t>(1, static_cast<uint32_t>(writeBlockSize / std::max<size_t>(rowSize, 1)));
+        const uint32_t stripeCount = std::max<uint32_t>(1, threadCount * stripesPerThread);
+        return std::clamp<uint32_t>((image.height + stripeCount - 1) / stripeCount, 1, rowsPerBlock);
+    }
+
+    // pwrite may write less than asked for, e.g. when interrupted by a signal
+    static bool writeAt(int fd, const uint8_t * data, size_t size, off_t offset)
+    {
+        while (size > 0) {
+            ssize_t written = pwrite(fd, data, size, offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= written;
+            offset += written;
+        }
+        return true;
+    }
+
+    bool writePPMStriped(const char * filename, const MappedImage & image, vks::ThreadPool & pool, WriteTimings * timings)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open \"" << filename << "\" for writing: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        std::string header = ppmHeader(image.width, image.height);
+        bool success = ftruncate(fd, ppmFileSize(image.width, image.height)) == 0
+            && writeAt(fd, (const uint8_t *) header.data(), header.size(), 0);
+
+        const size_t rowSize = size_t(image.width) * 3;
+        const uint32_t rowsPerStripe = stripeRows(image, pool.size());
+
+        std::atomic<bool> stripesWritten { true };
+        std::vector<WriteTimings> stripeTimings((image.height + rowsPerStripe - 1) / rowsPerStripe);
+        if (success) {
+            pool.parallelFor(static_cast<uint32_t>(stripeTimings.size()), [&](uint32_t stripe) {
+                uint32_t firstRow = stripe * rowsPerStripe;
+                uint32_t rowCount = std::min(rowsPerStripe, image.height - firstRow);
+                // Allocated per stripe so threads never share a buffer, the cost is small next to converting a stripe
+                std::vector<uint8_t> block(rowSize * rowCount);
+
+                auto stripeStart = std::chrono::high_resolution_clock::now();
+                packRows(image, firstRow, rowCount, block.data());
+                stripeTimings[stripe].convertMs = elapsedMs(stripeStart);
+                if (!writeAt(fd, block.data(), block.size(), off_t(header.size() + firstRow * rowSize))) {
+                    stripesWritten = false;
+                }
+                stripeTimings[stripe].writeMs = elapsedMs(stripeStart);
+            });
+        }
+        success = success && stripesWritten;
+        success = close(fd) == 0 && success;
+
+        if (timings) {
+            double convertMs = 0.0;
+            double writeMs = 0.0;
+            for (const auto & stripe : stripeTimings) {
+                convertMs += stripe.convertMs;
+                writeMs += stripe.writeMs;
+            }
+            double totalMs = elapsedMs(start);
+            double convertShare = convertMs + writeMs > 0.0 ? convertMs / (convertMs + writeMs) : 0.0;
+            timings->convertMs += totalMs * convertShare;
+            timings->writeMs += totalMs * (1.0 - convertShare);
+        }
+
+        if (!success) {
+            std::cerr << "Error: Could not write \"" << filename << "\": " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool writePPMMapped(const char * filename, const MappedImage & image, vks::ThreadPool * pool, WriteTimings * timings)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open \"" << filename << "\" for writing: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        std::string header = ppmHeader(image.width, image.height);
+        const size_t fileSize = ppmFileSize(image.width, image.height);
+        void * mapping = MAP_FAILED;
+        if (ftruncate(fd, fileSize) == 0) {
+            mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Error: Could not map \"" << filename << "\": " << strerror(errno) << std::endl;
+            close(fd);
+            return false;
+        }
+        double setupMs = elapsedMs(start);
+
+        uint8_t * dst = static_cast<uint8_t *>(mapping);
+        std::copy(header.begin(), header.end(), dst);
+        dst += header.size();
+        if (pool && pool->size() > 1) {
+            const size_t rowSize = size_t(image.width) * 3;
+            const uint32_t rowsPerStripe = stripeRows(image, pool->size());
+            pool->parallelFor((image.height + rowsPerStripe - 1) / rowsPerStripe, [&](uint32_t stripe) {
+                uint32_t firstRow = stripe * rowsPerStripe;
+                packRows(image, firstRow, std::min(rowsPerStripe, image.height - firstRow), dst + firstRow * rowSize);
+            });
+        } else {
+            packRows(image, 0, image.height, dst);
+        }
+        double convertMs = elapsedMs(start);
+
+        // The kernel writes the dirty pages back on its own, an msync would only make the caller wait for the disk
+        bool success = munmap(mapping, fileSize) == 0;
+        success = close(fd) == 0 && success;
+
+        if (timings) {
+            timings->convertMs += convertMs;
+            timings->writeMs += setupMs + elapsedMs(start);
+        }
+
+        if (!success) {
+            std::cerr << "Error: Could not write \"" << filename << "\": " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // writev may write less than asked for, so the ranges are advanced past what has been written and retried
+    static bool writeAll(int fd, std::vector<iovec> & ranges)
+    {
+        size_t first = 0;
+        while (first < ranges.size()) {
+            int count = static_cast<int>(std::min<size_t>(ranges.size() - first, IOV_MAX));
+            ssize_t written = writev(fd, &ranges[first], count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            while (first < ranges.size() && size_t(written) >= ranges[first].iov_len) {
+                written -= ranges[first].iov_len;
+                first++;
+            }
+            if (first < ranges.size()) {
+                ranges[first].iov_base = static_cast<uint8_t *>(ranges[first].iov_base) + written;
+                ranges[first].iov_len -= written;
+            }
+        }
+        return true;
+    }
+
+    bool writePAMDirect(const char * filename, const MappedImage & image, WriteTimings * timings)
+    {
+        if (image.layout != vks::pixels::PixelLayout::R8G8B8A8) {
+            std::cerr << "Error: Only R8G8B8A8 images can be written without conversion" << std::endl;
+            return false;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open \"" << filename << "\" for writing: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        std::string header = pamHeader(image.width, image.height, 4);
+        const size_t rowSize = size_t(image.width) * 4;
+        std::vector<iovec> ranges;
+        ranges.push_back({ const_cast<char *>(header.data()), header.size() });
+        if (image.rowPitch == rowSize) {
+            ranges.push_back({ const_cast<uint8_t *>(image.data), rowSize * image.height });
+        } else {
+            ranges.reserve(image.height + 1);
+            for (uint32_t y = 0; y < image.height; y++) {
+                ranges.push_back({ const_cast<uint8_t *>(image.data + y * image.rowPitch), rowSize });
+            }
+        }
+
+        bool success = writeAll(fd, ranges);
+        success = close(fd) == 0 && success;
+
+        if (timings) {
+            timings->writeMs += elapsedMs(start);
+        }
+
+        if (!success) {
+            std::cerr << "Error: Could not write \"" << filename << "\": " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,137 @@
+/*
+* Image writer for screenshot readback data
+*
+* Packs the 32 bit texels of a mapped, row pitched image into tightly packed RGB rows and writes them
+* to disk in large contiguous blocks instead of one stream call per pixel
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "PixelConversion.hpp"
+#include "ThreadPool.hpp"
+
+namespace vks::image
+{
+    /** @brief Mapped source image with 4 bytes per texel, as read back from a linear tiled image */
+    struct MappedImage
+    {
+        /** @brief Pointer to the first texel (the subresource offset must already be applied) */
+        const uint8_t * data = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        /** @brief Distance in bytes between the start of two rows (VkSubresourceLayout::rowPitch) */
+        uint64_t rowPitch = 0;
+        /** @brief Layout of the source texels, anything but R8G8B8A8 is swizzled/converted to RGB */
+        vks::pixels::PixelLayout layout = vks::pixels::PixelLayout::R8G8B8A8;
+    };
+
+    /** @brief Time spent converting texels and handing the converted rows to the stream while writing an image */
+    struct WriteTimings
+    {
+        double convertMs = 0.0;
+        double writeMs = 0.0;
+    };
+
+    /** @brief Returns the binary (P6) ppm header for an image of the given size */
+    std::string ppmHeader(uint32_t width, uint32_t height);
+
+    /** @brief Size in bytes of a complete ppm file (header and pixel data) for an image of the given size */
+    size_t ppmFileSize(uint32_t width, uint32_t height);
+
+    /**
+    * Returns the pam (P7) header for an image of the given size
+    *
+    * @param depth Number of 8 bit channels, 4 for RGB_ALPHA or 3 for RGB
+    */
+    std::string pamHeader(uint32_t width, uint32_t height, uint32_t depth);
+
+    /** @brief Convert a single row of 32 bit texels to packed RGB, dst must hold width * 3 bytes */
+    void packRow(const uint8_t * src, uint8_t * dst, uint32_t width, vks::pixels::PixelLayout layout);
+
+    /**
+    * Convert a range of rows of a mapped image to packed RGB
+    *
+    * @param image Mapped source image
+    * @param firstRow First row to convert
+    * @param rowCount Number of rows to convert
+    * @param dst Destination, must hold rowCount * width * 3 bytes
+    *
+    * @note If the rows are contiguous in memory (rowPitch == width * 4) the range is converted in a single pass
+    */
+    void packRows(const MappedImage & image, uint32_t firstRow, uint32_t rowCount, uint8_t * dst);
+
+    /**
+    * Write the packed RGB rows of a mapped image to a stream, without any header
+    *
+    * @param stream Binary stream to append the rows to
+    * @param image Mapped source image
+    * @param (Optional) timings Accumulates the time spent converting and writing
+    *
+    * @return True if all rows have been handed to the stream without an error
+    */
+    bool writeRGB(std::ostream & stream, const MappedImage & image, WriteTimings * timings = nullptr);
+
+    /**
+    * Write a mapped image to disk as a binary ppm
+    *
+    * @param filename Path of the file to write
+    * @param image Mapped source image
+    * @param (Optional) timings Accumulates the time spent converting and writing, opening and closing the file counts as writing
+    *
+    * @return True if the file has been written completely
+    */
+    bool writePPM(const char * filename, const MappedImage & image, WriteTimings * timings = nullptr);
+
+    /**
+    * Write a mapped image to disk as a binary ppm, converting and writing row stripes on a thread pool
+    *
+    * The file is sized up front and every stripe is written with pwrite at its final offset, so stripes can
+    * finish in any order without being collected in one buffer first
+    *
+    * @param filename Path of the file to write
+    * @param image Mapped source image
+    * @param pool Threads the stripes are distributed over, the calling thread takes part
+    * @param (Optional) timings Accumulates the wall time of the write, split between converting and writing in
+    * proportion to the time the threads spent on each
+    *
+    * @return True if the file has been written completely
+    */
+    bool writePPMStriped(const char * filename, const MappedImage & image, vks::ThreadPool & pool, WriteTimings * timings = nullptr);
+
+    /**
+    * Write a mapped image to disk as a binary ppm by converting straight into a memory mapped file
+    *
+    * The file is sized up front and mapped, rows are converted directly into the mapping without passing through
+    * a staging block, a stream buffer or a write call
+    *
+    * @param filename Path of the file to write
+    * @param image Mapped source image
+    * @param (Optional) pool Threads to convert row stripes on, the calling thread converts all rows if nullptr
+    * @param (Optional) timings Accumulates the time spent converting (including page faults on the mapping) and
+    * creating, mapping and closing the file
+    *
+    * @return True if the file has been written completely
+    */
+    bool writePPMMapped(const char * filename, const MappedImage & image, vks::ThreadPool * pool = nullptr, WriteTimings * timings = nullptr);
+
+    /**
+    * Write an R8G8B8A8 mapped image to disk as a pam (P7) with tuple type RGB_ALPHA, straight from the mapped memory
+    *
+    * No texel is converted or copied in user space, the header and the rows are handed to the kernel with vectored
+    * writes (a single range if rowPitch == width * 4, one range per row otherwise)
+    *
+    * @param filename Path of the file to write
+    * @param image Mapped source image, must have the R8G8B8A8 layout
+    * @param (Optional) timings Accumulates the time spent writing, convertMs is not touched as nothing is converted
+    *
+    * @return True if the file has been written completely
+    */
+    bool writePAMDirect(const char * filename, const MappedImage & image, WriteTimings * timings = nullptr);
+}
@@ -0,0 +1,48 @@
+/*
+* Instance transforms
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Instancing.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vks::instances
+{
+    std::vector<InstanceState> createGrid(uint32_t count, float extent)
+    {
+        std::vector<InstanceState> instances(count);
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(double(count))));
+        float cell = 2.0f * extent / std::max(side, 1u);
+        for (uint32_t i = 0; i < count; i++) {
+            InstanceState & instance = instances[i];
+            instance.position[0] = -extent + cell * (float(i % side) + 0.5f);
+            instance.position[1] = -extent + cell * (float(i / side) + 0.5f);
+            // A mesh fitted to the unit cube spans 2 units, leave a gap between neighbours
+            instance.scale = cell * 0.45f;
+            // Golden ratio steps keep neighbours out of phase, the speeds cycle through a few values in both directions
+            instance.phase = std::fmod(float(i) * 2.39996323f, 6.28318531f);
+            instance.speed = (0.5f + float(i % 5) * 0.25f) * (i % 2 ? -1.0f : 1.0f);
+        }
+        return instances;
+    }
+
+    void updateTransforms(const InstanceState * instances, uint32_t count, float time, float * transforms)
+    {
+        for (uint32_t i = 0; i < count; i++) {
+            const InstanceState & instance = instances[i];
+            float angle = instance.phase + instance.speed * time;
+            float c = std::cos(angle) * instance.scale;
+            float s = std::sin(angle) * instance.scale;
+
+            // Every float of the matrix is written once and in order, which suits write-combined memory
+            float * m = transforms + size_t(i) * 16;
+            m[0] = c;    m[1] = s;    m[2] = 0.0f;  m[3] = 0.0f;
+            m[4] = -s;   m[5] = c;    m[6] = 0.0f;  m[7] = 0.0f;
+            m[8] = 0.0f; m[9] = 0.0f; m[10] = instance.scale; m[11] = 0.0f;
+            m[12] = instance.position[0]; m[13] = instance.position[1]; m[14] = 0.0f; m[15] = 1.0f;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+/*
+* Instance transforms
+*
+* Per-instance state of the instanced draw path and the per-frame update that turns it into model matrices. The
+* matrices are written straight into the mapped slice of an instance-rate vertex buffer, so the update is the whole
+* per-frame cost of animating the instances on the CPU
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vks::instances
+{
+    struct InstanceState
+    {
+        float position[2];
+        float scale;
+        /** @brief Rotation at time 0 in radians */
+        float phase;
+        /** @brief Rotation speed in radians per second */
+        float speed;
+    };
+
+    /** @brief Size of one transform in the instance buffer, a column-major mat4 */
+    constexpr uint32_t transformSize = 16 * sizeof(float);
+
+    /**
+    * Place instances on the smallest square grid that holds them
+    *
+    * @param count Number of instances
+    * @param extent Half the side of the square covered by the grid, around the origin
+    * @return Instances scaled to fit their cell, assuming the mesh fits into the unit cube
+    */
+    std::vector<InstanceState> createGrid(uint32_t count, float extent);
+
+    /**
+    * Write the model matrix of every instance at a point in time, a rotation around z followed by the translation
+    *
+    * @param transforms Destination of count column-major matrices, usually mapped memory that should only be written
+    */
+    void updateTransforms(const InstanceState * instances, uint32_t count, float time, float * transforms);
+}
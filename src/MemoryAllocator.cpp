@@ -0,0 +1,259 @@
+/*
+* Device memory allocator
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "MemoryAllocator.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    MemoryAllocator::~MemoryAllocator()
+    {
+        destroy();
+    }
+
+    void MemoryAllocator::create(vks::VulkanDevice * vulkanDevice, VkDeviceSize blockSize)
+    {
+        destroy();
+
+        this->vulkanDevice = vulkanDevice;
+        this->device = vulkanDevice->logicalDevice;
+        this->blockSize = blockSize;
+        granularity = std::max<VkDeviceSize>(vulkanDevice->properties.limits.bufferImageGranularity, 1);
+        nonCoherentAtomSize = std::max<VkDeviceSize>(vulkanDevice->properties.limits.nonCoherentAtomSize, 1);
+    }
+
+    void MemoryAllocator::destroy()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto & block : blocks) {
+            if (!block->suballocator.empty()) {
+                std::cerr << "Error: Destroying a memory block with " << block->suballocator.allocationCount() << " allocations left" << std::endl;
+            }
+            if (block->mapped) {
+                vkUnmapMemory(device, block->memory);
+            }
+            vkFreeMemory(device, block->memory, nullptr);
+        }
+        blocks.clear();
+    }
+
+    bool MemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t & memoryType) const
+    {
+        const VkPhysicalDeviceMemoryProperties & properties = vulkanDevice->memoryProperties;
+        bool found = false;
+        for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+            VkMemoryPropertyFlags flags = properties.memoryTypes[i].propertyFlags;
+            if (!(typeBits & (1u << i)) || (flags & required) != required) {
+                continue;
+            }
+            if ((flags & preferred) == preferred) {
+                memoryType = i;
+                return true;
+            }
+            if (!found) {
+                memoryType = i;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    MemoryAllocator::Block * MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated)
+    {
+        if (blocks.size() >= vulkanDevice->properties.limits.maxMemoryAllocationCount) {
+            std::cerr << "Error: Reached maxMemoryAllocationCount (" << vulkanDevice->properties.limits.maxMemoryAllocationCount << ")" << std::endl;
+            return nullptr;
+        }
+
+        VkMemoryAllocateInfo memAllocInfo {};
+        memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAllocInfo.allocationSize = size;
+        memAllocInfo.memoryTypeIndex = memoryType;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(device, &memAllocInfo, nullptr, &memory) != VK_SUCCESS) {
+            return nullptr;
+        }
+
+        std::unique_ptr<Block> block(new Block(size, granularity));
+        block->memory = memory;
+        block->memoryType = memoryType;
+        block->dedicated = dedicated;
+
+        // Host visible blocks stay mapped, a range of a block can't be mapped on its own while others are in use
+        if (vulkanDevice->memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            void * data;
+            VK_CHECK_RESULT(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data));
+            block->mapped = static_cast<uint8_t *>(data);
+        }
+
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
+
+    bool MemoryAllocator::allocate(const VkMemoryRequirements & requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+                                   ResourceTiling tiling, MemoryAllocation & allocation)
+    {
+        uint32_t memoryType;
+        if (!findMemoryType(requirements.memoryTypeBits, required, preferred, memoryType)) {
+            std::cerr << "Error: Could not find a suitable memory type!" << std::endl;
+            return false;
+        }
+
+        // Flushes and invalidations of non coherent memory work on whole atoms, so ranges never share an atom
+        VkMemoryPropertyFlags flags = vulkanDevice->memoryProperties.memoryTypes[memoryType].propertyFlags;
+        bool nonCoherent = (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        VkDeviceSize size = requirements.size;
+        if (nonCoherent) {
+            alignment = std::max(alignment, nonCoherentAtomSize);
+            size = alignUp(size, nonCoherentAtomSize);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Block * target = nullptr;
+        VkDeviceSize offset = 0;
+        if (size <= blockSize / 2) {
+            for (auto & block : blocks) {
+                if (!block->dedicated && block->memoryType == memoryType && block->suballocator.allocate(size, alignment, tiling, offset)) {
+                    target = block.get();
+                    break;
+                }
+            }
+        }
+        if (!target) {
+            Block * block;
+            if (size > blockSize / 2) {
+                block = createBlock(memoryType, size, true);
+            } else {
+                // Small heaps, e.g. the host visible device local heap of discrete GPUs, are not handed out in one go
+                uint32_t heapIndex = vulkanDevice->memoryProperties.memoryTypes[memoryType].heapIndex;
+                VkDeviceSize heapSize = vulkanDevice->memoryProperties.memoryHeaps[heapIndex].size;
+                block = createBlock(memoryType, std::max(std::min(blockSize, heapSize / 8), size), false);
+            }
+            if (!block) {
+                std::cerr << "Error: Could not allocate " << size << " bytes of device memory" << std::endl;
+                return false;
+            }
+            // A fresh block starts at offset 0, which satisfies any alignment
+            block->suballocator.allocate(size, alignment, tiling, offset);
+            target = block;
+        }
+
+        allocation.memory = target->memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.memoryType = memoryType;
+        allocation.mapped = target->mapped ? target->mapped + offset : nullptr;
+        allocation.nonCoherent = nonCoherent;
+        allocation.block = target;
+        return true;
+    }
+
+    bool MemoryAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags required, MemoryAllocation & allocation, VkMemoryPropertyFlags preferred)
+    {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device, buffer, &requirements);
+        if (!allocate(requirements, required, preferred, ResourceTiling::Linear, allocation)) {
+            return false;
+        }
+        VK_CHECK_RESULT(vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset));
+        return true;
+    }
+
+    bool MemoryAllocator::allocateImage(VkImage image, ResourceTiling tiling, VkMemoryPropertyFlags required, MemoryAllocation & allocation, VkMemoryPropertyFlags preferred)
+    {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        if (!allocate(requirements, required, preferred, tiling, allocation)) {
+            return false;
+        }
+        VK_CHECK_RESULT(vkBindImageMemory(device, image, allocation.memory, allocation.offset));
+        return true;
+    }
+
+    void MemoryAllocator::free(MemoryAllocation & allocation)
+    {
+        if (!allocation.block) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<Block> & block) {
+            return block.get() == allocation.block;
+        });
+        if (it != blocks.end()) {
+            Block & block = **it;
+            block.suballocator.free(allocation.offset);
+            // Dedicated blocks are released right away, empty shared blocks are kept to serve the next allocations
+            if (block.dedicated) {
+                if (block.mapped) {
+                    vkUnmapMemory(device, block.memory);
+                }
+                vkFreeMemory(device, block.memory, nullptr);
+                blocks.erase(it);
+            }
+        }
+        allocation = MemoryAllocation();
+    }
+
+    VkMappedMemoryRange MemoryAllocator::mappedRange(const MemoryAllocation & allocation, VkDeviceSize offset, VkDeviceSize size) const
+    {
+        // Allocations of non coherent memory start and end on atom boundaries, so widening the range stays within them
+        VkDeviceSize start = allocation.offset + offset;
+        VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : std::min(start + size, allocation.offset + allocation.size);
+        start = start / nonCoherentAtomSize * nonCoherentAtomSize;
+        end = alignUp(end, nonCoherentAtomSize);
+
+        VkMappedMemoryRange range {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = start;
+        range.size = end - start;
+        return range;
+    }
+
+    void MemoryAllocator::flush(const MemoryAllocation & allocation, VkDeviceSize offset, VkDeviceSize size)
+    {
+        if (!allocation.nonCoherent) {
+            return;
+        }
+        VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+        VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device, 1, &range));
+    }
+
+    void MemoryAllocator::invalidate(const MemoryAllocation & allocation, VkDeviceSize offset, VkDeviceSize size)
+    {
+        if (!allocation.nonCoherent) {
+            return;
+        }
+        VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+        VK_CHECK_RESULT(vkInvalidateMappedMemoryRanges(device, 1, &range));
+    }
+
+    MemoryStats MemoryAllocator::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        MemoryStats stats;
+        for (const auto & block : blocks) {
+            stats.deviceAllocations++;
+            stats.allocations += block->suballocator.allocationCount();
+            stats.reservedBytes += block->suballocator.size();
+            stats.usedBytes += block->suballocator.used();
+        }
+        return stats;
+    }
+}
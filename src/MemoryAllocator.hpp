@@ -0,0 +1,132 @@
+/*
+* Device memory allocator
+*
+* Allocates large device memory blocks per memory type and binds buffers and images to aligned sub-ranges of them,
+* instead of calling vkAllocateMemory for every resource. Keeps the number of allocations far below
+* maxMemoryAllocationCount and host visible blocks are mapped once for their whole lifetime
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "BlockSuballocator.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+    /** @brief A range of a memory block bound to a single resource */
+    struct MemoryAllocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t memoryType = 0;
+        /** @brief Start of the range in the persistently mapped block, nullptr if the memory is not host visible */
+        uint8_t * mapped = nullptr;
+        /** @brief True if host writes have to be flushed, see MemoryAllocator::flush */
+        bool nonCoherent = false;
+        // Block the range belongs to, owned by the allocator
+        void * block = nullptr;
+    };
+
+    struct MemoryStats
+    {
+        /** @brief Device memory allocations made, blocks plus dedicated allocations */
+        uint32_t deviceAllocations = 0;
+        /** @brief Resources bound to sub-ranges */
+        uint32_t allocations = 0;
+        /** @brief Bytes of all device memory allocations */
+        uint64_t reservedBytes = 0;
+        /** @brief Bytes of all sub-ranges, the difference to reservedBytes is free space and alignment padding */
+        uint64_t usedBytes = 0;
+    };
+
+    class MemoryAllocator
+    {
+    public:
+        /** @brief Size of a memory block, smaller heaps use an eighth of the heap size */
+        static constexpr VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+
+        ~MemoryAllocator();
+
+        /**
+        * Set up the allocator for a device, no memory is allocated until the first resource is bound
+        *
+        * @param vulkanDevice Device to allocate memory on
+        * @param blockSize Preferred size of memory blocks, resources larger than half a block get their own allocation
+        */
+        void create(vks::VulkanDevice * vulkanDevice, VkDeviceSize blockSize = defaultBlockSize);
+
+        /** @brief Free all blocks, every allocation must have been freed or its resource destroyed */
+        void destroy();
+
+        /**
+        * Reserve a range of device memory
+        *
+        * @param requirements Memory requirements of the resource
+        * @param required Memory properties the memory type must have
+        * @param preferred Additional properties picked if a memory type has them, e.g. VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+        * @param tiling Tiling of the resource, keeps linear and optimal resources bufferImageGranularity apart
+        * @param allocation Set to the reserved range
+        *
+        * @return False if no memory type matches or the device is out of memory
+        */
+        bool allocate(const VkMemoryRequirements & requirements, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+                      ResourceTiling tiling, MemoryAllocation & allocation);
+
+        /** @brief Reserve memory for a buffer and bind it, returns false and leaves the buffer unbound if allocate fails */
+        bool allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags required, MemoryAllocation & allocation, VkMemoryPropertyFlags preferred = 0);
+
+        /** @brief Reserve memory for an image and bind it, returns false and leaves the image unbound if allocate fails */
+        bool allocateImage(VkImage image, ResourceTiling tiling, VkMemoryPropertyFlags required, MemoryAllocation & allocation, VkMemoryPropertyFlags preferred = 0);
+
+        /** @brief Return a range, blocks that become empty are kept for reuse */
+        void free(MemoryAllocation & allocation);
+
+        /**
+        * Make host writes to a non coherent allocation visible to the device, does nothing for coherent memory
+        *
+        * @note Ranges of non coherent memory are aligned to nonCoherentAtomSize, so flushing never touches a neighbour
+        */
+        void flush(const MemoryAllocation & allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+        /** @brief Make device writes to a non coherent allocation visible to the host, does nothing for coherent memory */
+        void invalidate(const MemoryAllocation & allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+        MemoryStats stats() const;
+
+    private:
+        struct Block
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            uint32_t memoryType = 0;
+            uint8_t * mapped = nullptr;
+            /** @brief Dedicated blocks hold a single resource and are freed with it */
+            bool dedicated = false;
+            BlockSuballocator suballocator;
+
+            Block(VkDeviceSize size, VkDeviceSize granularity)
+                : suballocator(size, granularity)
+            {}
+        };
+
+        vks::VulkanDevice * vulkanDevice = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        VkDeviceSize blockSize = defaultBlockSize;
+        VkDeviceSize granularity = 1;
+        VkDeviceSize nonCoherentAtomSize = 1;
+        std::vector<std::unique_ptr<Block>> blocks;
+        mutable std::mutex mutex;
+
+        bool findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t & memoryType) const;
+        Block * createBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated);
+        VkMappedMemoryRange mappedRange(const MemoryAllocation & allocation, VkDeviceSize offset, VkDeviceSize size) const;
+    };
+}
@@ -0,0 +1,299 @@
+/*
+* Mesh loading
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace vks
+{
+    struct BinaryMeshHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+    };
+
+    static const char binaryMeshMagic[4] = { 'V', 'K', 'S', 'M' };
+    static const uint32_t binaryMeshVersion = 1;
+
+    static bool hasExtension(const std::string & filename, const char * extension)
+    {
+        size_t length = strlen(extension);
+        if (filename.size() < length) {
+            return false;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (tolower(filename[filename.size() - length + i]) != extension[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool readFile(const std::string & filename, std::vector<char> & contents)
+    {
+        FILE * file = fopen(filename.c_str(), "rb");
+        if (!file) {
+            std::cerr << "Error: Could not open mesh \"" << filename << "\"" << std::endl;
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        bool read = size >= 0;
+        if (read) {
+            // Terminated so the parser can rely on a character that stops strtof and strtol at the end of the last line
+            contents.resize(size + 1);
+            read = fread(contents.data(), 1, size, file) == (size_t) size;
+            contents[size] = '\0';
+        }
+        fclose(file);
+        if (!read) {
+            std::cerr << "Error: Could not read mesh \"" << filename << "\"" << std::endl;
+        }
+        return read;
+    }
+
+    static bool validateIndices(const std::string & filename, const Mesh & mesh)
+    {
+        if (mesh.indices.size() % 3 != 0) {
+            std::cerr << "Error: Mesh \"" << filename << "\" has " << mesh.indices.size() << " indices, which is not a multiple of 3" << std::endl;
+            return false;
+        }
+        uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        for (uint32_t index : mesh.indices) {
+            if (index >= vertexCount) {
+                std::cerr << "Error: Mesh \"" << filename << "\" references vertex " << index << " of " << vertexCount << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void bounds(const Mesh & mesh, float min[3], float max[3])
+    {
+        for (int axis = 0; axis < 3; axis++) {
+            min[axis] = max[axis] = mesh.vertices[0].position[axis];
+        }
+        for (const MeshVertex & vertex : mesh.vertices) {
+            for (int axis = 0; axis < 3; axis++) {
+                min[axis] = std::min(min[axis], vertex.position[axis]);
+                max[axis] = std::max(max[axis], vertex.position[axis]);
+            }
+        }
+    }
+
+    // Maps the bounding box onto the RGB cube, so untextured models still show their shape
+    static void colorByPosition(Mesh & mesh)
+    {
+        if (mesh.vertices.empty()) {
+            return;
+        }
+        float min[3], max[3];
+        bounds(mesh, min, max);
+        for (MeshVertex & vertex : mesh.vertices) {
+            for (int axis = 0; axis < 3; axis++) {
+                float extent = max[axis] - min[axis];
+                vertex.color[axis] = extent > 0.0f ? (vertex.position[axis] - min[axis]) / extent : 1.0f;
+            }
+        }
+    }
+
+    bool loadMesh(const std::string & filename, Mesh & mesh)
+    {
+        if (hasExtension(filename, ".obj")) {
+            return loadObj(filename, mesh);
+        }
+        if (hasExtension(filename, ".mesh")) {
+            return loadBinaryMesh(filename, mesh);
+        }
+        std::cerr << "Error: Unknown mesh format \"" << filename << "\", expected .obj or .mesh" << std::endl;
+        return false;
+    }
+
+    bool loadObj(const std::string & filename, Mesh & mesh)
+    {
+        std::vector<char> contents;
+        if (!readFile(filename, contents)) {
+            return false;
+        }
+
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        bool hasColors = false;
+        std::vector<uint32_t> polygon;
+
+        const char * cursor = contents.data();
+        const char * end = contents.data() + contents.size() - 1;
+        while (cursor < end) {
+            const char * lineEnd = static_cast<const char *>(memchr(cursor, '\n', end - cursor));
+            if (!lineEnd) {
+                lineEnd = end;
+            }
+            while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t')) {
+                cursor++;
+            }
+
+            if (cursor + 1 < lineEnd && cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+                // Position, optionally followed by a color
+                MeshVertex vertex = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+                float values[6];
+                uint32_t count = 0;
+                char * next = const_cast<char *>(cursor + 1);
+                while (count < 6 && next < lineEnd) {
+                    char * parsed;
+                    values[count] = strtof(next, &parsed);
+                    if (parsed == next || parsed > lineEnd) {
+                        break;
+                    }
+                    next = parsed;
+                    count++;
+                }
+                if (count < 3) {
+                    std::cerr << "Error: Vertex " << mesh.vertices.size() + 1 << " of \"" << filename << "\" has fewer than 3 coordinates" << std::endl;
+                    return false;
+                }
+                memcpy(vertex.position, values, sizeof(vertex.position));
+                if (count == 6) {
+                    memcpy(vertex.color, values + 3, sizeof(vertex.color));
+                    hasColors = true;
+                }
+                mesh.vertices.push_back(vertex);
+            } else if (cursor + 1 < lineEnd && cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+                // Only the position index of each v/vt/vn triple is used, it's also the vertex index
+                polygon.clear();
+                char * next = const_cast<char *>(cursor + 1);
+                while (next < lineEnd) {
+                    char * parsed;
+                    long index = strtol(next, &parsed, 10);
+                    if (parsed == next || parsed > lineEnd) {
+                        break;
+                    }
+                    if (index < 0) {
+                        index += static_cast<long>(mesh.vertices.size());
+                    } else {
+                        index -= 1;
+                    }
+                    if (index < 0) {
+                        std::cerr << "Error: Face " << mesh.indices.size() / 3 + 1 << " of \"" << filename << "\" has an invalid index" << std::endl;
+                        return false;
+                    }
+                    polygon.push_back(static_cast<uint32_t>(index));
+                    next = parsed;
+                    while (next < lineEnd && *next != ' ' && *next != '\t') {
+                        next++;
+                    }
+                }
+                for (size_t i = 2; i < polygon.size(); i++) {
+                    mesh.indices.push_back(polygon[0]);
+                    mesh.indices.push_back(polygon[i - 1]);
+                    mesh.indices.push_back(polygon[i]);
+                }
+            }
+            cursor = lineEnd + 1;
+        }
+
+        if (!hasColors) {
+            colorByPosition(mesh);
+        }
+        return validateIndices(filename, mesh);
+    }
+
+    bool loadBinaryMesh(const std::string & filename, Mesh & mesh)
+    {
+        FILE * file = fopen(filename.c_str(), "rb");
+        if (!file) {
+            std::cerr << "Error: Could not open mesh \"" << filename << "\"" << std::endl;
+            return false;
+        }
+
+        BinaryMeshHeader header;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1
+            && memcmp(header.magic, binaryMeshMagic, sizeof(binaryMeshMagic)) == 0
+            && header.version == binaryMeshVersion;
+        if (!valid) {
+            std::cerr << "Error: \"" << filename << "\" is not a version " << binaryMeshVersion << " mesh" << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        // The counts come from the file, check them against its size before allocating anything for them
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, sizeof(header), SEEK_SET);
+        uint64_t expectedSize = sizeof(header) + uint64_t(header.vertexCount) * sizeof(MeshVertex) + uint64_t(header.indexCount) * sizeof(uint32_t);
+        if (fileSize < 0 || expectedSize > uint64_t(fileSize)) {
+            std::cerr << "Error: Mesh \"" << filename << "\" is malformed, " << header.vertexCount << " vertices and "
+                      << header.indexCount << " indices don't fit a file of " << fileSize << " bytes" << std::endl;
+            fclose(file);
+            return false;
+        }
+        if (header.indexCount % 3 != 0) {
+            std::cerr << "Error: Mesh \"" << filename << "\" is malformed, " << header.indexCount << " indices aren't whole triangles" << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        // Both arrays are read straight into place, the file holds them in the layout they are uploaded in
+        mesh.vertices.resize(header.vertexCount);
+        mesh.indices.resize(header.indexCount);
+        bool read = fread(mesh.vertices.data(), sizeof(MeshVertex), header.vertexCount, file) == header.vertexCount
+            && fread(mesh.indices.data(), sizeof(uint32_t), header.indexCount, file) == header.indexCount;
+        fclose(file);
+        if (!read) {
+            std::cerr << "Error: Mesh \"" << filename << "\" is truncated" << std::endl;
+            return false;
+        }
+        return validateIndices(filename, mesh);
+    }
+
+    bool saveBinaryMesh(const std::string & filename, const Mesh & mesh)
+    {
+        FILE * file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Error: Could not create mesh \"" << filename << "\"" << std::endl;
+            return false;
+        }
+
+        BinaryMeshHeader header;
+        memcpy(header.magic, binaryMeshMagic, sizeof(binaryMeshMagic));
+        header.version = binaryMeshVersion;
+        header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(mesh.vertices.data(), sizeof(MeshVertex), header.vertexCount, file) == header.vertexCount
+            && fwrite(mesh.indices.data(), sizeof(uint32_t), header.indexCount, file) == header.indexCount;
+        written = fclose(file) == 0 && written;
+        if (!written) {
+            std::cerr << "Error: Could not write mesh \"" << filename << "\"" << std::endl;
+        }
+        return written;
+    }
+
+    void fitToUnitCube(Mesh & mesh)
+    {
+        if (mesh.vertices.empty()) {
+            return;
+        }
+        float min[3], max[3];
+        bounds(mesh, min, max);
+
+        float extent = std::max({ max[0] - min[0], max[1] - min[1], max[2] - min[2] });
+        float scale = extent > 0.0f ? 2.0f / extent : 1.0f;
+        for (MeshVertex & vertex : mesh.vertices) {
+            for (int axis = 0; axis < 3; axis++) {
+                vertex.position[axis] = (vertex.position[axis] - (min[axis] + max[axis]) * 0.5f) * scale;
+            }
+        }
+    }
+}
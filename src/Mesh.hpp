@@ -0,0 +1,67 @@
+/*
+* Mesh loading
+*
+* Loads triangle meshes from Wavefront OBJ files and from a simple binary format that is a header followed by the
+* vertex and index arrays exactly as they are uploaded, so large models are read with two reads and no parsing
+*
+* Binary format (.mesh, little endian):
+*   char     magic[4]     "VKSM"
+*   uint32_t version      1
+*   uint32_t vertexCount
+*   uint32_t indexCount   multiple of 3
+*   MeshVertex vertices[vertexCount]
+*   uint32_t indices[indexCount]
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vks
+{
+    /** @brief Vertex layout of the triangle pipeline, position and color as 32 bit floats */
+    struct MeshVertex
+    {
+        float position[3];
+        float color[3];
+    };
+
+    /** @brief Indexed triangle list */
+    struct Mesh
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    /**
+    * Load a mesh, the format is picked from the extension: .obj or .mesh
+    *
+    * @return False if the file can't be read or is malformed, an error is printed
+    */
+    bool loadMesh(const std::string & filename, Mesh & mesh);
+
+    /**
+    * Load the v and f statements of an OBJ file, other statements are ignored
+    *
+    * @note Polygons are split into triangle fans. Vertices without a color (the "v x y z r g b" extension) are colored by
+    * their position within the bounding box
+    */
+    bool loadObj(const std::string & filename, Mesh & mesh);
+
+    /**
+    * Load a mesh written by saveBinaryMesh
+    *
+    * @note The vertex and index counts of the header are checked against the file size, and the index count to be whole
+    * triangles, before anything is allocated. A malformed file returns false
+    */
+    bool loadBinaryMesh(const std::string & filename, Mesh & mesh);
+
+    bool saveBinaryMesh(const std::string & filename, const Mesh & mesh);
+
+    /** @brief Center the mesh on the origin and scale it uniformly so it fits into [-1, 1] on every axis */
+    void fitToUnitCube(Mesh & mesh);
+}
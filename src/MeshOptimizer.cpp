@@ -0,0 +1,359 @@
+/*
+* Mesh optimization
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace vks
+{
+    namespace
+    {
+        // Parameters of Forsyth's "Linear-Speed Vertex Cache Optimisation", the LRU cache it models is larger than the
+        // FIFO used for the statistics, which makes the order hold up on GPUs with larger caches as well
+        const uint32_t modelCacheSize = 32;
+        const float cacheDecayPower = 1.5f;
+        const float lastTriangleScore = 0.75f;
+        const float valenceBoostScale = 2.0f;
+        const float valenceBoostPower = 0.5f;
+        // Vertices with more remaining triangles get the same boost
+        const uint32_t maxValence = 32;
+
+        struct ScoreTable
+        {
+            float cache[modelCacheSize];
+            float valence[maxValence + 1];
+
+            ScoreTable()
+            {
+                for (uint32_t i = 0; i < modelCacheSize; i++) {
+                    // The three vertices of the last triangle score the same, so none of them is favoured
+                    cache[i] = i < 3 ? lastTriangleScore : std::pow(1.0f - float(i - 3) / (modelCacheSize - 3), cacheDecayPower);
+                }
+                valence[0] = 0.0f;
+                for (uint32_t i = 1; i <= maxValence; i++) {
+                    // Vertices with few triangles left are finished first, so they don't get stranded
+                    valence[i] = valenceBoostScale * std::pow(float(i), -valenceBoostPower);
+                }
+            }
+        };
+
+        float vertexScore(int32_t cachePosition, uint32_t remaining)
+        {
+            static const ScoreTable table;
+            if (remaining == 0) {
+                return -1.0f;
+            }
+            float score = cachePosition < 0 ? 0.0f : table.cache[cachePosition];
+            return score + table.valence[std::min(remaining, maxValence)];
+        }
+
+        struct Vector
+        {
+            double x = 0.0, y = 0.0, z = 0.0;
+        };
+
+        Vector position(const std::vector<MeshVertex> & vertices, uint32_t index)
+        {
+            const float * p = vertices[index].position;
+            return { p[0], p[1], p[2] };
+        }
+    }
+
+    VertexCacheStats analyzeVertexCache(const uint32_t * indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+    {
+        VertexCacheStats stats;
+        if (indexCount == 0) {
+            return stats;
+        }
+
+        // A vertex is in the cache while fewer than cacheSize transforms happened since its own
+        std::vector<uint64_t> timestamps(vertexCount, 0);
+        uint64_t time = cacheSize + 1;
+        size_t referenced = 0;
+        for (size_t i = 0; i < indexCount; i++) {
+            uint64_t & timestamp = timestamps[indices[i]];
+            if (timestamp == 0) {
+                referenced++;
+            }
+            if (time - timestamp > cacheSize) {
+                timestamp = time++;
+                stats.transforms++;
+            }
+        }
+
+        stats.acmr = float(double(stats.transforms) / (indexCount / 3));
+        stats.atvr = float(double(stats.transforms) / referenced);
+        return stats;
+    }
+
+    void optimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+
+        // Triangles of each vertex, the first remaining[v] entries are the ones not yet emitted
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (uint32_t index : indices) {
+            remaining[index]++;
+        }
+        std::vector<size_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + remaining[v];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++) {
+                adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        std::vector<int32_t> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+        }
+        std::vector<float> triangleScores(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        }
+
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        uint32_t cache[modelCacheSize + 3];
+        uint32_t newCache[modelCacheSize + 3];
+        uint32_t cacheCount = 0;
+        size_t scanCursor = 0;
+
+        // The first triangle is the best one overall, afterwards only triangles of cached vertices are considered
+        int64_t best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+        while (result.size() < indices.size()) {
+            if (best < 0) {
+                // Nothing left around the cache, continue with the next triangle in input order to stay linear
+                while (emitted[scanCursor]) {
+                    scanCursor++;
+                }
+                best = static_cast<int64_t>(scanCursor);
+            }
+
+            const uint32_t * triangle = &indices[best * 3];
+            emitted[best] = 1;
+            result.insert(result.end(), triangle, triangle + 3);
+
+            // The triangle's vertices move to the front of the cache, the others move back by up to three
+            uint32_t newCount = 0;
+            for (int i = 0; i < 3; i++) {
+                newCache[newCount++] = triangle[i];
+            }
+            for (uint32_t i = 0; i < cacheCount; i++) {
+                uint32_t v = cache[i];
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    newCache[newCount++] = v;
+                }
+            }
+
+            for (int i = 0; i < 3; i++) {
+                uint32_t v = triangle[i];
+                uint32_t * first = &adjacency[offsets[v]];
+                uint32_t * last = first + remaining[v];
+                uint32_t * found = std::find(first, last, static_cast<uint32_t>(best));
+                if (found != last) {
+                    std::swap(*found, *(last - 1));
+                    remaining[v]--;
+                }
+            }
+
+            // Vertices that fell out of the modelled cache are rescored too
+            for (uint32_t i = 0; i < newCount; i++) {
+                uint32_t v = newCache[i];
+                cachePositions[v] = i < modelCacheSize ? static_cast<int32_t>(i) : -1;
+                float score = vertexScore(cachePositions[v], remaining[v]);
+                float delta = score - vertexScores[v];
+                vertexScores[v] = score;
+                for (size_t j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+                    triangleScores[adjacency[j]] += delta;
+                }
+            }
+
+            best = -1;
+            float bestScore = 0.0f;
+            for (uint32_t i = 0; i < newCount; i++) {
+                uint32_t v = newCache[i];
+                for (size_t j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+                    uint32_t t = adjacency[j];
+                    if (triangleScores[t] > bestScore) {
+                        bestScore = triangleScores[t];
+                        best = t;
+                    }
+                }
+            }
+
+            cacheCount = std::min(newCount, modelCacheSize);
+            std::copy(newCache, newCache + cacheCount, cache);
+        }
+
+        indices.swap(result);
+    }
+
+    void optimizeOverdraw(std::vector<uint32_t> & indices, const std::vector<MeshVertex> & vertices, float threshold)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) {
+            return;
+        }
+
+        // Cache misses of every triangle in the current order
+        std::vector<uint8_t> misses(triangleCount, 0);
+        {
+            std::vector<uint64_t> timestamps(vertices.size(), 0);
+            uint64_t time = defaultCacheSize + 1;
+            for (size_t t = 0; t < triangleCount; t++) {
+                for (int i = 0; i < 3; i++) {
+                    uint64_t & timestamp = timestamps[indices[t * 3 + i]];
+                    if (time - timestamp > defaultCacheSize) {
+                        timestamp = time++;
+                        misses[t]++;
+                    }
+                }
+            }
+        }
+
+        // Hard boundaries where the cache restarts (all three vertices missed), which cost no reuse at all. Cache ordered
+        // meshes rarely have them, so runs between them are split further after Sander et al.: at a triangle with at least
+        // two misses, once the cluster is longer than the cache and its ACMR so far is within the threshold of the run's
+        std::vector<size_t> clusterStarts;
+        for (size_t start = 0; start < triangleCount;) {
+            size_t end = start + 1;
+            uint64_t runMisses = misses[start];
+            while (end < triangleCount && misses[end] < 3) {
+                runMisses += misses[end++];
+            }
+            double runAcmr = double(runMisses) / (end - start);
+
+            clusterStarts.push_back(start);
+            size_t clusterStart = start;
+            uint64_t clusterMisses = 0;
+            for (size_t t = start; t < end; t++) {
+                size_t clusterSize = t - clusterStart;
+                if (clusterSize > defaultCacheSize && misses[t] >= 2 && double(clusterMisses) / clusterSize <= runAcmr * threshold) {
+                    clusterStarts.push_back(t);
+                    clusterStart = t;
+                    clusterMisses = 0;
+                }
+                clusterMisses += misses[t];
+            }
+            start = end;
+        }
+        clusterStarts.push_back(triangleCount);
+        size_t clusterCount = clusterStarts.size() - 1;
+        if (clusterCount < 2) {
+            return;
+        }
+
+        // Area weighted centroid and normal of each cluster and of the whole mesh
+        std::vector<Vector> centroids(clusterCount);
+        std::vector<Vector> normals(clusterCount);
+        std::vector<double> areas(clusterCount, 0.0);
+        Vector meshCentroid;
+        double meshArea = 0.0;
+        for (size_t c = 0; c < clusterCount; c++) {
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+                Vector a = position(vertices, indices[t * 3]);
+                Vector b = position(vertices, indices[t * 3 + 1]);
+                Vector d = position(vertices, indices[t * 3 + 2]);
+                Vector ab = { b.x - a.x, b.y - a.y, b.z - a.z };
+                Vector ad = { d.x - a.x, d.y - a.y, d.z - a.z };
+                Vector normal = { ab.y * ad.z - ab.z * ad.y, ab.z * ad.x - ab.x * ad.z, ab.x * ad.y - ab.y * ad.x };
+                double area = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+
+                centroids[c].x += (a.x + b.x + d.x) / 3.0 * area;
+                centroids[c].y += (a.y + b.y + d.y) / 3.0 * area;
+                centroids[c].z += (a.z + b.z + d.z) / 3.0 * area;
+                normals[c].x += normal.x;
+                normals[c].y += normal.y;
+                normals[c].z += normal.z;
+                areas[c] += area;
+            }
+            meshCentroid.x += centroids[c].x;
+            meshCentroid.y += centroids[c].y;
+            meshCentroid.z += centroids[c].z;
+            meshArea += areas[c];
+        }
+        if (meshArea <= 0.0) {
+            return;
+        }
+        meshCentroid = { meshCentroid.x / meshArea, meshCentroid.y / meshArea, meshCentroid.z / meshArea };
+
+        // Clusters facing away from the center are most likely in front of the ones facing inwards
+        std::vector<double> keys(clusterCount, 0.0);
+        for (size_t c = 0; c < clusterCount; c++) {
+            double length = std::sqrt(normals[c].x * normals[c].x + normals[c].y * normals[c].y + normals[c].z * normals[c].z);
+            if (areas[c] <= 0.0 || length <= 0.0) {
+                continue;
+            }
+            Vector offset = { centroids[c].x / areas[c] - meshCentroid.x, centroids[c].y / areas[c] - meshCentroid.y, centroids[c].z / areas[c] - meshCentroid.z };
+            keys[c] = (offset.x * normals[c].x + offset.y * normals[c].y + offset.z * normals[c].z) / length;
+        }
+        std::vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return keys[a] > keys[b];
+        });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (size_t c : order) {
+            result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+        }
+
+        float previous = analyzeVertexCache(indices.data(), indices.size(), vertices.size()).acmr;
+        float reordered = analyzeVertexCache(result.data(), result.size(), vertices.size()).acmr;
+        if (reordered <= previous * threshold) {
+            indices.swap(result);
+        }
+    }
+
+    void optimizeVertexFetch(Mesh & mesh)
+    {
+        std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+        std::vector<MeshVertex> vertices;
+        vertices.reserve(mesh.vertices.size());
+        for (uint32_t & index : mesh.indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        mesh.vertices.swap(vertices);
+    }
+
+    MeshOptimizationStats optimizeMesh(Mesh & mesh, bool overdraw)
+    {
+        MeshOptimizationStats stats;
+        stats.before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        if (overdraw) {
+            optimizeOverdraw(mesh.indices, mesh.vertices);
+        }
+        // Last, it follows the final triangle order
+        optimizeVertexFetch(mesh);
+        stats.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        stats.after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        return stats;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+* Mesh optimization
+*
+* CPU passes that reorder a loaded mesh for the GPU without changing what is drawn: triangles are reordered for
+* post-transform vertex cache locality (Forsyth's linear-speed algorithm), optionally regrouped so triangles facing
+* outwards are drawn first to reduce overdraw, and vertices are reordered by first use for vertex fetch locality. The
+* effect is measured with a simulated FIFO vertex cache as ACMR (transformed vertices per triangle, 0.5 at best for
+* large regular meshes, 3 at worst) and ATVR (transformed vertices per vertex, 1 at best)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.hpp"
+
+namespace vks
+{
+    struct VertexCacheStats
+    {
+        /** @brief Average cache miss ratio, vertex shader invocations per triangle */
+        float acmr = 0.0f;
+        /** @brief Average transform to vertex ratio, vertex shader invocations per referenced vertex */
+        float atvr = 0.0f;
+        uint64_t transforms = 0;
+    };
+
+    struct MeshOptimizationStats
+    {
+        VertexCacheStats before;
+        VertexCacheStats after;
+        /** @brief Time in milliseconds spent in all passes */
+        double ms = 0.0;
+    };
+
+    /** @brief Size of the simulated FIFO cache, about what current GPUs reuse within a batch of vertices */
+    constexpr uint32_t defaultCacheSize = 16;
+
+    /**
+    * Simulate a FIFO post-transform vertex cache
+    *
+    * @param indices Triangle list
+    * @param indexCount Number of indices, a multiple of 3
+    * @param vertexCount Number of vertices, every index must be below it
+    * @param cacheSize Number of entries of the simulated cache
+    */
+    VertexCacheStats analyzeVertexCache(const uint32_t * indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = defaultCacheSize);
+
+    /** @brief Reorder triangles for vertex cache locality, the triangles and their winding stay the same */
+    void optimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount);
+
+    /**
+    * Reorder clusters of a cache optimized triangle list so triangles facing away from the center of the mesh come first
+    *
+    * @note Clusters start where the simulated cache had to transform all three vertices of a triangle, and within longer
+    * runs at triangles with at least two misses once a cluster is longer than the cache, so vertex reuse within a
+    * cluster is kept. The new order is dropped if it raises the ACMR by more than the threshold
+    *
+    * @param threshold Largest accepted ratio of the new and the previous ACMR, also of a cluster's and its run's ACMR
+    */
+    void optimizeOverdraw(std::vector<uint32_t> & indices, const std::vector<MeshVertex> & vertices, float threshold = 1.05f);
+
+    /** @brief Reorder vertices by their first use in the index buffer and drop unused ones, indices are remapped */
+    void optimizeVertexFetch(Mesh & mesh);
+
+    /** @brief Run the vertex cache, the optional overdraw and the vertex fetch pass */
+    MeshOptimizationStats optimizeMesh(Mesh & mesh, bool overdraw);
+}
@@ -0,0 +1,89 @@
+/*
+* Parallel command recording
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ParallelRecorder.hpp"
+
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    ParallelRecorder::~ParallelRecorder()
+    {
+        destroy();
+    }
+
+    void ParallelRecorder::create(VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t primaryCount)
+    {
+        destroy();
+        this->device = device;
+        workers.start(threadCount);
+
+        uint32_t workerCount = workers.size();
+        pools.resize(workerCount);
+        secondaryBuffers.resize(size_t(primaryCount) * workerCount);
+        for (uint32_t worker = 0; worker < workerCount; worker++) {
+            VkCommandPoolCreateInfo poolInfo = {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = queueFamilyIndex;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            VK_CHECK_RESULT(vkCreateCommandPool(device, &poolInfo, nullptr, &pools[worker]));
+
+            VkCommandBufferAllocateInfo allocateInfo = {};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.commandPool = pools[worker];
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocateInfo.commandBufferCount = 1;
+            for (uint32_t primary = 0; primary < primaryCount; primary++) {
+                VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, &secondaryBuffers[size_t(primary) * workerCount + worker]));
+            }
+        }
+    }
+
+    void ParallelRecorder::destroy()
+    {
+        workers.stop();
+        // Destroying a pool frees the command buffers allocated from it
+        for (VkCommandPool pool : pools) {
+            vkDestroyCommandPool(device, pool, nullptr);
+        }
+        pools.clear();
+        secondaryBuffers.clear();
+    }
+
+    void ParallelRecorder::record(VkCommandBuffer commandBuffer, uint32_t primary, const VkCommandBufferInheritanceInfo & inheritance,
+                                  uint32_t drawCount, const RecordFunction & record)
+    {
+        uint32_t workerCount = workers.size();
+        VkCommandBuffer * buffers = &secondaryBuffers[size_t(primary) * workerCount];
+        // Bytes rather than std::vector<bool>, whose bits would be written concurrently
+        std::vector<uint8_t> recorded(workerCount, 0);
+
+        workers.parallelFor(drawCount, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+            if (begin == end) {
+                return;
+            }
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            beginInfo.pInheritanceInfo = &inheritance;
+            VK_CHECK_RESULT(vkBeginCommandBuffer(buffers[worker], &beginInfo));
+            record(buffers[worker], begin, end - begin);
+            VK_CHECK_RESULT(vkEndCommandBuffer(buffers[worker]));
+            recorded[worker] = 1;
+        });
+
+        // Workers with an empty part (fewer draws than threads) recorded nothing
+        std::vector<VkCommandBuffer> executed;
+        for (uint32_t worker = 0; worker < workerCount; worker++) {
+            if (recorded[worker]) {
+                executed.push_back(buffers[worker]);
+            }
+        }
+        if (!executed.empty()) {
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(executed.size()), executed.data());
+        }
+    }
+}
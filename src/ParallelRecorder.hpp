@@ -0,0 +1,68 @@
+/*
+* Parallel command recording
+*
+* Records the draws of a render pass on several threads. Every thread owns a command pool with a secondary command
+* buffer per primary command buffer and records its contiguous part of the draw list into it, the primary command
+* buffer then executes the secondary ones in draw order with vkCmdExecuteCommands
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "WorkerPool.hpp"
+
+namespace vks
+{
+    class ParallelRecorder
+    {
+    public:
+        /** @brief Records the draws [firstDraw, firstDraw + drawCount) including the state they need into a secondary command buffer */
+        using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)>;
+
+        ~ParallelRecorder();
+
+        /**
+        * Create the command pools and start the threads, destroying the previous ones if the recorder has already been created
+        *
+        * @param device Device to create the command pools on
+        * @param queueFamilyIndex Queue family the primary command buffers are submitted to
+        * @param threadCount Number of recording threads including the calling one
+        * @param primaryCount Number of primary command buffers, each gets its own set of secondary command buffers
+        */
+        void create(VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t primaryCount);
+
+        void destroy();
+
+        uint32_t size() const
+        { return workers.size(); }
+
+        /**
+        * Record draws in parallel and execute them from a primary command buffer
+        *
+        * @note The primary command buffer has to be in a render pass instance begun with
+        * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, and no earlier recording for the same primary may be pending
+        *
+        * @param commandBuffer Primary command buffer
+        * @param primary Index of the primary command buffer, selects the set of secondary command buffers
+        * @param inheritance Render pass, subpass and framebuffer the secondary command buffers continue
+        * @param drawCount Number of draws, split into one contiguous part per thread
+        * @param record Function recording a part, called on all threads at once
+        */
+        void record(VkCommandBuffer commandBuffer, uint32_t primary, const VkCommandBufferInheritanceInfo & inheritance, uint32_t drawCount,
+                    const RecordFunction & record);
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        // One pool per thread, a pool and the command buffers allocated from it must only be used by one thread at a time
+        std::vector<VkCommandPool> pools;
+        // Indexed by primary * size() + thread
+        std::vector<VkCommandBuffer> secondaryBuffers;
+        WorkerPool workers;
+    };
+}
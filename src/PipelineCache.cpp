@@ -0,0 +1,166 @@
+/*
+* Persistent pipeline cache
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PipelineCache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    namespace
+    {
+        bool readFile(const std::string & filename, std::vector<uint8_t> & contents)
+        {
+            FILE * file = fopen(filename.c_str(), "rb");
+            if (!file) {
+                return false;
+            }
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            bool read = size >= 0;
+            if (read) {
+                contents.resize(size);
+                read = fread(contents.data(), 1, size, file) == (size_t) size;
+            }
+            fclose(file);
+            return read;
+        }
+
+        // Written next to the target so the rename stays on the same file system and replaces it atomically
+        bool writeFileAtomically(const std::string & filename, const uint8_t * data, size_t size)
+        {
+            std::string temporary = filename + ".tmp";
+            int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                return false;
+            }
+            bool written = true;
+            size_t offset = 0;
+            while (written && offset < size) {
+                ssize_t count = write(fd, data + offset, size - offset);
+                written = count > 0;
+                offset += written ? static_cast<size_t>(count) : 0;
+            }
+            // The data has to be on disk before the rename, otherwise a crash can leave a renamed but empty file
+            written = written && fsync(fd) == 0;
+            written = close(fd) == 0 && written;
+            written = written && rename(temporary.c_str(), filename.c_str()) == 0;
+            if (!written) {
+                unlink(temporary.c_str());
+            }
+            return written;
+        }
+
+        double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+    PipelineCache::~PipelineCache()
+    {
+        destroy();
+    }
+
+    const char * PipelineCache::validateHeader(const uint8_t * data, size_t size, const VkPhysicalDeviceProperties & properties)
+    {
+        // VkPipelineCacheHeaderVersionOne, read field by field as the file data has no particular alignment
+        uint32_t headerSize, headerVersion, vendorID, deviceID;
+        if (size < 16 + VK_UUID_SIZE) {
+            return "too small for a header";
+        }
+        memcpy(&headerSize, data, sizeof(uint32_t));
+        memcpy(&headerVersion, data + 4, sizeof(uint32_t));
+        memcpy(&vendorID, data + 8, sizeof(uint32_t));
+        memcpy(&deviceID, data + 12, sizeof(uint32_t));
+        if (headerSize < 16 + VK_UUID_SIZE || headerSize > size) {
+            return "invalid header size";
+        }
+        if (headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+            return "unknown header version";
+        }
+        if (vendorID != properties.vendorID || deviceID != properties.deviceID) {
+            return "written for a different device";
+        }
+        if (memcmp(data + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            return "written by a different driver version";
+        }
+        return nullptr;
+    }
+
+    void PipelineCache::create(vks::VulkanDevice * vulkanDevice, const std::string & filename)
+    {
+        destroy();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        this->device = vulkanDevice->logicalDevice;
+        this->filename = filename;
+        cacheStats = PipelineCacheStats();
+        loadedData.clear();
+
+        if (!filename.empty() && readFile(filename, loadedData)) {
+            cacheStats.rejected = validateHeader(loadedData.data(), loadedData.size(), vulkanDevice->properties);
+            if (cacheStats.rejected) {
+                std::cerr << "Warning: Ignoring pipeline cache \"" << filename << "\", " << cacheStats.rejected << std::endl;
+                loadedData.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = loadedData.size();
+        cacheInfo.pInitialData = loadedData.empty() ? nullptr : loadedData.data();
+        VK_CHECK_RESULT(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache));
+
+        cacheStats.warm = !loadedData.empty();
+        cacheStats.loadedBytes = loadedData.size();
+        cacheStats.loadMs = elapsedMs(start);
+    }
+
+    bool PipelineCache::save()
+    {
+        if (cache == VK_NULL_HANDLE || filename.empty()) {
+            return true;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t size = 0;
+        VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, nullptr));
+        std::vector<uint8_t> data(size);
+        VK_CHECK_RESULT(vkGetPipelineCacheData(device, cache, &size, data.data()));
+        data.resize(size);
+
+        // Nothing new was compiled, keep the file as it is
+        if (data == loadedData) {
+            return true;
+        }
+        if (!writeFileAtomically(filename, data.data(), data.size())) {
+            std::cerr << "Error: Could not write pipeline cache \"" << filename << "\"" << std::endl;
+            return false;
+        }
+        loadedData = std::move(data);
+        cacheStats.savedBytes = loadedData.size();
+        cacheStats.saveMs = elapsedMs(start);
+        return true;
+    }
+
+    void PipelineCache::destroy()
+    {
+        if (cache == VK_NULL_HANDLE) {
+            return;
+        }
+        vkDestroyPipelineCache(device, cache, nullptr);
+        cache = VK_NULL_HANDLE;
+    }
+}
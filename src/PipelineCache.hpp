@@ -0,0 +1,77 @@
+/*
+* Persistent pipeline cache
+*
+* A VkPipelineCache that is seeded from a file when it is created and written back when it is saved, so later launches
+* skip most of the shader compilation in the driver. The file is only used if its header matches the device (vendor,
+* device and pipeline cache UUID), anything else starts from an empty cache. Saving writes a temporary file and renames
+* it over the old one, so a crash while saving leaves either the old or the new cache and never a truncated one
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+    struct PipelineCacheStats
+    {
+        /** @brief The cache was seeded with the data of a previous run */
+        bool warm = false;
+        /** @brief Why the file was not used, nullptr if it was or if there was no file */
+        const char * rejected = nullptr;
+        size_t loadedBytes = 0;
+        size_t savedBytes = 0;
+        /** @brief Time in milliseconds spent reading the file and creating the cache */
+        double loadMs = 0.0;
+        double saveMs = 0.0;
+    };
+
+    class PipelineCache
+    {
+    public:
+        VkPipelineCache cache = VK_NULL_HANDLE;
+
+        ~PipelineCache();
+
+        /**
+        * Create the cache, seeded with the contents of the file if they were written for the same device
+        *
+        * @param vulkanDevice Device to create the cache on
+        * @param filename File the cache is loaded from and saved to, an empty name keeps the cache in memory only
+        */
+        void create(vks::VulkanDevice * vulkanDevice, const std::string & filename);
+
+        /**
+        * Write the cache data to the file if it differs from what was loaded
+        *
+        * @return False if the data could not be written, the previous file is left untouched in that case
+        */
+        bool save();
+
+        void destroy();
+
+        PipelineCacheStats stats() const
+        { return cacheStats; }
+
+        /**
+        * Check that pipeline cache data was written by a driver compatible with the device
+        *
+        * @return Reason the data can't be used, nullptr if it can
+        */
+        static const char * validateHeader(const uint8_t * data, size_t size, const VkPhysicalDeviceProperties & properties);
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        std::string filename;
+        // Data the cache was seeded with, saving is skipped if the cache still returns exactly this
+        std::vector<uint8_t> loadedData;
+        PipelineCacheStats cacheStats;
+    };
+}
@@ -0,0 +1,326 @@
+/*
+* Pixel conversion kernels for the screenshot readback path
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "PixelConversion.hpp"
+
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VKS_PIXELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+#define VKS_PIXELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace vks::pixels
+{
+    namespace
+    {
+        // Scalar reference kernels
+
+        inline uint32_t load32(const uint8_t * src)
+        {
+            uint32_t value;
+            memcpy(&value, src, sizeof(value));
+            return value;
+        }
+
+        template<PixelLayout layout>
+        void convertScalar(const uint8_t * src, uint8_t * dst, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; i++) {
+                if constexpr (layout == PixelLayout::R8G8B8A8) {
+                    dst[0] = src[0];
+                    dst[1] = src[1];
+                    dst[2] = src[2];
+                } else if constexpr (layout == PixelLayout::B8G8R8A8) {
+                    dst[0] = src[2];
+                    dst[1] = src[1];
+                    dst[2] = src[0];
+                } else if constexpr (layout == PixelLayout::A2B10G10R10) {
+                    uint32_t texel = load32(src);
+                    dst[0] = uint8_t(texel >> 2);
+                    dst[1] = uint8_t(texel >> 12);
+                    dst[2] = uint8_t(texel >> 22);
+                } else {
+                    uint32_t texel = load32(src);
+                    dst[0] = uint8_t(texel >> 22);
+                    dst[1] = uint8_t(texel >> 12);
+                    dst[2] = uint8_t(texel >> 2);
+                }
+                src += 4;
+                dst += 3;
+            }
+        }
+
+#if defined(VKS_PIXELS_X86)
+        // SSSE3 kernels: 16 texels per iteration
+        // 10 bit texels are first repacked to 8 bit RGBx so that all layouts share the same byte shuffle
+
+        template<PixelLayout layout>
+        __attribute__((target("ssse3"))) inline __m128i repackSSE(__m128i texels)
+        {
+            const __m128i byteMask = _mm_set1_epi32(0xFF);
+            if constexpr (layout == PixelLayout::A2B10G10R10) {
+                __m128i r = _mm_and_si128(_mm_srli_epi32(texels, 2), byteMask);
+                __m128i g = _mm_and_si128(_mm_srli_epi32(texels, 4), _mm_slli_epi32(byteMask, 8));
+                __m128i b = _mm_and_si128(_mm_srli_epi32(texels, 6), _mm_slli_epi32(byteMask, 16));
+                return _mm_or_si128(r, _mm_or_si128(g, b));
+            } else if constexpr (layout == PixelLayout::A2R10G10B10) {
+                __m128i r = _mm_and_si128(_mm_srli_epi32(texels, 22), byteMask);
+                __m128i g = _mm_and_si128(_mm_srli_epi32(texels, 4), _mm_slli_epi32(byteMask, 8));
+                __m128i b = _mm_and_si128(_mm_slli_epi32(texels, 14), _mm_slli_epi32(byteMask, 16));
+                return _mm_or_si128(r, _mm_or_si128(g, b));
+            } else {
+                return texels;
+            }
+        }
+
+        // Shuffle that packs the RGB bytes of four texels into the low 12 bytes and zeroes the upper 4
+        template<PixelLayout layout>
+        __attribute__((target("ssse3"))) inline __m128i shuffleMaskSSE()
+        {
+            if constexpr (layout == PixelLayout::B8G8R8A8) {
+                return _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            } else {
+                return _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            }
+        }
+
+        template<PixelLayout layout>
+        __attribute__((target("ssse3"))) void convertSSSE3(const uint8_t * src, uint8_t * dst, uint32_t count)
+        {
+            const __m128i mask = shuffleMaskSSE<layout>();
+            uint32_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                __m128i a = _mm_shuffle_epi8(repackSSE<layout>(_mm_loadu_si128((const __m128i *) (src + 0))), mask);
+                __m128i b = _mm_shuffle_epi8(repackSSE<layout>(_mm_loadu_si128((const __m128i *) (src + 16))), mask);
+                __m128i c = _mm_shuffle_epi8(repackSSE<layout>(_mm_loadu_si128((const __m128i *) (src + 32))), mask);
+                __m128i d = _mm_shuffle_epi8(repackSSE<layout>(_mm_loadu_si128((const __m128i *) (src + 48))), mask);
+                // Stitch the four 12 byte groups into three full 16 byte stores
+                _mm_storeu_si128((__m128i *) (dst + 0), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+                _mm_storeu_si128((__m128i *) (dst + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+                _mm_storeu_si128((__m128i *) (dst + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+                src += 64;
+                dst += 48;
+            }
+            convertScalar<layout>(src, dst, count - i);
+        }
+
+        // AVX2 kernels: 32 texels per iteration
+        // The byte shuffle works per 128 bit lane, a cross lane permute then moves the 24 valid bytes to the bottom
+
+        template<PixelLayout layout>
+        __attribute__((target("avx2"))) inline __m256i repackAVX2(__m256i texels)
+        {
+            const __m256i byteMask = _mm256_set1_epi32(0xFF);
+            if constexpr (layout == PixelLayout::A2B10G10R10) {
+                __m256i r = _mm256_and_si256(_mm256_srli_epi32(texels, 2), byteMask);
+                __m256i g = _mm256_and_si256(_mm256_srli_epi32(texels, 4), _mm256_slli_epi32(byteMask, 8));
+                __m256i b = _mm256_and_si256(_mm256_srli_epi32(texels, 6), _mm256_slli_epi32(byteMask, 16));
+                return _mm256_or_si256(r, _mm256_or_si256(g, b));
+            } else if constexpr (layout == PixelLayout::A2R10G10B10) {
+                __m256i r = _mm256_and_si256(_mm256_srli_epi32(texels, 22), byteMask);
+                __m256i g = _mm256_and_si256(_mm256_srli_epi32(texels, 4), _mm256_slli_epi32(byteMask, 8));
+                __m256i b = _mm256_and_si256(_mm256_slli_epi32(texels, 14), _mm256_slli_epi32(byteMask, 16));
+                return _mm256_or_si256(r, _mm256_or_si256(g, b));
+            } else {
+                return texels;
+            }
+        }
+
+        template<PixelLayout layout>
+        __attribute__((target("avx2"))) inline __m256i packAVX2(const uint8_t * src, __m256i mask, __m256i permute)
+        {
+            __m256i texels = repackAVX2<layout>(_mm256_loadu_si256((const __m256i *) src));
+            return _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(texels, mask), permute);
+        }
+
+        template<PixelLayout layout>
+        __attribute__((target("avx2"))) void convertAVX2(const uint8_t * src, uint8_t * dst, uint32_t count)
+        {
+            const __m256i mask = _mm256_broadcastsi128_si256(shuffleMaskSSE<layout>());
+            const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+            uint32_t i = 0;
+            for (; i + 32 <= count; i += 32) {
+                __m256i a = packAVX2<layout>(src + 0, mask, permute);
+                __m256i b = packAVX2<layout>(src + 32, mask, permute);
+                __m256i c = packAVX2<layout>(src + 64, mask, permute);
+                __m256i d = packAVX2<layout>(src + 96, mask, permute);
+                // Each store writes 24 valid bytes, the 8 trailing bytes are overwritten by the following store
+                _mm256_storeu_si256((__m256i *) (dst + 0), a);
+                _mm256_storeu_si256((__m256i *) (dst + 24), b);
+                _mm256_storeu_si256((__m256i *) (dst + 48), c);
+                // The last group must not write past the end of the destination
+                _mm_storeu_si128((__m128i *) (dst + 72), _mm256_castsi256_si128(d));
+                _mm_storel_epi64((__m128i *) (dst + 88), _mm256_extracti128_si256(d, 1));
+                src += 128;
+                dst += 96;
+            }
+            convertSSSE3<layout>(src, dst, count - i);
+        }
+#endif
+
+#if defined(VKS_PIXELS_NEON)
+        // NEON kernels: 16 texels per iteration using de-interleaving loads and interleaving stores
+
+        template<int shift>
+        inline uint8x16_t narrowChannel(uint32x4_t t0, uint32x4_t t1, uint32x4_t t2, uint32x4_t t3)
+        {
+            // Narrowing keeps the low bits, which makes the 0xFF mask of the scalar kernel implicit
+            uint16x8_t low = vcombine_u16(vmovn_u32(vshrq_n_u32(t0, shift)), vmovn_u32(vshrq_n_u32(t1, shift)));
+            uint16x8_t high = vcombine_u16(vmovn_u32(vshrq_n_u32(t2, shift)), vmovn_u32(vshrq_n_u32(t3, shift)));
+            return vcombine_u8(vmovn_u16(low), vmovn_u16(high));
+        }
+
+        template<PixelLayout layout>
+        void convertNEON(const uint8_t * src, uint8_t * dst, uint32_t count)
+        {
+            uint32_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                uint8x16x3_t rgb;
+                if constexpr (layout == PixelLayout::R8G8B8A8 || layout == PixelLayout::B8G8R8A8) {
+                    uint8x16x4_t texels = vld4q_u8(src);
+                    const int red = layout == PixelLayout::B8G8R8A8 ? 2 : 0;
+                    rgb.val[0] = texels.val[red];
+                    rgb.val[1] = texels.val[1];
+                    rgb.val[2] = texels.val[2 - red];
+                } else {
+                    uint32x4_t t0 = vreinterpretq_u32_u8(vld1q_u8(src + 0));
+                    uint32x4_t t1 = vreinterpretq_u32_u8(vld1q_u8(src + 16));
+                    uint32x4_t t2 = vreinterpretq_u32_u8(vld1q_u8(src + 32));
+                    uint32x4_t t3 = vreinterpretq_u32_u8(vld1q_u8(src + 48));
+                    const int red = layout == PixelLayout::A2R10G10B10 ? 2 : 0;
+                    rgb.val[red] = narrowChannel<2>(t0, t1, t2, t3);
+                    rgb.val[1] = narrowChannel<12>(t0, t1, t2, t3);
+                    rgb.val[2 - red] = narrowChannel<22>(t0, t1, t2, t3);
+                }
+                vst3q_u8(dst, rgb);
+                src += 64;
+                dst += 48;
+            }
+            convertScalar<layout>(src, dst, count - i);
+        }
+#endif
+
+        template<PixelLayout layout>
+        ConvertFunction selectKernel(Isa isa)
+        {
+            switch (isa) {
+                case Isa::Scalar:
+                    return convertScalar<layout>;
+#if defined(VKS_PIXELS_X86)
+                case Isa::SSSE3:
+                    return convertSSSE3<layout>;
+                case Isa::AVX2:
+                    return convertAVX2<layout>;
+#endif
+#if defined(VKS_PIXELS_NEON)
+                case Isa::NEON:
+                    return convertNEON<layout>;
+#endif
+                default:
+                    return nullptr;
+            }
+        }
+    }
+
+    const char * isaName(Isa isa)
+    {
+        switch (isa) {
+            case Isa::Scalar:
+                return "scalar";
+            case Isa::SSSE3:
+                return "ssse3";
+            case Isa::AVX2:
+                return "avx2";
+            case Isa::NEON:
+                return "neon";
+        }
+        return "unknown";
+    }
+
+    const char * layoutName(PixelLayout layout)
+    {
+        switch (layout) {
+            case PixelLayout::R8G8B8A8:
+                return "R8G8B8A8";
+            case PixelLayout::B8G8R8A8:
+                return "B8G8R8A8";
+            case PixelLayout::A2B10G10R10:
+                return "A2B10G10R10";
+            case PixelLayout::A2R10G10B10:
+                return "A2R10G10B10";
+        }
+        return "unknown";
+    }
+
+    bool isaSupported(Isa isa)
+    {
+        switch (isa) {
+            case Isa::Scalar:
+                return true;
+#if defined(VKS_PIXELS_X86)
+            case Isa::SSSE3:
+                return __builtin_cpu_supports("ssse3");
+            case Isa::AVX2:
+                return __builtin_cpu_supports("avx2");
+#endif
+#if defined(VKS_PIXELS_NEON)
+            case Isa::NEON:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    Isa bestIsa()
+    {
+        static const Isa best = [] {
+            for (Isa isa : { Isa::AVX2, Isa::NEON, Isa::SSSE3 }) {
+                if (isaSupported(isa)) {
+                    return isa;
+                }
+            }
+            return Isa::Scalar;
+        }();
+        return best;
+    }
+
+    ConvertFunction getKernel(PixelLayout layout, Isa isa)
+    {
+        if (!isaSupported(isa)) {
+            return nullptr;
+        }
+        switch (layout) {
+            case PixelLayout::R8G8B8A8:
+                return selectKernel<PixelLayout::R8G8B8A8>(isa);
+            case PixelLayout::B8G8R8A8:
+                return selectKernel<PixelLayout::B8G8R8A8>(isa);
+            case PixelLayout::A2B10G10R10:
+                return selectKernel<PixelLayout::A2B10G10R10>(isa);
+            case PixelLayout::A2R10G10B10:
+                return selectKernel<PixelLayout::A2R10G10B10>(isa);
+        }
+        return nullptr;
+    }
+
+    void convertToRGB(PixelLayout layout, const uint8_t * src, uint8_t * dst, uint32_t count)
+    {
+        static const ConvertFunction kernels[] = {
+            getKernel(PixelLayout::R8G8B8A8, bestIsa()),
+            getKernel(PixelLayout::B8G8R8A8, bestIsa()),
+            getKernel(PixelLayout::A2B10G10R10, bestIsa()),
+            getKernel(PixelLayout::A2R10G10B10, bestIsa()),
+        };
+        kernels[static_cast<int>(layout)](src, dst, count);
+    }
+}
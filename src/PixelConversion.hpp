@@ -0,0 +1,62 @@
+/*
+* Pixel conversion kernels for the screenshot readback path
+*
+* Converts 32 bit texels as read back from a linear image to packed 8 bit RGB
+* Vectorized kernels (SSSE3, AVX2, NEON) are selected at runtime, with a scalar fallback that also serves as reference
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace vks::pixels
+{
+    /** @brief Memory layout of a 32 bit source texel, named after the matching Vulkan format */
+    enum class PixelLayout
+    {
+        R8G8B8A8,       // VK_FORMAT_R8G8B8A8_*
+        B8G8R8A8,       // VK_FORMAT_B8G8R8A8_*
+        A2B10G10R10,    // VK_FORMAT_A2B10G10R10_*_PACK32 (red in the least significant bits)
+        A2R10G10B10,    // VK_FORMAT_A2R10G10B10_*_PACK32 (blue in the least significant bits)
+    };
+
+    /** @brief Instruction sets a conversion kernel can be implemented with */
+    enum class Isa
+    {
+        Scalar,
+        SSSE3,
+        AVX2,
+        NEON,
+    };
+
+    /**
+    * Signature of a conversion kernel
+    *
+    * @param src Source texels (4 bytes each, no alignment requirement)
+    * @param dst Destination for count * 3 bytes of packed RGB
+    * @param count Number of texels to convert
+    *
+    * @note 10 bit channels are converted to 8 bit by dropping the two least significant bits
+    */
+    typedef void (* ConvertFunction)(const uint8_t * src, uint8_t * dst, uint32_t count);
+
+    /** @brief Returns a readable name for an instruction set */
+    const char * isaName(Isa isa);
+
+    /** @brief Returns a readable name for a pixel layout */
+    const char * layoutName(PixelLayout layout);
+
+    /** @brief Returns true if the instruction set has been compiled in and is supported by the running cpu */
+    bool isaSupported(Isa isa);
+
+    /** @brief Returns the fastest instruction set supported by the running cpu */
+    Isa bestIsa();
+
+    /** @brief Returns the kernel for the given layout and instruction set, or nullptr if the instruction set is not supported */
+    ConvertFunction getKernel(PixelLayout layout, Isa isa);
+
+    /** @brief Convert count texels to packed RGB using the fastest available kernel */
+    void convertToRGB(PixelLayout layout, const uint8_t * src, uint8_t * dst, uint32_t count);
+}
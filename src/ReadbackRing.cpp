@@ -0,0 +1,129 @@
+/*
+* Ring of persistently mapped readback images
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ReadbackRing.hpp"
+
+#include <chrono>
+
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    ReadbackRing::~ReadbackRing()
+    {
+        destroy();
+    }
+
+    bool ReadbackRing::create(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkCommandPool commandPool, uint32_t width, uint32_t height, VkFormat format, uint32_t slotCount)
+    {
+        destroy();
+
+        this->device = vulkanDevice->logicalDevice;
+        this->allocator = allocator;
+        this->commandPool = commandPool;
+        this->width = width;
+        this->height = height;
+
+        slots.resize(slotCount);
+        mapMs = 0.0;
+
+        std::vector<VkCommandBuffer> cmdBuffers(slotCount);
+        VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, slotCount);
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, cmdBuffers.data()));
+
+        for (uint32_t i = 0; i < slotCount; i++) {
+            ReadbackSlot & slot = slots[i];
+            slot.cmdBuffer = cmdBuffers[i];
+
+            VkImageCreateInfo imageCreateCI(vks::initializers::imageCreateInfo());
+            imageCreateCI.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateCI.format = format;
+            imageCreateCI.extent.width = width;
+            imageCreateCI.extent.height = height;
+            imageCreateCI.extent.depth = 1;
+            imageCreateCI.arrayLayers = 1;
+            imageCreateCI.mipLevels = 1;
+            imageCreateCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageCreateCI.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateCI.tiling = VK_IMAGE_TILING_LINEAR;
+            imageCreateCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            VK_CHECK_RESULT(vkCreateImage(device, &imageCreateCI, nullptr, &slot.image));
+
+            // Cached memory is a lot faster to read from on the host, the allocator falls back to uncached memory if there is none
+            // The allocator keeps host visible blocks mapped, so this is where the images get mapped
+            auto mapStart = std::chrono::high_resolution_clock::now();
+            bool allocated = allocator->allocateImage(slot.image, ResourceTiling::Linear, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                      slot.memory, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            if (!allocated) {
+                // Slots that haven't been reached yet only have their command buffer, destroy skips the null handles
+                destroy();
+                return false;
+            }
+            mapMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mapStart).count();
+
+            // The layout of a linear image does not change, so it is queried once
+            VkImageSubresource subResource { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+            VkSubresourceLayout subResourceLayout;
+            vkGetImageSubresourceLayout(device, slot.image, &subResource, &subResourceLayout);
+            slot.data = slot.memory.mapped + subResourceLayout.offset;
+            slot.rowPitch = subResourceLayout.rowPitch;
+
+            VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+            VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &slot.fence));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeSlots.clear();
+        for (ReadbackSlot & slot : slots) {
+            freeSlots.push_back(&slot);
+        }
+        return true;
+    }
+
+    void ReadbackRing::destroy()
+    {
+        for (ReadbackSlot & slot : slots) {
+            vkDestroyImage(device, slot.image, nullptr);
+            allocator->free(slot.memory);
+            vkDestroyFence(device, slot.fence, nullptr);
+            vkFreeCommandBuffers(device, commandPool, 1, &slot.cmdBuffer);
+        }
+        slots.clear();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeSlots.clear();
+    }
+
+    ReadbackSlot * ReadbackRing::acquire(bool wait)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wait) {
+            slotReleased.wait(lock, [this] { return !freeSlots.empty(); });
+        }
+        if (freeSlots.empty()) {
+            return nullptr;
+        }
+        ReadbackSlot * slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    void ReadbackRing::release(ReadbackSlot * slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeSlots.push_back(slot);
+        }
+        slotReleased.notify_one();
+    }
+
+    uint32_t ReadbackRing::available() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<uint32_t>(freeSlots.size());
+    }
+}
@@ -0,0 +1,97 @@
+/*
+* Ring of persistently mapped readback images
+*
+* Host visible linear images that swapchain images are copied into for screenshots. The images are allocated and
+* mapped once for the swapchain extent, so capturing a frame does not allocate, bind or map any memory
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "MemoryAllocator.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+    /** @brief A readback image together with the command buffer and fence used to copy into it */
+    struct ReadbackSlot
+    {
+        VkImage image = VK_NULL_HANDLE;
+        vks::MemoryAllocation memory;
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        /** @brief Pointer to the first texel of the persistently mapped image */
+        const uint8_t * data = nullptr;
+        /** @brief Row pitch of the linear image in bytes */
+        VkDeviceSize rowPitch = 0;
+    };
+
+    class ReadbackRing
+    {
+    public:
+        /** @brief Number of slots, allows captures of consecutive frames while earlier ones are still being written */
+        static constexpr uint32_t defaultSlotCount = 3;
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        /** @brief Time in milliseconds spent allocating and mapping the images, paid once on creation instead of on every capture */
+        double mapMs = 0.0;
+
+        ~ReadbackRing();
+
+        /**
+        * Create the readback images, destroying the previous ones if the ring has already been created
+        *
+        * @note All slots must have been released, e.g. by waiting for the screenshot worker to become idle
+        *
+        * @param vulkanDevice Device to create the images on
+        * @param allocator Allocator the image memory is taken from
+        * @param commandPool Pool to allocate the copy command buffers from
+        * @param width Width of the swapchain images
+        * @param height Height of the swapchain images
+        * @param format Format of the readback images
+        * @param slotCount Number of readback images
+        *
+        * @return False if an image could not get host visible memory, the ring is left without slots
+        */
+        bool create(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkCommandPool commandPool, uint32_t width, uint32_t height, VkFormat format, uint32_t slotCount = defaultSlotCount);
+
+        /** @brief Unmap and free all readback images */
+        void destroy();
+
+        /**
+        * Take a free slot out of the ring
+        *
+        * @param wait Block until a slot is released if all slots are in use
+        *
+        * @return Acquired slot, nullptr if all slots are in use and wait is false
+        */
+        ReadbackSlot * acquire(bool wait = false);
+
+        /** @brief Return a slot to the ring, may be called from any thread */
+        void release(ReadbackSlot * slot);
+
+        /** @brief Number of readback images, 0 if the ring hasn't been created */
+        uint32_t size() const
+        { return static_cast<uint32_t>(slots.size()); }
+
+        /** @brief Number of slots that can currently be acquired */
+        uint32_t available() const;
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        vks::MemoryAllocator * allocator = nullptr;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        std::vector<ReadbackSlot> slots;
+        std::vector<ReadbackSlot *> freeSlots;
+        mutable std::mutex mutex;
+        std::condition_variable slotReleased;
+    };
+}
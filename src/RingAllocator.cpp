@@ -0,0 +1,48 @@
+/*
+* Ring allocation of a buffer
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "RingAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vks
+{
+    RingAllocator::RingAllocator(uint64_t size)
+        : ringSize(size)
+    {}
+
+    bool RingAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t & offset)
+    {
+        if (size == 0 || size > ringSize) {
+            return false;
+        }
+        alignment = std::max<uint64_t>(alignment, 1);
+
+        uint64_t position = headPosition;
+        uint64_t start = (position % ringSize + alignment - 1) & ~(alignment - 1);
+        if (start + size > ringSize) {
+            // Skip the rest of the buffer, the padding is released together with the range
+            position += ringSize - position % ringSize;
+            start = 0;
+        } else {
+            position += start - position % ringSize;
+        }
+        if (position + size - tailPosition > ringSize) {
+            return false;
+        }
+
+        headPosition = position + size;
+        offset = start;
+        return true;
+    }
+
+    void RingAllocator::release(uint64_t position)
+    {
+        assert(position >= tailPosition && position <= headPosition);
+        tailPosition = std::min(std::max(position, tailPosition), headPosition);
+    }
+}
@@ -0,0 +1,53 @@
+/*
+* Ring allocation of a buffer
+*
+* Bookkeeping for handing out aligned ranges of a buffer in FIFO order, kept free of Vulkan calls so the logic can be
+* exercised on the CPU. Positions grow monotonically, a range is never split across the end of the buffer and space is
+* returned by releasing everything up to a position, e.g. once the fence of the submission that used it has signaled
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace vks
+{
+    class RingAllocator
+    {
+    public:
+        /** @param size Size of the buffer in bytes */
+        explicit RingAllocator(uint64_t size);
+
+        /**
+        * Reserve the range following the last one, wrapping to the start of the buffer if it doesn't fit before the end
+        *
+        * @param size Size of the range in bytes, at most the size of the buffer
+        * @param alignment Required alignment of the offset, must be a power of two
+        * @param offset Set to the offset of the range within the buffer
+        *
+        * @return False if the range would overwrite one that hasn't been released yet
+        */
+        bool allocate(uint64_t size, uint64_t alignment, uint64_t & offset);
+
+        /** @brief Position after the last reserved range, pass it to release once all ranges up to here are unused */
+        uint64_t head() const
+        { return headPosition; }
+
+        /** @brief Return all ranges before position, positions must be released in increasing order */
+        void release(uint64_t position);
+
+        uint64_t size() const
+        { return ringSize; }
+
+        /** @brief Bytes between the oldest unreleased range and the head, including padding */
+        uint64_t used() const
+        { return headPosition - tailPosition; }
+
+    private:
+        uint64_t ringSize;
+        uint64_t headPosition = 0;
+        uint64_t tailPosition = 0;
+    };
+}
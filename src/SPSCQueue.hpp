@@ -0,0 +1,74 @@
+/*
+* Bounded single producer single consumer queue
+*
+* Lock-free ring buffer used to hand captured frames from the render thread to a writer thread. Exactly one thread
+* may push and exactly one other thread may pop
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace vks
+{
+    template<typename T>
+    class SPSCQueue
+    {
+    public:
+        /** @brief Create a queue holding at least capacity elements, the capacity is rounded up to a power of two */
+        explicit SPSCQueue(size_t capacity)
+        {
+            size_t size = 1;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            elements.resize(size);
+            mask = size - 1;
+        }
+
+        /** @brief Push an element, returns false without modifying the element if the queue is full (producer only) */
+        bool tryPush(T && element)
+        {
+            const size_t tail = this->tail.load(std::memory_order_relaxed);
+            if (tail - head.load(std::memory_order_acquire) == elements.size()) {
+                return false;
+            }
+            elements[tail & mask] = std::move(element);
+            this->tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** @brief Pop the oldest element, returns false if the queue is empty (consumer only) */
+        bool tryPop(T & element)
+        {
+            const size_t head = this->head.load(std::memory_order_relaxed);
+            if (head == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            element = std::move(elements[head & mask]);
+            this->head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** @brief Number of queued elements, only exact when called from the producer or consumer thread */
+        size_t size() const
+        {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const
+        { return elements.size(); }
+
+    private:
+        std::vector<T> elements;
+        size_t mask = 0;
+        // Head and tail are written by different threads, keep them on separate cache lines
+        alignas(64) std::atomic<size_t> head { 0 };
+        alignas(64) std::atomic<size_t> tail { 0 };
+    };
+}
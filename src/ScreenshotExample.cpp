@@ -11,10 +11,11 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
-#include <fstream>
 #include <vector>
 
 #define GLM_FORCE_RADIANS
@@ -24,8 +25,11 @@
 
 #include <vulkan/vulkan.h>
 #include "ScreenshotExample.hpp"
+#include "ImageWriter.hpp"
+#include "Trace.hpp"
 
-ScreenshotExample::ScreenshotExample()
+ScreenshotExample::ScreenshotExample(bool headless, uint32_t width, uint32_t height)
+    : headless(headless), width(width), height(height), startupStart(std::chrono::high_resolution_clock::now())
 {
     struct stat info;
     if (stat(getAssetPath().c_str(), &info) != 0) {
@@ -39,24 +43,54 @@ ScreenshotExample::ScreenshotExample()
 
 ScreenshotExample::~ScreenshotExample()
 {
+    // Finish writing pending screenshots before any of the resources they use are destroyed
+    frameRecorder.reset();
+    screenshotWorker.reset();
+    readbackRing.destroy();
+
+    if (!traceFilename.empty()) {
+        writeTrace(traceFilename);
+    }
+
+    vkDeviceWaitIdle(device);
+
+    // Pipelines compiled in this run are kept for the next one
+    pipelineCache.save();
+    pipelineCache.destroy();
+    shaderLibrary.destroy();
+
+    gpuProfiler.destroy();
+    stagingRing.destroy();
+    parallelRecorder.destroy();
+    frameCommandPools.destroy();
+
     vkDestroyPipeline(device, pipeline, nullptr);
 
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
     vkDestroyBuffer(device, vertices.buffer, nullptr);
-    vkFreeMemory(device, vertices.memory, nullptr);
+    memoryAllocator.free(vertices.memory);
 
     vkDestroyBuffer(device, indices.buffer, nullptr);
-    vkFreeMemory(device, indices.memory, nullptr);
+    memoryAllocator.free(indices.memory);
 
-    vkDestroyBuffer(device, uniformBufferVS.buffer, nullptr);
-    vkFreeMemory(device, uniformBufferVS.memory, nullptr);
+    uniformBufferVS.destroy();
+    instanceBuffer.destroy();
 
-    vkDestroySemaphore(device, presentCompleteSemaphore, nullptr);
-    vkDestroySemaphore(device, renderCompleteSemaphore, nullptr);
+    for (auto & sync : frameSync) {
+        vkDestroySemaphore(device, sync.presentComplete, nullptr);
+        vkDestroyFence(device, sync.fence, nullptr);
+    }
+    for (VkSemaphore semaphore : renderComplete) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
 
-    swapChain.cleanup();
+    if (headless) {
+        offscreenTarget.cleanup();
+    } else {
+        swapChain.cleanup();
+    }
     if (descriptorPool != VK_NULL_HANDLE) {
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     }
@@ -66,78 +100,84 @@ ScreenshotExample::~ScreenshotExample()
         vkDestroyFramebuffer(device, frameBuffer, nullptr);
     }
 
-    for (auto & shaderModule : shaderModules) {
-        vkDestroyShaderModule(device, shaderModule, nullptr);
-    }
     vkDestroyCommandPool(device, cmdPool, nullptr);
+    vkDestroyCommandPool(device, transientCmdPool, nullptr);
 
-    for (auto & fence : waitFences) {
-        vkDestroyFence(device, fence, nullptr);
-    }
+    memoryAllocator.destroy();
 
     delete vulkanDevice;
 
     vkDestroyInstance(instance, nullptr);
 }
 
-uint32_t ScreenshotExample::getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties)
-{
-    for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
-        if ((typeBits & 1) == 1) {
-            if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                return i;
-            }
-        }
-        typeBits >>= 1;
-    }
-
-    throw "Could not find a suitable memory type!";
-}
-
+// One acquire semaphore and a fence per frame in flight, so the CPU can record frame N + 1 while the GPU still renders frame N
 void ScreenshotExample::prepareSynchronizationPrimitives()
 {
+    framesInFlight = std::min(std::max(framesInFlight, 1u), maxFramesInFlight);
+
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphoreCreateInfo.pNext = nullptr;
 
-    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &presentCompleteSemaphore));
-
-    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &renderCompleteSemaphore));
-
+    // Fences are created signaled so the first use of each set doesn't wait
     VkFenceCreateInfo fenceCreateInfo = {};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    waitFences.resize(drawCmdBuffers.size());
-    for (auto & fence : waitFences) {
-        VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+
+    frameSync.resize(framesInFlight);
+    for (auto & sync : frameSync) {
+        VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &sync.presentComplete));
+        VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &sync.fence));
     }
+    currentFrame = 0;
 }
 
-VkCommandBuffer ScreenshotExample::getCommandBuffer(bool begin)
+// Secondary command buffers inherit no state from the primary one, so every part sets everything its draws need
+void ScreenshotExample::recordDraws(VkCommandBuffer commandBuffer, uint32_t image, uint32_t firstDraw, uint32_t count)
 {
-    VkCommandBuffer cmdBuffer;
-
-    VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
-    cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBufAllocateInfo.commandPool = cmdPool;
-    cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufAllocateInfo.commandBufferCount = 1;
-
-    VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cmdBuffer));
-
-    if (begin) {
-        VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-        VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+    VkViewport viewport = {};
+    viewport.height = (float) height;
+    viewport.width = (float) width;
+    viewport.minDepth = (float) 0.0f;
+    viewport.maxDepth = (float) 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.extent.width = width;
+    scissor.extent.height = height;
+    scissor.offset.x = 0;
+    scissor.offset.y = 0;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    uint32_t dynamicOffset = uniformBufferVS.dynamicOffset(image);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    VkDeviceSize offsets[1] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+    if (instanceCount > 0) {
+        // Each command buffer reads the transforms from its own slice, written in draw() before it's submitted
+        VkDeviceSize instanceOffset = instanceBuffer.dynamicOffset(image);
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer.buffer, &instanceOffset);
+    }
+    vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, indices.type);
+
+    // Draw d covers the instances [instanceCount * d / drawCount, instanceCount * (d + 1) / drawCount)
+    uint32_t totalInstances = std::max(instanceCount, 1u);
+    for (uint32_t draw = firstDraw; draw < firstDraw + count; draw++) {
+        uint32_t firstInstance = static_cast<uint32_t>(uint64_t(totalInstances) * draw / drawCount);
+        uint32_t endInstance = static_cast<uint32_t>(uint64_t(totalInstances) * (draw + 1) / drawCount);
+        vkCmdDrawIndexed(commandBuffer, indices.count, endInstance - firstInstance, 0, 0, firstInstance);
     }
-
-    return cmdBuffer;
 }
 
-void ScreenshotExample::buildCommandBuffers()
+void ScreenshotExample::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image, VkCommandBufferUsageFlags usage)
 {
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     cmdBufInfo.pNext = nullptr;
+    cmdBufInfo.flags = usage;
 
     VkClearValue clearValues[1];
     clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
@@ -152,173 +192,368 @@ void ScreenshotExample::buildCommandBuffers()
     renderPassBeginInfo.renderArea.extent.height = height;
     renderPassBeginInfo.clearValueCount = 1;
     renderPassBeginInfo.pClearValues = clearValues;
+    renderPassBeginInfo.framebuffer = frameBuffers[image];
+
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+    // The command buffer of an image always uses the image's query slot, it's collected before the image is rendered to again
+    gpuProfiler.begin(commandBuffer, renderPassScope, image);
+
+    if (parallelRecorder.size() > 1) {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = frameBuffers[image];
+        parallelRecorder.record(commandBuffer, image, inheritanceInfo, drawCount, [this, image](VkCommandBuffer secondary, uint32_t firstDraw, uint32_t count) {
+            recordDraws(secondary, image, firstDraw, count);
+        });
+    } else {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        recordDraws(commandBuffer, image, 0, drawCount);
+    }
+    vkCmdEndRenderPass(commandBuffer);
 
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
-        renderPassBeginInfo.framebuffer = frameBuffers[i];
+    gpuProfiler.end(commandBuffer, renderPassScope, image);
 
-        VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+}
 
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+void ScreenshotExample::buildCommandBuffers()
+{
+    VKS_TRACE_SCOPE("buildCommandBuffers");
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < drawCmdBuffers.size(); ++i) {
+        recordCommandBuffer(drawCmdBuffers[i], i, 0);
+    }
+    startupStats.recordMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+}
 
-        VkViewport viewport = {};
-        viewport.height = (float) height;
-        viewport.width = (float) width;
-        viewport.minDepth = (float) 0.0f;
-        viewport.maxDepth = (float) 1.0f;
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+double ScreenshotExample::measureRecording(uint32_t threadCount, uint32_t iterations)
+{
+    // The command buffers may still be pending, and their pool only resets them all at once
+    VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+    recordThreads = std::max(threadCount, 1u);
+    if (recordThreads > 1) {
+        uint32_t queueFamilyIndex = headless ? offscreenTarget.queueNodeIndex : swapChain.queueNodeIndex;
+        parallelRecorder.create(device, queueFamilyIndex, recordThreads, static_cast<uint32_t>(drawCmdBuffers.size()));
+    } else {
+        parallelRecorder.destroy();
+    }
 
-        VkRect2D scissor = {};
-        scissor.extent.width = width;
-        scissor.extent.height = height;
-        scissor.offset.x = 0;
-        scissor.offset.y = 0;
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+    double best = 0.0;
+    for (uint32_t i = 0; i < std::max(iterations, 1u); i++) {
+        VK_CHECK_RESULT(vkResetCommandPool(device, cmdPool, 0));
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        for (uint32_t image = 0; image < drawCmdBuffers.size(); image++) {
+            recordCommandBuffer(drawCmdBuffers[image], image, 0);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+        best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
 
-        vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+void ScreenshotExample::draw()
+{
+    VKS_TRACE_SCOPE("draw");
+    updateFrameTimes();
+
+    // Wait until the GPU has finished the frame that last used this set, with more than one frame in flight
+    // that frame was submitted several frames ago and has usually completed already
+    FrameSync & sync = frameSync[currentFrame];
+    auto fenceWaitStart = std::chrono::high_resolution_clock::now();
+    VK_CHECK_RESULT(vkWaitForFences(device, 1, &sync.fence, VK_TRUE, UINT64_MAX));
+    double fenceWaitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - fenceWaitStart).count();
+
+    if (headless) {
+        offscreenTarget.acquireNextImage(&currentBuffer);
+    } else {
+        VK_CHECK_RESULT(swapChain.acquireNextImage(sync.presentComplete, &currentBuffer));
+    }
 
-        vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    // Images aren't necessarily acquired in the order of the frame sets, an image may still be in use by another frame
+    if (imagesInFlight[currentBuffer] != VK_NULL_HANDLE && imagesInFlight[currentBuffer] != sync.fence) {
+        fenceWaitStart = std::chrono::high_resolution_clock::now();
+        VK_CHECK_RESULT(vkWaitForFences(device, 1, &imagesInFlight[currentBuffer], VK_TRUE, UINT64_MAX));
+        fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - fenceWaitStart).count();
+    }
+    imagesInFlight[currentBuffer] = sync.fence;
+    fenceWaitTimes.add(fenceWaitMs);
 
-        VkDeviceSize offsets[1] = { 0 };
-        vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &vertices.buffer, offsets);
-        vkCmdBindIndexBuffer(drawCmdBuffers[i], indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(drawCmdBuffers[i], indices.count, 1, 0, 0, 1);
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
+    // Picks up the timestamps of every submission that has completed in the meantime, including the last one of this image
+    gpuProfiler.update();
+    stagingRing.update();
 
-        VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+    // Nothing reads this image's uniform slice anymore, so it can be written without stalling
+    if (uniformSliceGenerations[currentBuffer] != uniformGeneration) {
+        uniformBufferVS.write(currentBuffer, &uboVS, sizeof(uboVS));
+        uniformSliceGenerations[currentBuffer] = uniformGeneration;
+    }
+    if (instanceCount > 0) {
+        updateInstances();
     }
-}
 
-void ScreenshotExample::draw()
-{
-    VK_CHECK_RESULT(swapChain.acquireNextImage(presentCompleteSemaphore, &currentBuffer));
+    VK_CHECK_RESULT(vkResetFences(device, 1, &sync.fence));
 
-    VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
-    VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
+    if (toggleRecording) {
+        if (frameRecorder) {
+            stopRecording();
+        } else {
+            startRecording();
+        }
+        toggleRecording = false;
+    }
 
+    // A screenshot is taken as soon as a readback image is free, until then the request stays pending (unless waiting for one is requested)
+    bool takeScreenshot = doScreenshot && (waitForReadback || readbackRing.available() > 0);
+    // Depending on the recorder's policy this blocks until a readback image is free or drops the frame
+    vks::ReadbackSlot * recordingSlot = frameRecorder ? frameRecorder->acquire(frameCounter) : nullptr;
+    bool copyFrame = takeScreenshot || recordingSlot;
+    // The submission that finishes last signals the semaphore presentation waits on, headless frames aren't presented at all
+    bool presentFrame = !headless && !copyFrame;
+
+    // The fence wait above covers everything recorded from this frame's pool, and the image wait the secondary command
+    // buffers of this image, so both can be recorded over without any further synchronization
+    VkCommandBuffer commandBuffer = drawCmdBuffers[currentBuffer];
+    if (rerecordEveryFrame) {
+        auto recordStart = std::chrono::high_resolution_clock::now();
+        frameCommandPools.begin(currentFrame);
+        commandBuffer = frameCommandPools.acquire();
+        recordCommandBuffer(commandBuffer, currentBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        frameRecordTimes.add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count());
+    }
+
+    VkSemaphore imageRenderComplete = renderComplete[currentBuffer];
     VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pWaitDstStageMask = &waitStageMask;               // Pointer to the list of pipeline stages that the semaphore waits will occur at
-    submitInfo.pWaitSemaphores = &presentCompleteSemaphore;      // Semaphore(s) to wait upon before the submitted command buffer starts executing
-    submitInfo.waitSemaphoreCount = 1;                           // One wait semaphore
-    submitInfo.pSignalSemaphores = &renderCompleteSemaphore;     // Semaphore(s) to be signaled when command buffers have completed
-    submitInfo.signalSemaphoreCount = 1;                         // One signal semaphore
-    submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer]; // Command buffers(s) to execute in this batch (submission)
+    submitInfo.pWaitSemaphores = &sync.presentComplete;          // Semaphore(s) to wait upon before the submitted command buffer starts executing
+    submitInfo.waitSemaphoreCount = headless ? 0 : 1;            // One wait semaphore, there is nothing to wait for without a swapchain
+    submitInfo.pSignalSemaphores = &imageRenderComplete;         // Semaphore(s) to be signaled when command buffers have completed
+    submitInfo.signalSemaphoreCount = presentFrame ? 1 : 0;      // Copies of the frame signal the semaphore instead if they follow this submission
+    submitInfo.pCommandBuffers = &commandBuffer;                 // Command buffers(s) to execute in this batch (submission)
     submitInfo.commandBufferCount = 1;                           // One command buffer
 
-    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, waitFences[currentBuffer]));
-    if (doScreenshot) {
-        vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX);
-        std::string outputPath = getOutputPath() + "/../screenshot.ppm";
-        saveScreenshot(outputPath.c_str());
+    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, sync.fence));
+    gpuProfiler.submitted(renderPassScope, currentBuffer);
+    if (frameCounter == 0) {
+        startupStats.firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupStart).count();
+    }
+    if (takeScreenshot) {
+        std::string outputPath = screenshotFilename.empty()
+            ? getOutputPath() + "/screenshot" + vks::image::formatExtension(screenshotFormat)
+            : screenshotFilename;
+        saveScreenshot(outputPath.c_str(), !headless && !recordingSlot);
         doScreenshot = false;
     }
+    if (recordingSlot) {
+        copyToReadback(recordingSlot, !headless);
+        frameRecorder->push(recordingSlot);
+    }
+    lastFrameCapturing = copyFrame || screenshotWorker->pending() > 0;
+    frameCounter++;
+
+    if (!headless) {
+        VkResult present = swapChain.queuePresent(queue, currentBuffer, imageRenderComplete);
+        if (!((present == VK_SUCCESS) || (present == VK_SUBOPTIMAL_KHR))) {
+            VK_CHECK_RESULT(present);
+        }
+    }
 
-    VkResult present = swapChain.queuePresent(queue, currentBuffer, renderCompleteSemaphore);
-    if (!((present == VK_SUCCESS) || (present == VK_SUBOPTIMAL_KHR))) {
-        VK_CHECK_RESULT(present);
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void ScreenshotExample::waitForScreenshots()
+{
+    screenshotWorker->waitIdle();
+}
+
+vks::ScreenshotStats ScreenshotExample::getScreenshotStats() const
+{
+    return screenshotWorker->stats();
+}
+
+double ScreenshotExample::getReadbackMapTime() const
+{
+    return readbackRing.mapMs;
+}
+
+vks::MemoryStats ScreenshotExample::getMemoryStats() const
+{
+    return memoryAllocator.stats();
+}
+
+std::vector<vks::GpuScopeStats> ScreenshotExample::getGpuScopeStats() const
+{
+    return gpuProfiler.enabled() ? gpuProfiler.stats() : std::vector<vks::GpuScopeStats>();
+}
+
+bool ScreenshotExample::writeTrace(const std::string & filename)
+{
+    if (!vks::trace::enabled()) {
+        std::cerr << "Error: Tracing is not compiled in, configure with -DSCREENSHOT_TRACING=ON" << std::endl;
+        return false;
+    }
+    if (!vks::trace::writeChromeTrace(filename)) {
+        return false;
     }
+    std::cout << "Trace written to " << filename << std::endl;
+    return true;
+}
 
+ScreenshotExample::FramePacingStats ScreenshotExample::getFramePacingStats() const
+{
+    FramePacingStats stats;
+    stats.framesInFlight = framesInFlight;
+    stats.frames = fenceWaitTimes.count();
+    uint64_t frameIntervals = frameTimes.count() + captureFrameTimes.count();
+    if (frameIntervals > 0) {
+        stats.frameMs = (frameTimes.mean() * frameTimes.count() + captureFrameTimes.mean() * captureFrameTimes.count()) / frameIntervals;
+    }
+    stats.fenceWaitMs = fenceWaitTimes.mean();
+    return stats;
 }
 
-void ScreenshotExample::prepareVertices(bool useStagingBuffers)
+ScreenshotExample::StartupStats ScreenshotExample::getStartupStats() const
 {
-    std::vector<Vertex> vertexBuffer =
-        {
-            { { 1.0f,  1.0f,  0.0f }, { 1.0f, 0.0f, 0.0f } },
-            { { -1.0f, 1.0f,  0.0f }, { 0.0f, 1.0f, 0.0f } },
-            { { 0.0f,  -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
-        };
-    uint32_t vertexBufferSize = static_cast<uint32_t>(vertexBuffer.size()) * sizeof(Vertex);
+    StartupStats stats = startupStats;
+    stats.pipelineCache = pipelineCache.stats();
+    stats.shaders = shaderLibrary.stats();
+    return stats;
+}
 
-    std::vector<uint32_t> indexBuffer = { 0, 1, 2 };
-    indices.count = static_cast<uint32_t>(indexBuffer.size());
-    uint32_t indexBufferSize = indices.count * sizeof(uint32_t);
+// Frame times are taken from the start of one frame to the start of the next one, so stalls in draw() show up as spikes
+// Frames that captured a screenshot or overlapped with one being written are recorded separately to compare the two
+void ScreenshotExample::updateFrameTimes()
+{
+    auto now = std::chrono::high_resolution_clock::now();
+    if (lastFrameStart.time_since_epoch().count() == 0) {
+        lastFrameStart = now;
+        lastFrameTimeReport = now;
+        return;
+    }
 
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    VkMemoryRequirements memReqs;
+    double frameTime = std::chrono::duration<double, std::milli>(now - lastFrameStart).count();
+    (lastFrameCapturing ? captureFrameTimes : frameTimes).add(frameTime);
+    lastFrameStart = now;
+
+    if (std::chrono::duration<double>(now - lastFrameTimeReport).count() >= 5.0) {
+        lastFrameTimeReport = now;
+        std::cout << "Frame time (ms) without capture: frames " << frameTimes.count()
+                  << ", p50 " << frameTimes.percentile(50.0) << ", p99 " << frameTimes.percentile(99.0) << ", max " << frameTimes.max()
+                  << " | with capture: frames " << captureFrameTimes.count()
+                  << ", p50 " << captureFrameTimes.percentile(50.0) << ", p99 " << captureFrameTimes.percentile(99.0) << ", max " << captureFrameTimes.max()
+                  << std::endl;
+        std::cout << "Fence wait (ms) with " << framesInFlight << " frames in flight: mean " << fenceWaitTimes.mean()
+                  << ", p50 " << fenceWaitTimes.percentile(50.0) << ", p99 " << fenceWaitTimes.percentile(99.0) << ", max " << fenceWaitTimes.max()
+                  << std::endl;
+        for (const auto & scope : getGpuScopeStats()) {
+            std::cout << "GPU time (ms) " << scope.name << ": samples " << scope.samples
+                      << ", min " << scope.minMs << ", avg " << scope.avgMs << ", p99 " << scope.p99Ms << std::endl;
+        }
+    }
+}
 
-    void * data;
+bool ScreenshotExample::loadMesh(const std::string & filename)
+{
+    VKS_TRACE_SCOPE("loadMesh");
+    if (!vks::loadMesh(filename, mesh)) {
+        mesh = vks::Mesh();
+        return false;
+    }
+    if (mesh.indices.empty()) {
+        std::cerr << "Error: Mesh \"" << filename << "\" has no triangles" << std::endl;
+        mesh = vks::Mesh();
+        return false;
+    }
+    vks::fitToUnitCube(mesh);
+    if (optimizeMeshes) {
+        VKS_TRACE_SCOPE("optimizeMesh");
+        meshOptimizationStats = vks::optimizeMesh(mesh, optimizeOverdraw);
+    }
+    return true;
+}
 
-    if (useStagingBuffers) {
-        struct StagingBuffer
-        {
-            VkDeviceMemory memory;
-            VkBuffer buffer;
-        };
-
-        struct
-        {
-            StagingBuffer vertices;
-            StagingBuffer indices;
-        } stagingBuffers;
+vks::MeshOptimizationStats ScreenshotExample::getMeshOptimizationStats() const
+{
+    return meshOptimizationStats;
+}
+
+vks::UploadStats ScreenshotExample::getUploadStats(double & uploadMs) const
+{
+    uploadMs = this->uploadMs;
+    return stagingRing.stats();
+}
 
+bool ScreenshotExample::prepareVertices(bool useStagingBuffers)
+{
+    VKS_TRACE_SCOPE("prepareVertices");
+    if (mesh.vertices.empty()) {
+        mesh.vertices =
+            {
+                { { 1.0f,  1.0f,  0.0f }, { 1.0f, 0.0f, 0.0f } },
+                { { -1.0f, 1.0f,  0.0f }, { 0.0f, 1.0f, 0.0f } },
+                { { 0.0f,  -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
+            };
+        mesh.indices = { 0, 1, 2 };
+    }
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    indices.count = static_cast<uint32_t>(mesh.indices.size());
+
+    // Compact vertices and 16 bit indices halve the memory and the vertex fetch bandwidth of large meshes
+    const void * vertexData = mesh.vertices.data();
+    std::vector<vks::vertices::CompactVertex> compactVertices;
+    if (vertexFormat != vks::vertices::VertexFormat::Float32) {
+        compactVertices.resize(vertexCount);
+        vks::vertices::pack(vertexFormat, mesh.vertices.data(), compactVertices.data(), vertexCount);
+        vertexData = compactVertices.data();
+    }
+    VkDeviceSize vertexBufferSize = VkDeviceSize(vertexCount) * vks::vertices::vertexStride(vertexFormat);
+
+    const void * indexData = mesh.indices.data();
+    std::vector<uint16_t> shortIndices;
+    indices.type = VK_INDEX_TYPE_UINT32;
+    VkDeviceSize indexBufferSize = VkDeviceSize(indices.count) * sizeof(uint32_t);
+    if (vks::vertices::fitsShortIndices(vertexCount)) {
+        shortIndices.resize(indices.count);
+        vks::vertices::narrowIndices(mesh.indices.data(), shortIndices.data(), indices.count);
+        indexData = shortIndices.data();
+        indices.type = VK_INDEX_TYPE_UINT16;
+        indexBufferSize = VkDeviceSize(indices.count) * sizeof(uint16_t);
+    }
+
+    // Buffers are bound to ranges of the allocator's blocks instead of getting a device memory allocation each
+    if (useStagingBuffers) {
         VkBufferCreateInfo vertexBufferInfo = {};
         vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         vertexBufferInfo.size = vertexBufferSize;
-        vertexBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        VK_CHECK_RESULT(vkCreateBuffer(device, &vertexBufferInfo, nullptr, &stagingBuffers.vertices.buffer));
-        vkGetBufferMemoryRequirements(device, stagingBuffers.vertices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(
-            memReqs.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &stagingBuffers.vertices.memory));
-        VK_CHECK_RESULT(vkMapMemory(device, stagingBuffers.vertices.memory, 0, memAlloc.allocationSize, 0, &data));
-        memcpy(data, vertexBuffer.data(), vertexBufferSize);
-        vkUnmapMemory(device, stagingBuffers.vertices.memory);
-        VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffers.vertices.buffer, stagingBuffers.vertices.memory, 0));
-
         vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
         VK_CHECK_RESULT(vkCreateBuffer(device, &vertexBufferInfo, nullptr, &vertices.buffer));
-        vkGetBufferMemoryRequirements(device, vertices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &vertices.memory));
-        VK_CHECK_RESULT(vkBindBufferMemory(device, vertices.buffer, vertices.memory, 0));
+        if (!memoryAllocator.allocateBuffer(vertices.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertices.memory)) {
+            return false;
+        }
 
         VkBufferCreateInfo indexbufferInfo = {};
         indexbufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         indexbufferInfo.size = indexBufferSize;
-        indexbufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        VK_CHECK_RESULT(vkCreateBuffer(device, &indexbufferInfo, nullptr, &stagingBuffers.indices.buffer));
-        vkGetBufferMemoryRequirements(device, stagingBuffers.indices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(
-            memReqs.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &stagingBuffers.indices.memory));
-        VK_CHECK_RESULT(vkMapMemory(device, stagingBuffers.indices.memory, 0, indexBufferSize, 0, &data));
-        memcpy(data, indexBuffer.data(), indexBufferSize);
-        vkUnmapMemory(device, stagingBuffers.indices.memory);
-        VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffers.indices.buffer, stagingBuffers.indices.memory, 0));
-
         indexbufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
         VK_CHECK_RESULT(vkCreateBuffer(device, &indexbufferInfo, nullptr, &indices.buffer));
-        vkGetBufferMemoryRequirements(device, indices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &indices.memory));
-        VK_CHECK_RESULT(vkBindBufferMemory(device, indices.buffer, indices.memory, 0));
-
-        VkCommandBuffer copyCmd = getCommandBuffer(true);
-
-        VkBufferCopy copyRegion = {};
-
-        copyRegion.size = vertexBufferSize;
-        vkCmdCopyBuffer(copyCmd, stagingBuffers.vertices.buffer, vertices.buffer, 1, &copyRegion);
-        copyRegion.size = indexBufferSize;
-        vkCmdCopyBuffer(copyCmd, stagingBuffers.indices.buffer, indices.buffer, 1, &copyRegion);
-
-        vulkanDevice->flushCommandBuffer(copyCmd, queue);
+        if (!memoryAllocator.allocateBuffer(indices.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indices.memory)) {
+            return false;
+        }
 
-        vkDestroyBuffer(device, stagingBuffers.vertices.buffer, nullptr);
-        vkFreeMemory(device, stagingBuffers.vertices.memory, nullptr);
-        vkDestroyBuffer(device, stagingBuffers.indices.buffer, nullptr);
-        vkFreeMemory(device, stagingBuffers.indices.memory, nullptr);
+        // The copies are submitted in batches without waiting, the first frame's submission is ordered after them
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!stagingRing.create(vulkanDevice, &memoryAllocator, transientCmdPool, queue)) {
+            return false;
+        }
+        stagingRing.upload(vertices.buffer, 0, vertexData, vertexBufferSize);
+        stagingRing.upload(indices.buffer, 0, indexData, indexBufferSize);
+        stagingRing.submit();
+        uploadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
     } else {
         VkBufferCreateInfo vertexBufferInfo = {};
         vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -326,17 +561,11 @@ void ScreenshotExample::prepareVertices(bool useStagingBuffers)
         vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 
         VK_CHECK_RESULT(vkCreateBuffer(device, &vertexBufferInfo, nullptr, &vertices.buffer));
-        vkGetBufferMemoryRequirements(device, vertices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(
-            memReqs.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &vertices.memory));
-        VK_CHECK_RESULT(vkMapMemory(device, vertices.memory, 0, memAlloc.allocationSize, 0, &data));
-        memcpy(data, vertexBuffer.data(), vertexBufferSize);
-        vkUnmapMemory(device, vertices.memory);
-        VK_CHECK_RESULT(vkBindBufferMemory(device, vertices.buffer, vertices.memory, 0));
+        if (!memoryAllocator.allocateBuffer(vertices.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertices.memory)) {
+            return false;
+        }
+        memcpy(vertices.memory.mapped, vertexData, vertexBufferSize);
+        memoryAllocator.flush(vertices.memory);
 
         VkBufferCreateInfo indexbufferInfo = {};
         indexbufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -344,24 +573,22 @@ void ScreenshotExample::prepareVertices(bool useStagingBuffers)
         indexbufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
         VK_CHECK_RESULT(vkCreateBuffer(device, &indexbufferInfo, nullptr, &indices.buffer));
-        vkGetBufferMemoryRequirements(device, indices.buffer, &memReqs);
-        memAlloc.allocationSize = memReqs.size;
-        memAlloc.memoryTypeIndex = getMemoryTypeIndex(
-            memReqs.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-        VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &indices.memory));
-        VK_CHECK_RESULT(vkMapMemory(device, indices.memory, 0, indexBufferSize, 0, &data));
-        memcpy(data, indexBuffer.data(), indexBufferSize);
-        vkUnmapMemory(device, indices.memory);
-        VK_CHECK_RESULT(vkBindBufferMemory(device, indices.buffer, indices.memory, 0));
+        if (!memoryAllocator.allocateBuffer(indices.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indices.memory)) {
+            return false;
+        }
+        memcpy(indices.memory.mapped, indexData, indexBufferSize);
+        memoryAllocator.flush(indices.memory);
     }
+
+    // Everything has been copied into the ring or the buffers
+    mesh = vks::Mesh();
+    return true;
 }
 
 void ScreenshotExample::setupDescriptorPool()
 {
     VkDescriptorPoolSize typeCounts[1];
-    typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    typeCounts[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     typeCounts[0].descriptorCount = 1;
     VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
     descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -376,7 +603,7 @@ void ScreenshotExample::setupDescriptorPool()
 void ScreenshotExample::setupDescriptorSetLayout()
 {
     VkDescriptorSetLayoutBinding layoutBinding = {};
-    layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layoutBinding.descriptorCount = 1;
     layoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     layoutBinding.pImmutableSamplers = nullptr;
@@ -413,7 +640,7 @@ void ScreenshotExample::setupDescriptorSet()
     writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     writeDescriptorSet.dstSet = descriptorSet;
     writeDescriptorSet.descriptorCount = 1;
-    writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     writeDescriptorSet.pBufferInfo = &uniformBufferVS.descriptor;
     writeDescriptorSet.dstBinding = 0;
 
@@ -423,10 +650,11 @@ void ScreenshotExample::setupDescriptorSet()
 
 void ScreenshotExample::setupFrameBuffer()
 {
-    frameBuffers.resize(swapChain.imageCount);
+    const std::vector<SwapChainBuffer> & buffers = headless ? offscreenTarget.buffers : swapChain.buffers;
+    frameBuffers.resize(buffers.size());
     for (size_t i = 0; i < frameBuffers.size(); i++) {
         std::array<VkImageView, 1> attachments;
-        attachments[0] = swapChain.buffers[i].view;
+        attachments[0] = buffers[i].view;
 
         VkFramebufferCreateInfo frameBufferCreateInfo = {};
         frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -444,14 +672,14 @@ void ScreenshotExample::setupRenderPass()
 {
     std::array<VkAttachmentDescription, 1> attachments = {};
 
-    attachments[0].format = swapChain.colorFormat;
+    attachments[0].format = colorFormat;
     attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
     attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[0].finalLayout = targetLayout();
 
     VkAttachmentReference colorReference = {};
     colorReference.attachment = 0;
@@ -477,6 +705,14 @@ void ScreenshotExample::setupRenderPass()
     dependencies[0].srcAccessMask = 0;
     dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    if (headless) {
+        // Without an acquire semaphore nothing else orders the clear after the capture copy still reading the image
+        // from an earlier frame, nor after the previous render pass writing it. The copy runs outside of any render
+        // pass, so the dependency can't be by region
+        dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dependencyFlags = 0;
+    }
 
     dependencies[1].srcSubpass = 0;
     dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
@@ -498,40 +734,7 @@ void ScreenshotExample::setupRenderPass()
     VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass));
 }
 
-VkShaderModule ScreenshotExample::loadSPIRVShader(std::string filename)
-{
-    size_t shaderSize;
-    char * shaderCode = NULL;
-
-    std::ifstream is(filename, std::ios::binary | std::ios::in | std::ios::ate);
-
-    if (is.is_open()) {
-        shaderSize = is.tellg();
-        is.seekg(0, std::ios::beg);
-        shaderCode = new char[shaderSize];
-        is.read(shaderCode, shaderSize);
-        is.close();
-        assert(shaderSize > 0);
-    }
-    if (shaderCode) {
-        VkShaderModuleCreateInfo moduleCreateInfo {};
-        moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        moduleCreateInfo.codeSize = shaderSize;
-        moduleCreateInfo.pCode = (uint32_t *) shaderCode;
-
-        VkShaderModule shaderModule;
-        VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, NULL, &shaderModule));
-
-        delete[] shaderCode;
-
-        return shaderModule;
-    } else {
-        std::cerr << "Error: Could not open shader file \"" << filename << "\"" << std::endl;
-        return VK_NULL_HANDLE;
-    }
-}
-
-void ScreenshotExample::preparePipelines()
+bool ScreenshotExample::preparePipelines()
 {
     VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -577,41 +780,63 @@ void ScreenshotExample::preparePipelines()
     multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
     multisampleState.pSampleMask = nullptr;
 
-    VkVertexInputBindingDescription vertexInputBinding = {};
-    vertexInputBinding.binding = 0;
-    vertexInputBinding.stride = sizeof(Vertex);
-    vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::array<VkVertexInputBindingDescription, 2> vertexInputBindings {};
+    vertexInputBindings[0].binding = 0;
+    vertexInputBindings[0].stride = vks::vertices::vertexStride(vertexFormat);
+    vertexInputBindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    vertexInputBindings[1].binding = 1;
+    vertexInputBindings[1].stride = vks::instances::transformSize;
+    vertexInputBindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
-    std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributs;
+    // The compact formats are converted to floats by the vertex input stage, the shader is the same for all of them
+    std::array<VkVertexInputAttributeDescription, 6> vertexInputAttributs {};
     vertexInputAttributs[0].binding = 0;
     vertexInputAttributs[0].location = 0;
-    vertexInputAttributs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexInputAttributs[0].offset = offsetof(Vertex, position);
     vertexInputAttributs[1].binding = 0;
     vertexInputAttributs[1].location = 1;
-    vertexInputAttributs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexInputAttributs[1].offset = offsetof(Vertex, color);
+    if (vertexFormat == vks::vertices::VertexFormat::Float32) {
+        vertexInputAttributs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        vertexInputAttributs[0].offset = offsetof(Vertex, position);
+        vertexInputAttributs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        vertexInputAttributs[1].offset = offsetof(Vertex, color);
+    } else {
+        vertexInputAttributs[0].format = vertexFormat == vks::vertices::VertexFormat::Half ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R16G16B16A16_SNORM;
+        vertexInputAttributs[0].offset = offsetof(vks::vertices::CompactVertex, position);
+        vertexInputAttributs[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        vertexInputAttributs[1].offset = offsetof(vks::vertices::CompactVertex, color);
+    }
+    // The instance transform is a mat4, one location per column
+    for (uint32_t column = 0; column < 4; column++) {
+        vertexInputAttributs[2 + column].binding = 1;
+        vertexInputAttributs[2 + column].location = 2 + column;
+        vertexInputAttributs[2 + column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        vertexInputAttributs[2 + column].offset = column * 4 * sizeof(float);
+    }
 
+    bool instanced = instanceCount > 0;
     VkPipelineVertexInputStateCreateInfo vertexInputState = {};
     vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputState.vertexBindingDescriptionCount = 1;
-    vertexInputState.pVertexBindingDescriptions = &vertexInputBinding;
-    vertexInputState.vertexAttributeDescriptionCount = 2;
+    vertexInputState.vertexBindingDescriptionCount = instanced ? 2 : 1;
+    vertexInputState.pVertexBindingDescriptions = vertexInputBindings.data();
+    vertexInputState.vertexAttributeDescriptionCount = instanced ? 6 : 2;
     vertexInputState.pVertexAttributeDescriptions = vertexInputAttributs.data();
 
     std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages {};
 
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = loadSPIRVShader(getShadersPath() + "triangle/triangle.vert.spv");
+    shaderStages[0].module = shaderLibrary.load(instanced ? "triangle/triangle_instanced.vert.spv" : "triangle/triangle.vert.spv");
     shaderStages[0].pName = "main";
-    assert(shaderStages[0].module != VK_NULL_HANDLE);
 
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = loadSPIRVShader(getShadersPath() + "triangle/triangle.frag.spv");
+    shaderStages[1].module = shaderLibrary.load("triangle/triangle.frag.spv");
     shaderStages[1].pName = "main";
-    assert(shaderStages[1].module != VK_NULL_HANDLE);
+
+    // The library has already said which shader is missing or broken, prepare() fails once the other steps have finished
+    if (shaderStages[0].module == VK_NULL_HANDLE || shaderStages[1].module == VK_NULL_HANDLE) {
+        return false;
+    }
 
     pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
     pipelineCreateInfo.pStages = shaderStages.data();
@@ -625,74 +850,142 @@ void ScreenshotExample::preparePipelines()
     pipelineCreateInfo.renderPass = renderPass;
     pipelineCreateInfo.pDynamicState = &dynamicState;
 
-    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline));
+    VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache.cache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 
-    vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
-    vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+    return true;
 }
 
-void ScreenshotExample::prepareUniformBuffers()
+// The command buffers are recorded once per image, so the ring has a slice per image rather than per frame in flight
+// A slice is only written once the fence of the last submission of its command buffer has signaled
+bool ScreenshotExample::prepareUniformBuffers()
 {
-    VkMemoryRequirements memReqs;
-
-    VkBufferCreateInfo bufferInfo = {};
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.pNext = nullptr;
-    allocInfo.allocationSize = 0;
-    allocInfo.memoryTypeIndex = 0;
-
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = sizeof(uboVS);
-    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-
-    VK_CHECK_RESULT(vkCreateBuffer(device, &bufferInfo, nullptr, &uniformBufferVS.buffer));
-    vkGetBufferMemoryRequirements(device, uniformBufferVS.buffer, &memReqs);
-    allocInfo.allocationSize = memReqs.size;
-    allocInfo.memoryTypeIndex = getMemoryTypeIndex(
-        memReqs.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    );
-    VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &(uniformBufferVS.memory)));
-    VK_CHECK_RESULT(vkBindBufferMemory(device, uniformBufferVS.buffer, uniformBufferVS.memory, 0));
-
-    uniformBufferVS.descriptor.buffer = uniformBufferVS.buffer;
-    uniformBufferVS.descriptor.offset = 0;
-    uniformBufferVS.descriptor.range = sizeof(uboVS);
+    uint32_t sliceCount = static_cast<uint32_t>(drawCmdBuffers.size());
+    if (!uniformBufferVS.create(vulkanDevice, &memoryAllocator, sizeof(uboVS), sliceCount)) {
+        return false;
+    }
+    uniformSliceGenerations.assign(sliceCount, 0);
 
     updateUniformBuffers();
+    return true;
+}
+
+// Like the uniform ring, one slice of transforms per pre-recorded command buffer
+bool ScreenshotExample::prepareInstances()
+{
+    instanceStates = vks::instances::createGrid(instanceCount, 1.8f);
+    VkDeviceSize sliceSize = VkDeviceSize(instanceCount) * vks::instances::transformSize;
+    return instanceBuffer.create(vulkanDevice, &memoryAllocator, sliceSize, static_cast<uint32_t>(drawCmdBuffers.size()), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 }
 
+// Animated by frame rather than by wall clock time, so headless captures of a given frame are reproducible
+void ScreenshotExample::updateInstances()
+{
+    VKS_TRACE_SCOPE("updateInstances");
+    auto start = std::chrono::high_resolution_clock::now();
+    float time = float(frameCounter) / 60.0f;
+    vks::instances::updateTransforms(instanceStates.data(), instanceCount, time, static_cast<float *>(instanceBuffer.slice(currentBuffer)));
+    instanceBuffer.flush(currentBuffer, VkDeviceSize(instanceCount) * vks::instances::transformSize);
+    instanceUpdateTimes.add(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+}
+
+double ScreenshotExample::getInstanceUpdateTime() const
+{
+    return instanceUpdateTimes.mean();
+}
+
+double ScreenshotExample::getFrameRecordTime(vks::CommandPoolStats & poolStats) const
+{
+    poolStats = frameCommandPools.stats();
+    return frameRecordTimes.mean();
+}
+
+// Only updates the host copy, the slices are brought up to date in draw() right before their command buffer is submitted
 void ScreenshotExample::updateUniformBuffers()
 {
     uboVS.projectionMatrix = projectionMatrix;
     uboVS.viewMatrix = viewMatrix;
     uboVS.modelMatrix = glm::mat4(1.0f);
-
-    uint8_t * pData;
-    VK_CHECK_RESULT(vkMapMemory(device, uniformBufferVS.memory, 0, sizeof(uboVS), 0, (void **) &pData));
-    memcpy(pData, &uboVS, sizeof(uboVS));
-    vkUnmapMemory(device, uniformBufferVS.memory);
+    uniformGeneration++;
 }
 
-void ScreenshotExample::prepare()
+bool ScreenshotExample::prepare()
 {
-    initSwapchain();
-    createCommandPool();
-    setupSwapChain();
-    createCommandBuffers();
-    createSynchronizationPrimitives();
-    setupRenderPass();
-    setupFrameBuffer();
-    prepareSynchronizationPrimitives();
-    prepareVertices(false);
-    prepareUniformBuffers();
-    setupDescriptorSetLayout();
-    preparePipelines();
-    setupDescriptorPool();
-    setupDescriptorSet();
-    buildCommandBuffers();
+    VKS_TRACE_SCOPE("prepare");
+
+    // Steps that use the command pool or the queue (swapchain and readback setup, the vertex upload and recording the
+    // command buffers) are ordered by their dependencies, the memory allocator, the shader library and the pipeline
+    // cache may be used from several threads. The surface is tied to the view, so its step stays on the calling thread
+    // Set by any step that failed, read after graph.run() has joined the threads. Recording is skipped once it's set
+    std::atomic<bool> failed { false };
+    vks::TaskGraph graph;
+    auto swapchainTask = graph.add("swapchain", [this, &failed] {
+        initSwapchain();
+        createCommandPool();
+        if (!setupSwapChain()) {
+            failed = true;
+        }
+        createCommandBuffers();
+        createSynchronizationPrimitives();
+    }, {}, true);
+    auto frameSyncTask = graph.add("frameSync", [this] { prepareSynchronizationPrimitives(); });
+    auto renderPassTask = graph.add("renderPass", [this] { setupRenderPass(); }, { swapchainTask });
+    auto frameBufferTask = graph.add("frameBuffers", [this] { setupFrameBuffer(); }, { renderPassTask });
+    auto vertexTask = graph.add("vertices", [this, &failed] {
+        if (!prepareVertices(true)) {
+            failed = true;
+        }
+    }, { swapchainTask });
+    auto uniformTask = graph.add("uniforms", [this, &failed] {
+        if (!prepareUniformBuffers() || (instanceCount > 0 && !prepareInstances())) {
+            failed = true;
+        }
+    }, { swapchainTask });
+    auto layoutTask = graph.add("descriptorSetLayout", [this] { setupDescriptorSetLayout(); });
+    auto cacheTask = graph.add("pipelineCache", [this] {
+        shaderLibrary.create(device, getShadersPath());
+        pipelineCache.create(vulkanDevice, pipelineCacheFilename.empty() ? getOutputPath() + "/pipeline_cache.bin" : pipelineCacheFilename);
+    });
+    auto pipelineTask = graph.add("pipelines", [this, &failed] {
+        if (!preparePipelines()) {
+            failed = true;
+        }
+    }, { renderPassTask, layoutTask, cacheTask });
+    auto poolTask = graph.add("descriptorPool", [this] { setupDescriptorPool(); });
+    auto descriptorSetTask = graph.add("descriptorSet", [this] { setupDescriptorSet(); }, { poolTask, layoutTask, uniformTask });
+    auto profilerTask = graph.add("profiler", [this] { prepareProfiler(); }, { swapchainTask });
+    auto recorderTask = graph.add("recorder", [this] {
+        drawCount = std::min(std::max(drawCount, 1u), std::max(instanceCount, 1u));
+        if (recordThreads > 1) {
+            uint32_t queueFamilyIndex = headless ? offscreenTarget.queueNodeIndex : swapChain.queueNodeIndex;
+            parallelRecorder.create(device, queueFamilyIndex, recordThreads, static_cast<uint32_t>(drawCmdBuffers.size()));
+        }
+    }, { swapchainTask });
+    // Command buffers recorded every frame come from one pool per frame in flight instead
+    graph.add("commandBuffers", [this, &failed] {
+        if (failed) {
+            return;
+        }
+        if (rerecordEveryFrame) {
+            uint32_t queueFamilyIndex = headless ? offscreenTarget.queueNodeIndex : swapChain.queueNodeIndex;
+            frameCommandPools.create(device, queueFamilyIndex, framesInFlight);
+        } else {
+            buildCommandBuffers();
+        }
+    }, { frameSyncTask, frameBufferTask, pipelineTask, descriptorSetTask, vertexTask, uniformTask, profilerTask, recorderTask });
+    // setupSwapChain waits for the worker if there is one already, so it's only created after that
+    graph.add("screenshotWorker", [this] { prepareScreenshot(); }, { swapchainTask });
+    graph.run(prepareThreads);
+
+    startupStats.prepareMs = graph.elapsedMs();
+    startupStats.prepareCriticalPathMs = graph.criticalPathMs();
+    startupStats.prepareSteps = graph.timings();
+    startupStats.pipelineMs = startupStats.prepareSteps[pipelineTask].durationMs;
+    if (failed) {
+        std::cerr << "Error: Could not prepare rendering, see the errors above" << std::endl;
+        return false;
+    }
     prepared = true;
+    return true;
 }
 
 void ScreenshotExample::render()
@@ -714,72 +1007,105 @@ void ScreenshotExample::keyPressed(uint32_t keycode)
         case 35: // lower case p
             doScreenshot = true;
             break;
+        case 15: // lower case r
+            toggleRecording = true;
+            break;
+        case 17: // lower case t
+            writeTrace(getOutputPath() + "/trace.json");
+            break;
         default:
             break;
     }
 }
 
-// Take a screenshot from the current swapchain image
-// This is done using a blit from the swapchain image to a linear image whose memory content is then saved as a ppm image
-// Getting the image date directly from a swapchain image wouldn't work as they're usually stored in an implementation dependant optimal tiling format
-// Note: This requires the swapchain images to be created with the VK_IMAGE_USAGE_TRANSFER_SRC_BIT flag (see VulkanSwapChain::create)
-void ScreenshotExample::saveScreenshot(const char * filename)
+// If we can't use blit (which does automatic conversion to the RGBA destination format) the copied texels keep the layout of the source format
+// BGR and 10 bit sources have to be swizzled/converted manually when writing the image
+// Note: Not complete, only contains the most common surface formats
+static vks::pixels::PixelLayout getReadbackLayout(VkFormat format, bool supportsBlit)
+{
+    if (supportsBlit) {
+        return vks::pixels::PixelLayout::R8G8B8A8;
+    }
+    switch (format) {
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SNORM:
+            return vks::pixels::PixelLayout::B8G8R8A8;
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            return vks::pixels::PixelLayout::A2B10G10R10;
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+            return vks::pixels::PixelLayout::A2R10G10B10;
+        default:
+            return vks::pixels::PixelLayout::R8G8B8A8;
+    }
+}
+
+// The copy of a screenshot is waited on, converted and written by a worker thread so that the render thread is not blocked
+void ScreenshotExample::prepareScreenshot()
 {
-    bool supportsBlit = true;
+    screenshotWorker.reset(new vks::ScreenshotWorker(device));
+}
+
+// Timestamps around the render pass and the capture copy show which of the two limits the capture rate on a driver
+// Results are read once the GPU has written them, so profiling adds no waits to the render thread
+void ScreenshotExample::prepareProfiler()
+{
+    // Copies are recorded per capture and cycle through their slots, one for every readback image of the screenshot ring
+    // and of the recorder, so a slot is never reused while its copy may still be in flight
+    recordingDepthLimit = std::max(recordingSettings.queueDepth, 1u);
+    uint32_t captureSlots = readbackRing.size() + recordingDepthLimit;
+    uint32_t renderPassSlots = static_cast<uint32_t>(drawCmdBuffers.size());
+    uint32_t queueFamilyIndex = headless ? offscreenTarget.queueNodeIndex : swapChain.queueNodeIndex;
+
+    gpuProfiler.create(vulkanDevice, queueFamilyIndex, renderPassSlots + captureSlots);
+    renderPassScope = gpuProfiler.addScope("render pass", renderPassSlots);
+    captureScope = gpuProfiler.addScope(readbackSupportsBlit ? "capture blit" : "capture copy", captureSlots);
+}
+
+// Check once whether the swapchain images can be blitted to the readback images, the result decides the texel layout of every capture
+void ScreenshotExample::prepareReadback()
+{
+    readbackSupportsBlit = true;
 
     // Check blit support for source and destination
     VkFormatProperties formatProps;
 
     // Check if the device supports blitting from optimal images (the swapchain images are in optimal format)
-    vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChain.colorFormat, &formatProps);
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProps);
     if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
         std::cerr << "Device does not support blitting from optimal tiled images, using copy instead of blit!" << std::endl;
-        supportsBlit = false;
+        readbackSupportsBlit = false;
     }
 
     // Check if the device supports blitting to linear images
     vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
     if (!(formatProps.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
         std::cerr << "Device does not support blitting to linear tiled images, using copy instead of blit!" << std::endl;
-        supportsBlit = false;
+        readbackSupportsBlit = false;
     }
 
-    // Source for the copy is the last rendered swapchain image
-    VkImage srcImage = swapChain.images[currentBuffer];
+    readbackLayout = getReadbackLayout(colorFormat, readbackSupportsBlit);
+}
 
-    // Create the linear tiled destination image to copy to and to read the memory from
-    VkImageCreateInfo imageCreateCI(vks::initializers::imageCreateInfo());
-    imageCreateCI.imageType = VK_IMAGE_TYPE_2D;
-    // Note that vkCmdBlitImage (if supported) will also do format conversions if the swapchain color format would differ
-    imageCreateCI.format = VK_FORMAT_R8G8B8A8_UNORM;
-    imageCreateCI.extent.width = width;
-    imageCreateCI.extent.height = height;
-    imageCreateCI.extent.depth = 1;
-    imageCreateCI.arrayLayers = 1;
-    imageCreateCI.mipLevels = 1;
-    imageCreateCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageCreateCI.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageCreateCI.tiling = VK_IMAGE_TILING_LINEAR;
-    imageCreateCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    // Create the image
-    VkImage dstImage;
-    VK_CHECK_RESULT(vkCreateImage(device, &imageCreateCI, nullptr, &dstImage));
-    // Create memory to back up the image
-    VkMemoryRequirements memRequirements;
-    VkMemoryAllocateInfo memAllocInfo(vks::initializers::memoryAllocateInfo());
-    VkDeviceMemory dstImageMemory;
-    vkGetImageMemoryRequirements(device, dstImage, &memRequirements);
-    memAllocInfo.allocationSize = memRequirements.size;
-    // Memory must be host visible to copy from
-    memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(
-        memRequirements.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    );
-    VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dstImageMemory));
-    VK_CHECK_RESULT(vkBindImageMemory(device, dstImage, dstImageMemory, 0));
+// Copy the current swapchain image into a readback image
+// This is done using a blit from the swapchain image to a linear image whose memory content is then saved as a ppm image
+// Getting the image date directly from a swapchain image wouldn't work as they're usually stored in an implementation dependant optimal tiling format
+// Note: This requires the swapchain images to be created with the VK_IMAGE_USAGE_TRANSFER_SRC_BIT flag (see VulkanSwapChain::create)
+void ScreenshotExample::copyToReadback(vks::ReadbackSlot * slot, bool signalRenderComplete)
+{
+    // Source for the copy is the last rendered swapchain image
+    VkImage srcImage = headless ? offscreenTarget.images[currentBuffer] : swapChain.images[currentBuffer];
+    VkImage dstImage = slot->image;
 
     // Do the actual blit from the swapchain image to our host visible destination image
-    VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+    // A slot is only returned to its ring after its previous copy has completed, so it can be recorded right away
+    VkCommandBuffer copyCmd = slot->cmdBuffer;
+    VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
+
+    uint32_t querySlot = gpuProfiler.nextSlot(captureScope);
+    gpuProfiler.begin(copyCmd, captureScope, querySlot);
 
     // Transition destination image to transfer destination layout
     vks::tools::insertImageMemoryBarrier(
@@ -795,20 +1121,22 @@ void ScreenshotExample::saveScreenshot(const char * filename)
     );
 
     // Transition swapchain image from present to transfer source layout
+    // The copy is submitted right after the draw without waiting on the host, so it has to wait for the color attachment writes
+    // and for the transition back to present layout of another copy of the same frame
     vks::tools::insertImageMemoryBarrier(
         copyCmd,
         srcImage,
-        VK_ACCESS_MEMORY_READ_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
         VK_ACCESS_TRANSFER_READ_BIT,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        targetLayout(),
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
         VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
     );
 
     // If source and destination support blit we'll blit as this also does automatic format conversion (e.g. from BGR to RGB)
-    if (supportsBlit) {
+    if (readbackSupportsBlit) {
         // Define the region to blit (we will blit the whole swapchain image)
         VkOffset3D blitSize;
         blitSize.x = width;
@@ -857,11 +1185,11 @@ void ScreenshotExample::saveScreenshot(const char * filename)
         copyCmd,
         dstImage,
         VK_ACCESS_TRANSFER_WRITE_BIT,
-        VK_ACCESS_MEMORY_READ_BIT,
+        VK_ACCESS_HOST_READ_BIT,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         VK_IMAGE_LAYOUT_GENERAL,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
-        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
         VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
     );
 
@@ -872,67 +1200,96 @@ void ScreenshotExample::saveScreenshot(const char * filename)
         VK_ACCESS_TRANSFER_READ_BIT,
         VK_ACCESS_MEMORY_READ_BIT,
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        targetLayout(),
         VK_PIPELINE_STAGE_TRANSFER_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
         VkImageSubresourceRange { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
     );
 
-    vulkanDevice->flushCommandBuffer(copyCmd, queue);
-
-    // Get layout of the image (including row pitch)
-    VkImageSubresource subResource { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
-    VkSubresourceLayout subResourceLayout;
-    vkGetImageSubresourceLayout(device, dstImage, &subResource, &subResourceLayout);
-
-    // Map image memory so we can start copying from it
-    const char * data;
-    vkMapMemory(device, dstImageMemory, 0, VK_WHOLE_SIZE, 0, (void **) &data);
-    data += subResourceLayout.offset;
-
-    std::ofstream file(filename, std::ios::out | std::ios::binary);
-
-    // ppm header
-    file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
-    // If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-    bool colorSwizzle = false;
-    // Check if source is BGR
-    // Note: Not complete, only contains most common and basic BGR surface formats for demonstation purposes
-    if (!supportsBlit) {
-        std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-        colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), swapChain.colorFormat) != formatsBGR.end());
-    }
-
-    // ppm binary pixel data
-    for (uint32_t y = 0; y < height; y++) {
-        unsigned int * row = (unsigned int *) data;
-        for (uint32_t x = 0; x < width; x++) {
-            if (colorSwizzle) {
-                file.write((char *) row + 2, 1);
-                file.write((char *) row + 1, 1);
-                file.write((char *) row, 1);
-            } else {
-                file.write((char *) row, 3);
-            }
-            row++;
-        }
-        data += subResourceLayout.rowPitch;
+    gpuProfiler.end(copyCmd, captureScope, querySlot);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
+
+    // Submit the copy behind the draw, the last copy of a frame signals the semaphore the presentation waits on instead of the draw submission
+    VK_CHECK_RESULT(vkResetFences(device, 1, &slot->fence));
+    VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &copyCmd;
+    submitInfo.signalSemaphoreCount = signalRenderComplete ? 1 : 0;
+    submitInfo.pSignalSemaphores = &renderComplete[currentBuffer];
+    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, slot->fence));
+    gpuProfiler.submitted(captureScope, querySlot);
+}
+
+// Take a screenshot from the current swapchain image
+void ScreenshotExample::saveScreenshot(const char * filename, bool signalRenderComplete)
+{
+    VKS_TRACE_SCOPE("saveScreenshot");
+
+    // Copy into the next free persistently mapped readback image, no memory is allocated or mapped per capture
+    vks::ReadbackSlot * slot;
+    {
+        VKS_TRACE_SCOPE("saveScreenshot: acquire readback image");
+        slot = readbackRing.acquire(waitForReadback);
+    }
+    {
+        VKS_TRACE_SCOPE("saveScreenshot: record and submit copy");
+        copyToReadback(slot, signalRenderComplete);
     }
-    file.close();
 
-    std::cout << "Screenshot saved to disk" << std::endl;
+    // Waiting for the copy and writing the file happen on the worker thread
+    VKS_TRACE_SCOPE("saveScreenshot: queue job");
+    vks::ScreenshotJob job;
+    job.filename = filename;
+    job.format = screenshotFormat;
+    vks::image::formatFromFilename(job.filename, job.format);
+    job.compressionLevel = compressionLevel;
+    job.mappedWrite = mappedScreenshotWrites;
+    job.fence = slot->fence;
+    job.image.data = slot->data;
+    job.image.width = readbackRing.width;
+    job.image.height = readbackRing.height;
+    job.image.rowPitch = slot->rowPitch;
+    job.image.layout = readbackLayout;
+    job.announce = announceScreenshots;
+    job.release = [this, slot]() {
+        readbackRing.release(slot);
+    };
+    screenshotWorker->submit(std::move(job));
+}
+
+// Recording captures frames into the recorder's own readback images, so recording never competes with screenshots for them
+void ScreenshotExample::startRecording()
+{
+    std::string directory = getOutputPath() + "/recording";
+    mkdir(directory.c_str(), 0755);
+    if (recordingSettings.queueDepth > recordingDepthLimit) {
+        std::cerr << "Warning: Recording queue depth " << recordingSettings.queueDepth << " is limited to " << recordingDepthLimit
+                  << ", the depth set before prepare" << std::endl;
+        recordingSettings.queueDepth = recordingDepthLimit;
+    }
+    frameRecorder.reset(new vks::FrameRecorder(vulkanDevice, &memoryAllocator, transientCmdPool, width, height, readbackLayout, directory, recordingSettings));
+    if (!frameRecorder->valid()) {
+        std::cerr << "Error: Could not allocate the readback images for recording" << std::endl;
+        frameRecorder.reset();
+        return;
+    }
+    std::cout << "Recording " << width << "x" << height << " to " << directory << std::endl;
+}
 
-    // Clean up resources
-    vkUnmapMemory(device, dstImageMemory);
-    vkFreeMemory(device, dstImageMemory, nullptr);
-    vkDestroyImage(device, dstImage, nullptr);
+void ScreenshotExample::stopRecording()
+{
+    // Destroying the recorder writes all frames that are still queued
+    uint64_t captured = frameRecorder->captured();
+    uint64_t dropped = frameRecorder->dropped();
+    frameRecorder.reset();
+    std::cout << "Recording stopped: " << captured << " frames captured, " << dropped << " dropped" << std::endl;
 }
 
 void ScreenshotExample::createCommandBuffers()
 {
     // Create one command buffer for each swap chain image and reuse for rendering
-    drawCmdBuffers.resize(swapChain.imageCount);
+    drawCmdBuffers.resize(headless ? offscreenTarget.imageCount : swapChain.imageCount);
 
     VkCommandBufferAllocateInfo cmdBufAllocateInfo =
         vks::initializers::commandBufferAllocateInfo(
@@ -944,12 +1301,18 @@ void ScreenshotExample::createCommandBuffers()
     VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
 }
 
+// No image has been rendered to yet, the fences are owned by the frame sets created in prepareSynchronizationPrimitives
+// The semaphore presentation waits on belongs to the image, not to the frame in flight: a frame's fence doesn't cover
+// the presentation engine's wait, but an image is only acquired again once its previous presentation has consumed it
 void ScreenshotExample::createSynchronizationPrimitives()
 {
-    VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-    waitFences.resize(drawCmdBuffers.size());
-    for (auto & fence : waitFences) {
-        VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence));
+    imagesInFlight.assign(drawCmdBuffers.size(), VK_NULL_HANDLE);
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    renderComplete.resize(drawCmdBuffers.size());
+    for (VkSemaphore & semaphore : renderComplete) {
+        VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
     }
 }
 
@@ -957,19 +1320,43 @@ void ScreenshotExample::createCommandPool()
 {
     VkCommandPoolCreateInfo cmdPoolInfo = {};
     cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
-    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolInfo.queueFamilyIndex = headless ? offscreenTarget.queueNodeIndex : swapChain.queueNodeIndex;
     VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
+
+    // Uploads and copies into readback images are re-recorded for every submission, their command buffers are reset one
+    // by one when they are begun again. Kept apart from the draw command buffers, which are recorded once
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &transientCmdPool));
 }
 
 void ScreenshotExample::initSwapchain()
 {
-    swapChain.initSurface(view);
+    if (headless) {
+        offscreenTarget.connect(vulkanDevice, &memoryAllocator);
+    } else {
+        swapChain.initSurface(view);
+    }
 }
 
-void ScreenshotExample::setupSwapChain()
+bool ScreenshotExample::setupSwapChain()
 {
-    swapChain.create(&width, &height, false);
+    if (headless) {
+        if (!offscreenTarget.create(width, height)) {
+            return false;
+        }
+        colorFormat = offscreenTarget.colorFormat;
+    } else {
+        swapChain.create(&width, &height, false);
+        colorFormat = swapChain.colorFormat;
+    }
+
+    // Readback images match the swapchain extent, so they are only recreated along with the swapchain
+    if (screenshotWorker) {
+        screenshotWorker->waitIdle();
+    }
+    prepareReadback();
+    // Note that vkCmdBlitImage (if supported) will also do format conversions if the swapchain color format would differ
+    return readbackRing.create(vulkanDevice, &memoryAllocator, transientCmdPool, width, height, VK_FORMAT_R8G8B8A8_UNORM);
 }
 
 void ScreenshotExample::nextFrame()
@@ -990,10 +1377,15 @@ VkResult ScreenshotExample::createInstance(bool enableValidation)
     appInfo.pEngineName = name.c_str();
     appInfo.apiVersion = apiVersion;
 
-    std::vector<const char *> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+    std::vector<const char *> instanceExtensions;
 
-    // Enable surface extensions depending on os
-    instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+    // Enable surface extensions depending on os, headless rendering doesn't need any
+    if (!headless) {
+        instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+#if defined(VK_USE_PLATFORM_MACOS_MVK)
+        instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+#endif
+    }
 
     if (enabledInstanceExtensions.size() > 0) {
         for (auto enabledExtension : enabledInstanceExtensions) {
@@ -1074,16 +1466,19 @@ bool ScreenshotExample::initVulkan()
     vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
 
     vulkanDevice = new vks::VulkanDevice(physicalDevice);
-    VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+    VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, !headless);
     if (res != VK_SUCCESS) {
         vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
         return false;
     }
     device = vulkanDevice->logicalDevice;
+    memoryAllocator.create(vulkanDevice);
 
     vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
 
-    swapChain.connect(instance, physicalDevice, device);
+    if (!headless) {
+        swapChain.connect(instance, physicalDevice, device);
+    }
 
     return true;
 }
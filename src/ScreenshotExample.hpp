@@ -13,6 +13,7 @@
 #include <string>
 #include <numeric>
 #include <array>
+#include <memory>
 
 #include "vulkan/vulkan.h"
 
@@ -21,35 +22,48 @@
 #include "VulkanInitializers.hpp"
 #include "VulkanDevice.hpp"
 #include "VulkanSwapChain.hpp"
+#include "VulkanOffscreenTarget.hpp"
+#include "FrameRecorder.hpp"
+#include "ReadbackRing.hpp"
+#include "ScreenshotWorker.hpp"
+#include "CommandPoolRing.hpp"
+#include "FrameTimeHistogram.hpp"
+#include "GpuProfiler.hpp"
+#include "Instancing.hpp"
+#include "MemoryAllocator.hpp"
+#include "Mesh.hpp"
+#include "MeshOptimizer.hpp"
+#include "ParallelRecorder.hpp"
+#include "PipelineCache.hpp"
+#include "ShaderLibrary.hpp"
+#include "TaskGraph.hpp"
+#include "StagingRing.hpp"
+#include "UniformRing.hpp"
+#include "VertexPacking.hpp"
 
 class ScreenshotExample
 {
 public:
-    struct Vertex
-    {
-        float position[3];
-        float color[3];
-    };
+    using Vertex = vks::MeshVertex;
 
     struct
     {
-        VkDeviceMemory memory; // Handle to the device memory for this buffer
-        VkBuffer buffer;       // Handle to the Vulkan buffer object that the memory is bound to
+        vks::MemoryAllocation memory; // Range of device memory the buffer is bound to
+        VkBuffer buffer;              // Handle to the Vulkan buffer object that the memory is bound to
     } vertices;
 
     struct
     {
-        VkDeviceMemory memory;
+        vks::MemoryAllocation memory;
         VkBuffer buffer;
         uint32_t count;
+        VkIndexType type = VK_INDEX_TYPE_UINT32; // 16 bit whenever every vertex can be addressed with it
     } indices;
 
-    struct
-    {
-        VkDeviceMemory memory;
-        VkBuffer buffer;
-        VkDescriptorBufferInfo descriptor;
-    } uniformBufferVS;
+    // One slice per draw command buffer, each pre-recorded command buffer binds its own slice with a dynamic offset
+    vks::UniformRing uniformBufferVS;
+    // Per-instance model matrices for the instanced draw, bound as an instance-rate vertex buffer at the slice of each command buffer
+    vks::UniformRing instanceBuffer;
 
     struct
     {
@@ -59,27 +73,144 @@ public:
     } uboVS;
 
     VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
+    VkPipeline pipeline = VK_NULL_HANDLE;
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorSet descriptorSet;
-    VkSemaphore presentCompleteSemaphore;
-    VkSemaphore renderCompleteSemaphore;
+
+    /** @brief Upper limit for framesInFlight */
+    static constexpr uint32_t maxFramesInFlight = 3;
+    /** @brief Number of frames the CPU may record and submit ahead of the GPU (1 to maxFramesInFlight), set before prepare */
+    uint32_t framesInFlight = 2;
+    /** @brief Layout of the vertex buffer, the compact formats halve its size, set before prepare */
+    vks::vertices::VertexFormat vertexFormat = vks::vertices::VertexFormat::Float32;
+    /** @brief Reorder loaded meshes for the post-transform vertex cache and for vertex fetch, set before loadMesh */
+    bool optimizeMeshes = false;
+    /** @brief Also draw clusters of triangles facing outwards first to reduce overdraw, only used with optimizeMeshes */
+    bool optimizeOverdraw = false;
+    /** @brief Draw this many copies of the mesh on a grid in a single instanced draw, each rotating on its own, 0 draws it once; set before prepare */
+    uint32_t instanceCount = 0;
+    /** @brief Number of draw calls the instances are split into (1 to instanceCount), set before prepare */
+    uint32_t drawCount = 1;
+    /** @brief Threads recording the draws into secondary command buffers, 1 records them straight into the primary ones; set before prepare */
+    uint32_t recordThreads = 1;
+    /** @brief Record every frame's command buffer anew from a per-frame command pool instead of replaying the ones recorded in prepare, set before prepare */
+    bool rerecordEveryFrame = false;
+
+    struct FramePacingStats
+    {
+        uint32_t framesInFlight = 0;
+        uint64_t frames = 0;
+        /** @brief Mean time from the start of one frame to the start of the next one */
+        double frameMs = 0.0;
+        /** @brief Mean time per frame the CPU was blocked waiting for the GPU to finish an earlier frame */
+        double fenceWaitMs = 0.0;
+    };
+
+    struct StartupStats
+    {
+        /** @brief Time in milliseconds from constructing the example to submitting the first frame */
+        double firstFrameMs = 0.0;
+        double prepareMs = 0.0;
+        /** @brief Longest chain of dependent prepare steps, the shortest prepare time any number of threads can reach */
+        double prepareCriticalPathMs = 0.0;
+        /** @brief Time spent creating the graphics pipeline, the part a warm pipeline cache saves */
+        double pipelineMs = 0.0;
+        /** @brief Time spent recording the command buffers of all images */
+        double recordMs = 0.0;
+        /** @brief Start, duration and thread of every prepare step */
+        std::vector<vks::TaskTiming> prepareSteps;
+        vks::PipelineCacheStats pipelineCache;
+        vks::ShaderLibraryStats shaders;
+    };
 
     bool doScreenshot = false;
+    /** @brief Path of the next screenshot, screenshot.<format extension> in the output path if empty */
+    std::string screenshotFilename;
+    /** @brief Format of screenshots whose filename has no known extension, a .ppm, .qoi or .png extension takes precedence */
+    vks::image::ImageFormat screenshotFormat = vks::image::ImageFormat::PPM;
+    /** @brief Compression level of PNG screenshots, from 0 (fastest) to 9 (smallest) */
+    int compressionLevel = vks::image::defaultCompressionLevel;
+    /** @brief Convert ppm screenshots straight into memory mapped files, saves a copy but pays for page faults instead */
+    bool mappedScreenshotWrites = false;
+    /** @brief Block until a readback image is free instead of postponing a requested screenshot, allows capturing every frame */
+    bool waitForReadback = false;
+    /** @brief Print a message for every written screenshot */
+    bool announceScreenshots = true;
+    bool toggleRecording = false;
+    /** @brief Write the CPU trace to this file when the example is destroyed, requires tracing to be compiled in */
+    std::string traceFilename;
+    /** @brief Its queueDepth also sizes the capture query slots in prepare, a deeper queue set afterwards is clamped to it */
+    vks::FrameRecorder::Settings recordingSettings;
+    /** @brief File the pipeline cache is loaded from in prepare and saved to on exit, pipeline_cache.bin in the output path if empty */
+    std::string pipelineCacheFilename;
+    /** @brief Threads prepare runs independent setup steps on, including the calling thread, 1 runs them one after another */
+    uint32_t prepareThreads = 4;
 
-    ScreenshotExample();
+    /**
+    * @param headless Render into offscreen images instead of a swapchain, no window or surface is required
+    * @param width Width of the offscreen images (the swapchain extent is taken from the surface)
+    * @param height Height of the offscreen images
+    */
+    ScreenshotExample(bool headless = false, uint32_t width = 800, uint32_t height = 600);
     ~ScreenshotExample();
     void render();
     void keyPressed(uint32_t keycode);
-    void prepare();
+    /** @brief Create everything needed to render, returns false if a step failed (e.g. a shader is missing) */
+    bool prepare();
     bool initVulkan();
     void * setupWindow(void * view);
+    /** @brief Block until all requested screenshots have been written */
+    void waitForScreenshots();
+    vks::ScreenshotStats getScreenshotStats() const;
+    /** @brief Time in milliseconds spent mapping the persistently mapped readback images */
+    double getReadbackMapTime() const;
+    /** @brief Device memory reserved in blocks compared to the memory bound to resources */
+    vks::MemoryStats getMemoryStats() const;
+    FramePacingStats getFramePacingStats() const;
+    /** @brief Time to the first frame and how much of it went into pipeline creation, to compare cold and warm pipeline caches */
+    StartupStats getStartupStats() const;
+    /** @brief Rolling GPU time of the render pass and of the capture blit or copy, empty if the queue has no timestamps */
+    std::vector<vks::GpuScopeStats> getGpuScopeStats() const;
+    /** @brief Write the CPU trace events recorded so far as Chrome trace JSON */
+    bool writeTrace(const std::string & filename);
+    /**
+    * Load a .obj or .mesh file to render instead of the triangle, call before prepare
+    *
+    * @note The mesh is centered and scaled to fit the view
+    */
+    bool loadMesh(const std::string & filename);
+    /** @brief Simulated vertex cache efficiency of the loaded mesh before and after optimizing it */
+    vks::MeshOptimizationStats getMeshOptimizationStats() const;
+    /** @brief Vertex and index uploads through the staging ring, the time is from the first upload to the last submit */
+    vks::UploadStats getUploadStats(double & uploadMs) const;
+    /** @brief Mean time in milliseconds per frame spent writing the instance transforms */
+    double getInstanceUpdateTime() const;
+    /** @brief Mean time in milliseconds per frame spent recording the frame's command buffer, with rerecordEveryFrame */
+    double getFrameRecordTime(vks::CommandPoolStats & poolStats) const;
+    /**
+    * Record the command buffers of all images again on the given number of threads
+    *
+    * @note Waits for the device to become idle first. The command buffers stay recorded with that many threads, which
+    * also becomes recordThreads
+    *
+    * @return Best time in milliseconds of the iterations to record all command buffers
+    */
+    double measureRecording(uint32_t threadCount, uint32_t iterations);
 private:
     bool prepared = false;
+    bool headless = false;
     uint32_t width = 800;
     uint32_t height = 600;
 
     vks::VulkanDevice * vulkanDevice;
+    // Buffers, readback images and headless color images are bound to ranges of large per memory type blocks
+    vks::MemoryAllocator memoryAllocator;
+    // Geometry to upload in prepare, released once it has been staged
+    vks::Mesh mesh;
+    vks::MeshOptimizationStats meshOptimizationStats;
+    // Uploads to device local buffers are streamed through it, batches complete while the first frames are rendered
+    vks::StagingRing stagingRing;
+    double uploadMs = 0.0;
 
     glm::mat4 viewMatrix;
     glm::mat4 projectionMatrix;
@@ -100,40 +231,102 @@ private:
     VkDevice device;
     VkQueue queue;
     VkCommandPool cmdPool;
+    // Command buffers of uploads and copies into readback images, re-recorded for every submission
+    VkCommandPool transientCmdPool = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> drawCmdBuffers;
     VkRenderPass renderPass;
     std::vector<VkFramebuffer> frameBuffers;
     uint32_t currentBuffer = 0;
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-    std::vector<VkShaderModule> shaderModules;
     VulkanSwapChain swapChain;
-    std::vector<VkFence> waitFences;
+    VulkanOffscreenTarget offscreenTarget;
+    VkFormat colorFormat;
+    // Layout the render pass leaves the rendered image in, offscreen images are only ever copied from
+    VkImageLayout targetLayout() const
+    { return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+
+    // Synchronization primitives of one frame in flight, a set is only reused once its fence has signaled
+    struct FrameSync
+    {
+        VkSemaphore presentComplete; // Signaled when the acquired image can be rendered to
+        VkFence fence;               // Signaled when the draw submission of the frame has completed
+    };
+    std::vector<FrameSync> frameSync;
+    // One per image, signaled when the last submission of the image's frame has completed, presentation waits on it
+    std::vector<VkSemaphore> renderComplete;
+    uint32_t currentFrame = 0;
+    // Fence of the frame that last rendered into each image, its pre-recorded command buffer can't be resubmitted before that
+    std::vector<VkFence> imagesInFlight;
+
+    // Host visible images the swapchain image is copied into for a screenshot
+    vks::ReadbackRing readbackRing;
+    bool readbackSupportsBlit = true;
+    vks::pixels::PixelLayout readbackLayout = vks::pixels::PixelLayout::R8G8B8A8;
+    std::unique_ptr<vks::FrameRecorder> frameRecorder;
+    uint64_t frameCounter = 0;
+    std::unique_ptr<vks::ScreenshotWorker> screenshotWorker;
+
+    // Frame times of frames without and with a screenshot being captured or written
+    vks::FrameTimeHistogram frameTimes;
+    vks::FrameTimeHistogram captureFrameTimes;
+    // Time per frame the CPU spent blocked on frame fences, close to zero while the CPU is the bottleneck
+    vks::FrameTimeHistogram fenceWaitTimes;
+
+    // GPU time of the render pass (one query slot per pre-recorded command buffer) and of the copies into readback images
+    vks::GpuProfiler gpuProfiler;
+    uint32_t renderPassScope = 0;
+    uint32_t captureScope = 0;
+    // Deepest recorder queue the capture scope has query slots for
+    uint32_t recordingDepthLimit = 0;
+    std::chrono::high_resolution_clock::time_point lastFrameStart;
+    std::chrono::high_resolution_clock::time_point startupStart;
+    StartupStats startupStats;
+    vks::PipelineCache pipelineCache;
+    vks::ShaderLibrary shaderLibrary;
+    vks::ParallelRecorder parallelRecorder;
+    vks::CommandPoolRing frameCommandPools;
+    vks::FrameTimeHistogram frameRecordTimes;
+    std::chrono::high_resolution_clock::time_point lastFrameTimeReport;
+    bool lastFrameCapturing = false;
 
     bool viewUpdated = false;
+    // Incremented whenever uboVS changes, a slice is rewritten when its command buffer is submitted next if it's out of date
+    uint64_t uniformGeneration = 0;
+    std::vector<uint64_t> uniformSliceGenerations;
+    std::vector<vks::instances::InstanceState> instanceStates;
+    vks::FrameTimeHistogram instanceUpdateTimes;
     void nextFrame();
     void createCommandPool();
     void createSynchronizationPrimitives();
     void initSwapchain();
-    void setupSwapChain();
+    bool setupSwapChain();
     void createCommandBuffers();
-    void saveScreenshot(const char * filename);
+    void prepareScreenshot();
+    void prepareReadback();
+    void prepareProfiler();
+    void copyToReadback(vks::ReadbackSlot * slot, bool signalRenderComplete);
+    void saveScreenshot(const char * filename, bool signalRenderComplete);
+    void startRecording();
+    void stopRecording();
+    void updateFrameTimes();
     static std::string getShadersPath() ;
     void viewChanged();
-    uint32_t getMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties);
     void prepareSynchronizationPrimitives();
-    VkCommandBuffer getCommandBuffer(bool begin);
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image, VkCommandBufferUsageFlags usage);
     void buildCommandBuffers();
+    void recordDraws(VkCommandBuffer commandBuffer, uint32_t image, uint32_t firstDraw, uint32_t count);
     void destroyCommandBuffers();
     void draw();
-    void prepareVertices(bool useStagingBuffers);
+    bool prepareVertices(bool useStagingBuffers);
     void setupDescriptorPool();
     void setupDescriptorSetLayout();
     void setupDescriptorSet();
     void setupFrameBuffer();
     void setupRenderPass();
-    VkShaderModule loadSPIRVShader(std::string filename);
-    void preparePipelines();
-    void prepareUniformBuffers();
+    bool preparePipelines();
+    bool prepareUniformBuffers();
+    bool prepareInstances();
+    void updateInstances();
     void updateUniformBuffers();
     VkResult createInstance(bool enableValidation);
 };
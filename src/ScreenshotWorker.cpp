@@ -0,0 +1,136 @@
+/*
+* Background worker for screenshot readback
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ScreenshotWorker.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#include "Trace.hpp"
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    // Below this size handing stripes to other threads costs more than it saves
+    static const uint64_t stripedWriteMinTexels = 1024 * 1024;
+
+    ScreenshotWorker::ScreenshotWorker(VkDevice device, uint32_t encodeThreads)
+        : device(device), encodePool(encodeThreads)
+    {
+        thread = std::thread(&ScreenshotWorker::run, this);
+    }
+
+    ScreenshotWorker::~ScreenshotWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        jobAvailable.notify_one();
+        thread.join();
+    }
+
+    void ScreenshotWorker::submit(ScreenshotJob job)
+    {
+        pendingJobs++;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+    uint32_t ScreenshotWorker::pending() const
+    {
+        return pendingJobs.load();
+    }
+
+    void ScreenshotWorker::waitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobFinished.wait(lock, [this] { return pendingJobs.load() == 0; });
+    }
+
+    ScreenshotStats ScreenshotWorker::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totals;
+    }
+
+    void ScreenshotWorker::run()
+    {
+        VKS_TRACE_THREAD_NAME("screenshot worker");
+        for (;;) {
+            ScreenshotJob job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this] { return stop || !jobs.empty(); });
+                // Pending jobs are always finished before the worker stops
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            ScreenshotStats jobStats = process(job);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                totals.images += jobStats.images;
+                totals.bytes += jobStats.bytes;
+                totals.copyMs += jobStats.copyMs;
+                totals.convertMs += jobStats.convertMs;
+                totals.writeMs += jobStats.writeMs;
+                pendingJobs--;
+            }
+            jobFinished.notify_all();
+        }
+    }
+
+    ScreenshotStats ScreenshotWorker::process(ScreenshotJob & job)
+    {
+        ScreenshotStats jobStats;
+
+        // Waiting here instead of on the render thread is what keeps capturing from stalling the frame
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            VKS_TRACE_SCOPE("saveScreenshot: wait for copy");
+            VK_CHECK_RESULT(vkWaitForFences(device, 1, &job.fence, VK_TRUE, UINT64_MAX));
+        }
+        jobStats.copyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        VKS_TRACE_SCOPE("saveScreenshot: encode and write");
+        vks::image::WriteTimings timings;
+        uint64_t fileSize = vks::image::ppmFileSize(job.image.width, job.image.height);
+        bool written;
+        if (job.format == vks::image::ImageFormat::PPM && job.mappedWrite) {
+            written = vks::image::writePPMMapped(job.filename.c_str(), job.image, &encodePool, &timings);
+        } else if (job.format == vks::image::ImageFormat::PPM) {
+            bool striped = encodePool.size() > 1 && uint64_t(job.image.width) * job.image.height >= stripedWriteMinTexels;
+            written = striped
+                ? vks::image::writePPMStriped(job.filename.c_str(), job.image, encodePool, &timings)
+                : vks::image::writePPM(job.filename.c_str(), job.image, &timings);
+        } else {
+            auto encoder = vks::image::createEncoder(job.format, job.compressionLevel);
+            written = vks::image::writeImage(job.filename.c_str(), job.image, *encoder, &timings, &fileSize);
+        }
+        if (written) {
+            if (job.announce) {
+                std::cout << "Screenshot saved to disk" << std::endl;
+            }
+            jobStats.images = 1;
+            jobStats.bytes = fileSize;
+        }
+        jobStats.convertMs = timings.convertMs;
+        jobStats.writeMs = timings.writeMs;
+
+        if (job.release) {
+            job.release();
+        }
+        return jobStats;
+    }
+}
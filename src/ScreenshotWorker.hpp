@@ -0,0 +1,101 @@
+/*
+* Background worker for screenshot readback
+*
+* Waits for the GPU copy of a screenshot to finish, then converts and writes the image on its own thread
+* so that the render thread never blocks on fences, pixel conversion or file I/O
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "vulkan/vulkan.h"
+#include "ImageEncoder.hpp"
+#include "ImageWriter.hpp"
+#include "ThreadPool.hpp"
+
+namespace vks
+{
+    /** @brief A screenshot whose copy into host visible memory has been submitted to the GPU */
+    struct ScreenshotJob
+    {
+        /** @brief Path of the file to write */
+        std::string filename;
+        /** @brief Format the file is encoded in */
+        vks::image::ImageFormat format = vks::image::ImageFormat::PPM;
+        /** @brief Compression level for formats that have one, from 0 (fastest) to 9 (smallest) */
+        int compressionLevel = vks::image::defaultCompressionLevel;
+        /** @brief Convert ppm files straight into a memory mapped file instead of writing them */
+        bool mappedWrite = false;
+        /** @brief Fence that is signaled once the copy has finished executing */
+        VkFence fence = VK_NULL_HANDLE;
+        /** @brief Persistently mapped host visible image the copy writes to, only read once the fence is signaled */
+        vks::image::MappedImage image;
+        /** @brief Print a message once the file has been written */
+        bool announce = true;
+        /** @brief Called on the worker thread once the mapped image is no longer accessed */
+        std::function<void()> release;
+    };
+
+    /** @brief Accumulated cost of the screenshots written by a worker */
+    struct ScreenshotStats
+    {
+        uint64_t images = 0;
+        /** @brief Size of the written files in bytes */
+        uint64_t bytes = 0;
+        /** @brief Time the worker waited for the GPU copies to finish */
+        double copyMs = 0.0;
+        double convertMs = 0.0;
+        double writeMs = 0.0;
+    };
+
+    class ScreenshotWorker
+    {
+    public:
+        /**
+        * Start the worker thread
+        *
+        * @param device Device the copy fences belong to
+        * @param encodeThreads Threads used to convert and write large images in row stripes, 1 writes on the worker thread only
+        */
+        explicit ScreenshotWorker(VkDevice device, uint32_t encodeThreads = vks::ThreadPool::defaultThreadCount());
+
+        /** @brief Finishes all pending jobs before joining the worker thread */
+        ~ScreenshotWorker();
+
+        /** @brief Queue a job, returns immediately */
+        void submit(ScreenshotJob job);
+
+        /** @brief Number of jobs that have been submitted but not yet released */
+        uint32_t pending() const;
+
+        /** @brief Block until all submitted jobs have been written and released */
+        void waitIdle();
+
+        /** @brief Cost of the jobs finished so far */
+        ScreenshotStats stats() const;
+
+    private:
+        VkDevice device;
+        vks::ThreadPool encodePool;
+        std::thread thread;
+        mutable std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobFinished;
+        std::deque<ScreenshotJob> jobs;
+        std::atomic<uint32_t> pendingJobs { 0 };
+        ScreenshotStats totals;
+        bool stop = false;
+
+        void run();
+        ScreenshotStats process(ScreenshotJob & job);
+    };
+}
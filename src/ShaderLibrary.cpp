@@ -0,0 +1,176 @@
+/*
+* Shader library
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "ShaderLibrary.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Trace.hpp"
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    namespace
+    {
+        constexpr uint32_t spirvMagic = 0x07230203;
+        // Magic number, version, generator, bound and schema
+        constexpr size_t spirvHeaderSize = 5 * sizeof(uint32_t);
+
+        // FNV-1a over the words of the code, seeded with the size so code that only differs in trailing zeros differs
+        uint64_t hashCode(const uint32_t * code, size_t size)
+        {
+            uint64_t hash = 0xcbf29ce484222325ull ^ size;
+            for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+                hash = (hash ^ code[i]) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        // Read-only private mapping of a whole file, nullptr if the file can't be opened or is empty
+        const uint32_t * mapFile(const std::string & filename, size_t & size)
+        {
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return nullptr;
+            }
+            struct stat info;
+            void * data = MAP_FAILED;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                size = static_cast<size_t>(info.st_size);
+                data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            // The mapping keeps its own reference to the file
+            close(fd);
+            return data == MAP_FAILED ? nullptr : static_cast<const uint32_t *>(data);
+        }
+    }
+
+    ShaderLibrary::~ShaderLibrary()
+    {
+        destroy();
+    }
+
+    void ShaderLibrary::create(VkDevice device, const std::string & shadersPath)
+    {
+        destroy();
+        this->device = device;
+        this->shadersPath = shadersPath;
+        libraryStats = ShaderLibraryStats();
+    }
+
+    void ShaderLibrary::destroy()
+    {
+        for (auto & entry : modulesByContent) {
+            vkDestroyShaderModule(device, entry.second.module, nullptr);
+            if (entry.second.mapped) {
+                munmap(const_cast<uint32_t *>(entry.second.code), entry.second.size);
+            }
+        }
+        modulesByContent.clear();
+        modulesByName.clear();
+    }
+
+    const char * ShaderLibrary::validateSpirv(const void * code, size_t size)
+    {
+        if (size < spirvHeaderSize) {
+            return "too small for a SPIR-V header";
+        }
+        if (size % sizeof(uint32_t) != 0) {
+            return "not a whole number of 32 bit words";
+        }
+        if (reinterpret_cast<uintptr_t>(code) % alignof(uint32_t) != 0) {
+            return "not aligned to 32 bit words";
+        }
+        uint32_t magic = *static_cast<const uint32_t *>(code);
+        if (magic == __builtin_bswap32(spirvMagic)) {
+            return "SPIR-V of the opposite endianness";
+        }
+        if (magic != spirvMagic) {
+            return "missing the SPIR-V magic number";
+        }
+        return nullptr;
+    }
+
+    VkShaderModule ShaderLibrary::load(const std::string & name)
+    {
+        VKS_TRACE_SCOPE("loadShader");
+        // Held while the module is created, so a shader requested by two pipelines at once is still only loaded once
+        std::lock_guard<std::mutex> lock(mutex);
+        libraryStats.requests++;
+        auto loaded = modulesByName.find(name);
+        if (loaded != modulesByName.end()) {
+            return loaded->second;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        VkShaderModule module = VK_NULL_HANDLE;
+        if (const EmbeddedShader * shader = findEmbeddedShader(name)) {
+            module = createModule(name, shader->code, shader->size, false);
+            libraryStats.embedded += module != VK_NULL_HANDLE ? 1 : 0;
+        } else {
+            std::string filename = shadersPath + name;
+            size_t size = 0;
+            const uint32_t * code = mapFile(filename, size);
+            if (!code) {
+                std::cerr << "Error: Could not open shader file \"" << filename << "\"" << std::endl;
+                return VK_NULL_HANDLE;
+            }
+            libraryStats.mappedBytes += size;
+            module = createModule(filename, code, size, true);
+        }
+        libraryStats.loadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (module != VK_NULL_HANDLE) {
+            modulesByName[name] = module;
+        }
+        return module;
+    }
+
+    VkShaderModule ShaderLibrary::createModule(const std::string & name, const uint32_t * code, size_t size, bool mapped)
+    {
+        if (const char * reason = validateSpirv(code, size)) {
+            std::cerr << "Error: Shader \"" << name << "\" is " << reason << std::endl;
+            if (mapped) {
+                munmap(const_cast<uint32_t *>(code), size);
+            }
+            return VK_NULL_HANDLE;
+        }
+
+        uint64_t hash = hashCode(code, size);
+        auto candidates = modulesByContent.equal_range(hash);
+        for (auto existing = candidates.first; existing != candidates.second; ++existing) {
+            if (existing->second.size == size && memcmp(existing->second.code, code, size) == 0) {
+                if (mapped) {
+                    munmap(const_cast<uint32_t *>(code), size);
+                }
+                libraryStats.deduplicated++;
+                return existing->second.module;
+            }
+        }
+
+        VkShaderModuleCreateInfo moduleCreateInfo {};
+        moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleCreateInfo.codeSize = size;
+        moduleCreateInfo.pCode = code;
+
+        VkShaderModule module;
+        VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &module));
+        ContentModule content;
+        content.code = code;
+        content.size = size;
+        content.mapped = mapped;
+        content.module = module;
+        modulesByContent.emplace(hash, std::move(content));
+        libraryStats.modules++;
+        return module;
+    }
+}
@@ -0,0 +1,110 @@
+/*
+* Shader library
+*
+* Loads SPIR-V shader modules for pipeline creation. Shaders compiled into the executable (configured with
+* -DSCREENSHOT_EMBED_SHADERS=ON) are used straight from their constexpr arrays, others are memory mapped from the
+* shader directory, so no shader is read into an intermediate buffer. The code is checked for the SPIR-V magic number,
+* a whole number of words and word alignment before the driver sees it. Modules are kept for the lifetime of the
+* library and shared between requests for the same file or for files with the same content, the mapping of a file
+* that got its own module stays until then to compare the code of later files against
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+    /** @brief SPIR-V code compiled into the executable */
+    struct EmbeddedShader
+    {
+        /** @brief Path relative to the shader directory, e.g. triangle/triangle.vert.spv */
+        const char * name;
+        const uint32_t * code;
+        /** @brief Size of the code in bytes */
+        size_t size;
+    };
+
+    /** @brief Embedded shader with the given name, nullptr if there is none or shaders are not embedded */
+    const EmbeddedShader * findEmbeddedShader(const std::string & name);
+
+    struct ShaderLibraryStats
+    {
+        uint32_t requests = 0;
+        /** @brief Number of shader modules created */
+        uint32_t modules = 0;
+        /** @brief Requests answered with an existing module of another file with the same content */
+        uint32_t deduplicated = 0;
+        /** @brief Modules created from embedded code */
+        uint32_t embedded = 0;
+        size_t mappedBytes = 0;
+        /** @brief Time in milliseconds spent mapping, validating and creating modules */
+        double loadMs = 0.0;
+    };
+
+    class ShaderLibrary
+    {
+    public:
+        ~ShaderLibrary();
+
+        /**
+        * @param device Device the modules are created on
+        * @param shadersPath Directory shader files are loaded from, ending with a slash
+        */
+        void create(VkDevice device, const std::string & shadersPath);
+
+        /** @brief Destroy all modules, no pipeline may be created from them afterwards */
+        void destroy();
+
+        /**
+        * Get the module of a shader, creating it on the first request, may be called from several threads
+        *
+        * @param name Path of the SPIR-V file relative to the shader directory
+        *
+        * @return The module, owned by the library, or VK_NULL_HANDLE if the shader is missing or not valid SPIR-V
+        */
+        VkShaderModule load(const std::string & name);
+
+        ShaderLibraryStats stats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return libraryStats;
+        }
+
+        /**
+        * Check code before handing it to the driver
+        *
+        * @return Reason the code is not valid SPIR-V, nullptr if it looks valid
+        */
+        static const char * validateSpirv(const void * code, size_t size);
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        std::string shadersPath;
+        std::unordered_map<std::string, VkShaderModule> modulesByName;
+        struct ContentModule
+        {
+            // Embedded array or file mapping the module was created from, compared on a hash hit so a collision can't
+            // hand out the module of other code
+            const uint32_t * code = nullptr;
+            size_t size = 0;
+            bool mapped = false;
+            VkShaderModule module = VK_NULL_HANDLE;
+        };
+        // Keyed by a hash of the code and its size
+        std::unordered_multimap<uint64_t, ContentModule> modulesByContent;
+        ShaderLibraryStats libraryStats;
+        mutable std::mutex mutex;
+
+        // Takes over a mapped file, it's unmapped right away unless a new module is created from it
+        VkShaderModule createModule(const std::string & name, const uint32_t * code, size_t size, bool mapped);
+    };
+}
@@ -0,0 +1,204 @@
+/*
+* Staging ring for buffer uploads
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "StagingRing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "Trace.hpp"
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    // Copies of vertex and index data have no alignment requirement, this keeps memcpy on whole cache lines
+    static const VkDeviceSize stagingAlignment = 64;
+
+    StagingRing::StagingRing()
+        : ring(0)
+    {}
+
+    StagingRing::~StagingRing()
+    {
+        destroy();
+    }
+
+    bool StagingRing::create(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkCommandPool commandPool, VkQueue queue, VkDeviceSize size)
+    {
+        destroy();
+
+        this->device = vulkanDevice->logicalDevice;
+        this->allocator = allocator;
+        this->commandPool = commandPool;
+        this->queue = queue;
+        ring = RingAllocator(size);
+        uploadStats = UploadStats();
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        VK_CHECK_RESULT(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
+        // Written sequentially and only read by the GPU, write combined memory is fine
+        if (!allocator->allocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, memory, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            vkDestroyBuffer(device, buffer, nullptr);
+            buffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkCommandBufferAllocateInfo allocateInfo {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = commandPool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+
+        VkFenceCreateInfo fenceInfo {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        for (Batch & batch : batches) {
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, &batch.cmdBuffer));
+            VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &batch.fence));
+        }
+        return true;
+    }
+
+    void StagingRing::destroy()
+    {
+        if (buffer == VK_NULL_HANDLE) {
+            return;
+        }
+        wait();
+        for (Batch & batch : batches) {
+            vkFreeCommandBuffers(device, commandPool, 1, &batch.cmdBuffer);
+            vkDestroyFence(device, batch.fence, nullptr);
+            batch = Batch();
+        }
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(memory);
+        buffer = VK_NULL_HANDLE;
+        submittedBatches = 0;
+        completedBatches = 0;
+    }
+
+    bool StagingRing::retireOldest(bool wait)
+    {
+        if (completedBatches == submittedBatches) {
+            return false;
+        }
+        Batch & batch = batches[completedBatches % batchCount];
+        if (wait) {
+            auto start = std::chrono::high_resolution_clock::now();
+            VK_CHECK_RESULT(vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+            uploadStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        } else if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS) {
+            return false;
+        }
+        ring.release(batch.end);
+        completedBatches++;
+        return true;
+    }
+
+    void StagingRing::upload(VkBuffer buffer, VkDeviceSize offset, const void * data, VkDeviceSize size)
+    {
+        VKS_TRACE_SCOPE("StagingRing::upload");
+        const uint8_t * source = static_cast<const uint8_t *>(data);
+        VkDeviceSize batchSize = ring.size() / batchCount;
+
+        while (size > 0) {
+            Batch & batch = batches[submittedBatches % batchCount];
+            VkDeviceSize chunk = std::min(size, batchSize - batch.stagedBytes);
+
+            VkDeviceSize ringOffset;
+            while (!ring.allocate(chunk, stagingAlignment, ringOffset)) {
+                // Full, push out what's staged and wait for the oldest batch to hand back its space
+                if (!batch.regions.empty()) {
+                    submit();
+                }
+                retireOldest(true);
+            }
+            Batch & target = batches[submittedBatches % batchCount];
+
+            memcpy(memory.mapped + ringOffset, source, chunk);
+            target.regions.push_back({ buffer, { ringOffset, offset, chunk } });
+            target.stagedBytes += chunk;
+            uploadStats.bytes += chunk;
+
+            source += chunk;
+            offset += chunk;
+            size -= chunk;
+            if (target.stagedBytes >= batchSize) {
+                submit();
+            }
+        }
+    }
+
+    void StagingRing::submit()
+    {
+        Batch & batch = batches[submittedBatches % batchCount];
+        if (batch.regions.empty()) {
+            return;
+        }
+        VKS_TRACE_SCOPE("StagingRing::submit");
+        allocator->flush(memory);
+
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(batch.cmdBuffer, &beginInfo));
+
+        // One copy command per run of regions with the same destination, uploads of a buffer are staged back to back
+        std::vector<VkBufferCopy> copies;
+        for (size_t i = 0; i < batch.regions.size();) {
+            VkBuffer destination = batch.regions[i].buffer;
+            copies.clear();
+            for (; i < batch.regions.size() && batch.regions[i].buffer == destination; i++) {
+                copies.push_back(batch.regions[i].copy);
+            }
+            vkCmdCopyBuffer(batch.cmdBuffer, buffer, destination, static_cast<uint32_t>(copies.size()), copies.data());
+        }
+
+        // Submission order carries the barrier over to the draws of later submissions
+        VkMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(batch.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VK_CHECK_RESULT(vkEndCommandBuffer(batch.cmdBuffer));
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.cmdBuffer;
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, batch.fence));
+
+        uploadStats.regions += batch.regions.size();
+        uploadStats.submits++;
+        batch.end = ring.head();
+        batch.regions.clear();
+        batch.stagedBytes = 0;
+        submittedBatches++;
+
+        // The next batch has to be free before anything is staged into it
+        if (submittedBatches - completedBatches == batchCount) {
+            retireOldest(true);
+        }
+        VK_CHECK_RESULT(vkResetFences(device, 1, &batches[submittedBatches % batchCount].fence));
+    }
+
+    void StagingRing::update()
+    {
+        while (retireOldest(false)) {
+        }
+    }
+
+    void StagingRing::wait()
+    {
+        while (retireOldest(true)) {
+        }
+    }
+}
@@ -0,0 +1,120 @@
+/*
+* Staging ring for buffer uploads
+*
+* One persistently mapped host visible buffer that all uploads to device local buffers are streamed through. Uploads
+* are copied into the ring and collected into batches, each batch is recorded as one vkCmdCopyBuffer per destination
+* with all of its regions and submitted with a fence instead of being waited on. While the GPU copies one batch the
+* CPU fills the next one, and ring space is reused once the fence of the batch that read it has signaled
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "MemoryAllocator.hpp"
+#include "RingAllocator.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+    struct UploadStats
+    {
+        /** @brief Bytes copied into the ring */
+        uint64_t bytes = 0;
+        /** @brief Copy regions recorded, consecutive ones with the same destination share a vkCmdCopyBuffer */
+        uint64_t regions = 0;
+        /** @brief Batches submitted */
+        uint32_t submits = 0;
+        /** @brief Time in milliseconds the CPU waited for a batch to free up ring space */
+        double stallMs = 0.0;
+    };
+
+    class StagingRing
+    {
+    public:
+        static constexpr VkDeviceSize defaultSize = 32 * 1024 * 1024;
+        /** @brief Batches in flight, a batch is submitted once it has staged a quarter of the ring */
+        static constexpr uint32_t batchCount = 4;
+
+        StagingRing();
+        ~StagingRing();
+
+        /**
+        * Create the ring buffer and the command buffers of the batches, destroying the previous ones if the ring has
+        * already been created
+        *
+        * @param vulkanDevice Device to create the buffer on
+        * @param allocator Allocator the host visible memory is taken from
+        * @param commandPool Pool to allocate the copy command buffers from, must allow resetting command buffers
+        * @param queue Queue the copies are submitted to
+        * @param size Size of the ring in bytes, uploads larger than a batch are split
+        *
+        * @return False if no host visible memory could be allocated, the ring is left destroyed
+        */
+        bool create(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkCommandPool commandPool, VkQueue queue, VkDeviceSize size = defaultSize);
+
+        /** @brief Wait for pending batches and destroy the ring */
+        void destroy();
+
+        /**
+        * Stage data for a copy into a buffer, the data may be freed as soon as the call returns
+        *
+        * @note The copy is only submitted with its batch, call submit to push out the last one. Later submissions to the
+        * same queue see the data in the vertex input stage, other reads need their own barrier
+        *
+        * @param buffer Destination buffer, created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        * @param offset Offset in the destination buffer
+        * @param data Data to copy
+        * @param size Size of the data in bytes
+        */
+        void upload(VkBuffer buffer, VkDeviceSize offset, const void * data, VkDeviceSize size);
+
+        /** @brief Submit the staged copies without waiting for them */
+        void submit();
+
+        /** @brief Reuse the ring space of batches that have completed, does not block */
+        void update();
+
+        /** @brief Wait for all submitted batches */
+        void wait();
+
+        UploadStats stats() const
+        { return uploadStats; }
+
+    private:
+        struct Region
+        {
+            VkBuffer buffer;
+            VkBufferCopy copy;
+        };
+
+        struct Batch
+        {
+            VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+            std::vector<Region> regions;
+            VkDeviceSize stagedBytes = 0;
+            /** @brief Ring position to release once the batch has completed */
+            uint64_t end = 0;
+        };
+
+        VkDevice device = VK_NULL_HANDLE;
+        vks::MemoryAllocator * allocator = nullptr;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkQueue queue = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        vks::MemoryAllocation memory;
+        RingAllocator ring;
+        Batch batches[batchCount];
+        // Batches are used round-robin, the one being filled is submittedBatches % batchCount
+        uint64_t submittedBatches = 0;
+        uint64_t completedBatches = 0;
+        UploadStats uploadStats;
+
+        bool retireOldest(bool wait);
+    };
+}
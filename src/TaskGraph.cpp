@@ -0,0 +1,121 @@
+/*
+* Task graph
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "TaskGraph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Trace.hpp"
+
+namespace vks
+{
+    TaskGraph::TaskId TaskGraph::add(const char * name, std::function<void()> work, std::vector<TaskId> dependencies, bool mainThread)
+    {
+        TaskId id = static_cast<TaskId>(tasks.size());
+        for (TaskId dependency : dependencies) {
+            assert(dependency < id);
+            tasks[dependency].dependents.push_back(id);
+        }
+        tasks.push_back({ name, std::move(work), std::move(dependencies), {}, mainThread });
+        return id;
+    }
+
+    void TaskGraph::run(uint32_t threadCount)
+    {
+        using Clock = std::chrono::high_resolution_clock;
+        const Clock::time_point start = Clock::now();
+        auto sinceStart = [&start](Clock::time_point time) {
+            return std::chrono::duration<double, std::milli>(time - start).count();
+        };
+
+        taskTimings.assign(tasks.size(), TaskTiming());
+        std::vector<uint32_t> pending(tasks.size());
+        // Tasks that may run anywhere and tasks that wait for the calling thread, both in the order they became ready
+        std::deque<TaskId> ready;
+        std::deque<TaskId> mainReady;
+        for (TaskId id = 0; id < tasks.size(); id++) {
+            pending[id] = static_cast<uint32_t>(tasks[id].dependencies.size());
+            if (pending[id] == 0) {
+                (tasks[id].mainThread ? mainReady : ready).push_back(id);
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable readyChanged;
+        size_t finished = 0;
+
+        auto runTasks = [&](uint32_t thread) {
+            bool mainThread = thread == 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                readyChanged.wait(lock, [&] {
+                    return finished == tasks.size() || !ready.empty() || (mainThread && !mainReady.empty());
+                });
+                if (finished == tasks.size()) {
+                    return;
+                }
+                std::deque<TaskId> & queue = mainThread && !mainReady.empty() ? mainReady : ready;
+                TaskId id = queue.front();
+                queue.pop_front();
+                lock.unlock();
+
+                Clock::time_point taskStart = Clock::now();
+                {
+                    VKS_TRACE_SCOPE(tasks[id].name);
+                    tasks[id].work();
+                }
+                Clock::time_point taskEnd = Clock::now();
+
+                lock.lock();
+                taskTimings[id] = { tasks[id].name, sinceStart(taskStart), sinceStart(taskEnd) - sinceStart(taskStart), thread };
+                for (TaskId dependent : tasks[id].dependents) {
+                    if (--pending[dependent] == 0) {
+                        (tasks[dependent].mainThread ? mainReady : ready).push_back(dependent);
+                    }
+                }
+                finished++;
+                readyChanged.notify_all();
+            }
+        };
+
+        // More threads than tasks would only ever sleep
+        uint32_t workerCount = std::min<uint32_t>(std::max(threadCount, 1u), static_cast<uint32_t>(std::max<size_t>(tasks.size(), 1))) - 1;
+        std::vector<std::thread> workers;
+        for (uint32_t i = 0; i < workerCount; i++) {
+            workers.emplace_back([&runTasks, i] {
+                VKS_TRACE_THREAD_NAME("task worker");
+                runTasks(i + 1);
+            });
+        }
+        runTasks(0);
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        runMs = sinceStart(Clock::now());
+    }
+
+    double TaskGraph::criticalPathMs() const
+    {
+        // Tasks only depend on earlier ones, so one pass in order sees every dependency first
+        std::vector<double> finish(tasks.size(), 0.0);
+        double longest = 0.0;
+        for (TaskId id = 0; id < tasks.size(); id++) {
+            double ready = 0.0;
+            for (TaskId dependency : tasks[id].dependencies) {
+                ready = std::max(ready, finish[dependency]);
+            }
+            finish[id] = ready + (id < taskTimings.size() ? taskTimings[id].durationMs : 0.0);
+            longest = std::max(longest, finish[id]);
+        }
+        return longest;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+* Task graph
+*
+* Runs a fixed set of tasks on a few threads, each task as soon as all tasks it depends on have finished. Used to
+* overlap the independent setup steps of prepare(), e.g. pipeline compilation with vertex uploads. Dependencies can
+* only name tasks added earlier, so the graph can't have cycles. Start and duration of every task are recorded
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vks
+{
+    struct TaskTiming
+    {
+        const char * name = nullptr;
+        /** @brief Start in milliseconds since the graph started running */
+        double startMs = 0.0;
+        double durationMs = 0.0;
+        /** @brief Thread the task ran on, 0 is the thread that called run */
+        uint32_t thread = 0;
+    };
+
+    class TaskGraph
+    {
+    public:
+        using TaskId = uint32_t;
+
+        /**
+        * Add a task
+        *
+        * @param name Task name for timings and trace markers, has to outlive the graph (string literals)
+        * @param work Function to run
+        * @param dependencies Tasks that have to finish first, all added before this one
+        * @param mainThread Only run the task on the thread that calls run, for work tied to the UI thread
+        */
+        TaskId add(const char * name, std::function<void()> work, std::vector<TaskId> dependencies = {}, bool mainThread = false);
+
+        /**
+        * Run every task once and return when all of them have finished
+        *
+        * @param threadCount Number of threads including the calling one, 1 runs them one after another on the calling thread
+        */
+        void run(uint32_t threadCount);
+
+        /** @brief Timings of the last run, in the order the tasks were added */
+        const std::vector<TaskTiming> & timings() const
+        { return taskTimings; }
+
+        /** @brief Time in milliseconds of the last run */
+        double elapsedMs() const
+        { return runMs; }
+
+        /** @brief Longest chain of dependent tasks in the last run, no number of threads can finish faster */
+        double criticalPathMs() const;
+
+    private:
+        struct Task
+        {
+            const char * name;
+            std::function<void()> work;
+            std::vector<TaskId> dependencies;
+            std::vector<TaskId> dependents;
+            bool mainThread;
+        };
+
+        std::vector<Task> tasks;
+        std::vector<TaskTiming> taskTimings;
+        double runMs = 0.0;
+    };
+}
@@ -0,0 +1,128 @@
+/*
+* Minimal thread pool for data parallel loops
+*
+* Runs the iterations of a loop on a fixed set of threads, the calling thread takes part in the work. Used to
+* convert and write row stripes of large images in parallel
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+    class ThreadPool
+    {
+    public:
+        /** @brief Number of threads used if none is given, all hardware threads */
+        static uint32_t defaultThreadCount()
+        { return std::max(1u, std::thread::hardware_concurrency()); }
+
+        /** @param threadCount Number of threads working on a loop, including the calling thread */
+        explicit ThreadPool(uint32_t threadCount = defaultThreadCount())
+        {
+            for (uint32_t i = 1; i < std::max(threadCount, 1u); i++) {
+                threads.emplace_back(&ThreadPool::run, this);
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wake.notify_all();
+            for (auto & thread : threads) {
+                thread.join();
+            }
+        }
+
+        /** @brief Number of threads working on a loop, including the calling thread */
+        uint32_t size() const
+        { return static_cast<uint32_t>(threads.size()) + 1; }
+
+        /**
+        * Call task(i) for every i in [0, count) and return once all calls have finished
+        *
+        * @note Only one loop can run at a time, parallelFor must not be called from several threads at once
+        */
+        void parallelFor(uint32_t count, const std::function<void(uint32_t)> & task)
+        {
+            if (threads.empty() || count <= 1) {
+                for (uint32_t i = 0; i < count; i++) {
+                    task(i);
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                this->task = &task;
+                this->count = count;
+                next = 0;
+                busy = static_cast<uint32_t>(threads.size());
+                generation++;
+            }
+            wake.notify_all();
+
+            work();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return busy == 0; });
+            this->task = nullptr;
+        }
+
+    private:
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        const std::function<void(uint32_t)> * task = nullptr;
+        uint32_t count = 0;
+        std::atomic<uint32_t> next { 0 };
+        uint32_t busy = 0;
+        uint64_t generation = 0;
+        bool stop = false;
+
+        // Iterations are handed out one at a time, so threads that finish early pick up the remaining ones
+        void work()
+        {
+            for (uint32_t i = next++; i < count; i = next++) {
+                (*task)(i);
+            }
+        }
+
+        void run()
+        {
+            uint64_t seen = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this, seen] { return stop || generation != seen; });
+                    if (stop) {
+                        return;
+                    }
+                    seen = generation;
+                }
+
+                work();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    busy--;
+                }
+                finished.notify_one();
+            }
+        }
+    };
+}
@@ -0,0 +1,170 @@
+/*
+* CPU trace markers
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vks::trace
+{
+    namespace
+    {
+        // Fields are relaxed atomics so the exporting thread can read an event while its owner overwrites it
+        struct Event
+        {
+            std::atomic<const char *> name { nullptr };
+            std::atomic<uint64_t> start { 0 };
+            std::atomic<uint64_t> end { 0 };
+        };
+
+        // Written by its owning thread only, the head is published with release semantics after each event
+        struct ThreadBuffer
+        {
+            uint32_t id = 0;
+            std::atomic<const char *> name { nullptr };
+            std::atomic<uint64_t> head { 0 };
+            std::unique_ptr<Event[]> events { new Event[eventsPerThread] };
+        };
+
+        struct RecordedEvent
+        {
+            const char * name;
+            uint64_t start;
+            uint64_t end;
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            // Buffers are kept after their thread has exited so its events can still be exported
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        };
+
+        Registry & registry()
+        {
+            static Registry instance;
+            return instance;
+        }
+
+        // The registry lock is only taken the first time a thread records an event
+        ThreadBuffer & threadBuffer()
+        {
+            thread_local std::shared_ptr<ThreadBuffer> buffer;
+            if (!buffer) {
+                buffer = std::make_shared<ThreadBuffer>();
+                Registry & r = registry();
+                std::lock_guard<std::mutex> lock(r.mutex);
+                buffer->id = static_cast<uint32_t>(r.buffers.size()) + 1;
+                r.buffers.push_back(buffer);
+            }
+            return *buffer;
+        }
+
+        void writeEscaped(std::ostream & stream, const char * text)
+        {
+            for (const char * c = text; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    stream << '\\' << *c;
+                } else if (static_cast<unsigned char>(*c) >= 0x20) {
+                    stream << *c;
+                }
+            }
+        }
+    }
+
+    uint64_t now()
+    {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void record(const char * name, uint64_t start, uint64_t end)
+    {
+        ThreadBuffer & buffer = threadBuffer();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        Event & event = buffer.events[head % eventsPerThread];
+        event.name.store(name, std::memory_order_relaxed);
+        event.start.store(start, std::memory_order_relaxed);
+        event.end.store(end, std::memory_order_relaxed);
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void setThreadName(const char * name)
+    {
+        threadBuffer().name.store(name, std::memory_order_relaxed);
+    }
+
+    bool writeChromeTrace(const std::string & filename)
+    {
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            Registry & r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            buffers = r.buffers;
+        }
+
+        std::ofstream file(filename, std::ios::out);
+        if (!file) {
+            std::cerr << "Error: Could not open " << filename << " for writing" << std::endl;
+            return false;
+        }
+
+        // Chrome trace timestamps and durations are in microseconds
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto & buffer : buffers) {
+            const char * threadName = buffer->name.load(std::memory_order_relaxed);
+            if (threadName) {
+                file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":\"";
+                writeEscaped(file, threadName);
+                file << "\"}}";
+                first = false;
+            }
+
+            // The owning thread fills the slot of event head before it publishes head + 1, so that slot, which is also the
+            // one of event head - eventsPerThread, may be half written
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t begin = head >= eventsPerThread ? head - eventsPerThread + 1 : 0;
+            std::vector<RecordedEvent> events;
+            events.reserve(head - begin);
+            for (uint64_t i = begin; i < head; i++) {
+                const Event & event = buffer->events[i % eventsPerThread];
+                events.push_back({ event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed) });
+            }
+
+            // Events the owning thread may have overwritten while they were copied are dropped
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t newHead = buffer->head.load(std::memory_order_relaxed);
+            uint64_t firstValid = newHead >= eventsPerThread ? newHead - eventsPerThread + 1 : 0;
+
+            for (uint64_t i = std::max(begin, firstValid); i < head; i++) {
+                const auto & event = events[i - begin];
+                file << (first ? "" : ",") << "\n{\"name\":\"";
+                writeEscaped(file, event.name);
+                file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+                     << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+
+        file.close();
+        if (!file) {
+            std::cerr << "Error: Could not write " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+* CPU trace markers
+*
+* VKS_TRACE_SCOPE records the start and duration of the enclosing scope into a ring buffer owned by the calling
+* thread, so recording takes no lock and never allocates. The rings of all threads can be exported as Chrome trace
+* JSON, which opens in chrome://tracing and https://ui.perfetto.dev
+*
+* Markers are only compiled in if VKS_TRACING is defined (configure with -DSCREENSHOT_TRACING=ON), otherwise the
+* macros expand to nothing
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace vks::trace
+{
+    /** @brief Events kept per thread, once a ring is full the oldest events are overwritten and the newest eventsPerThread - 1 are exported */
+    const uint32_t eventsPerThread = 64 * 1024;
+
+    /** @brief True if trace markers are compiled in */
+    constexpr bool enabled()
+    {
+#ifdef VKS_TRACING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /** @brief Nanoseconds since the first call, on a monotonic clock shared by all threads */
+    uint64_t now();
+
+    /**
+    * Record a complete event on the calling thread
+    *
+    * @param name Event name, has to outlive the export (string literals)
+    * @param start Start time as returned by now()
+    * @param end End time as returned by now()
+    */
+    void record(const char * name, uint64_t start, uint64_t end);
+
+    /** @brief Name the calling thread in exported traces, has to outlive the export (string literals) */
+    void setThreadName(const char * name);
+
+    /**
+    * Write the events of all threads as Chrome trace JSON
+    *
+    * @note May be called while other threads keep recording, events overwritten during the export are left out
+    *
+    * @return True if the file has been written
+    */
+    bool writeChromeTrace(const std::string & filename);
+
+    /** @brief Records the lifetime of the scope it's declared in */
+    class Scope
+    {
+    public:
+        explicit Scope(const char * name)
+            : name(name), start(now())
+        {}
+
+        ~Scope()
+        { record(name, start, now()); }
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+    private:
+        const char * name;
+        uint64_t start;
+    };
+}
+
+#ifdef VKS_TRACING
+#define VKS_TRACE_CONCAT_INNER(a, b) a##b
+#define VKS_TRACE_CONCAT(a, b) VKS_TRACE_CONCAT_INNER(a, b)
+#define VKS_TRACE_SCOPE(name) vks::trace::Scope VKS_TRACE_CONCAT(traceScope, __COUNTER__)(name)
+#define VKS_TRACE_THREAD_NAME(name) vks::trace::setThreadName(name)
+#else
+#define VKS_TRACE_SCOPE(name) ((void) 0)
+#define VKS_TRACE_THREAD_NAME(name) ((void) 0)
+#endif
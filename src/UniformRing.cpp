@@ -0,0 +1,75 @@
+/*
+* Ring of uniform buffer slices
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "VulkanTools.hpp"
+
+namespace vks
+{
+    UniformRing::~UniformRing()
+    {
+        destroy();
+    }
+
+    bool UniformRing::create(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkDeviceSize elementSize, uint32_t sliceCount,
+                             VkBufferUsageFlags usage)
+    {
+        destroy();
+
+        this->device = vulkanDevice->logicalDevice;
+        this->allocator = allocator;
+        this->sliceCount = sliceCount;
+
+        // Dynamic offsets have to be multiples of minUniformBufferOffsetAlignment, other slices are kept on separate cache lines
+        VkDeviceSize alignment = 64;
+        if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+            alignment = std::max<VkDeviceSize>(vulkanDevice->properties.limits.minUniformBufferOffsetAlignment, 1);
+        }
+        sliceSize = (elementSize + alignment - 1) / alignment * alignment;
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sliceSize * sliceCount;
+        bufferInfo.usage = usage;
+        VK_CHECK_RESULT(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
+        if (!allocator->allocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, memory, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            destroy();
+            return false;
+        }
+
+        descriptor.buffer = buffer;
+        descriptor.offset = 0;
+        descriptor.range = elementSize;
+        return true;
+    }
+
+    void UniformRing::destroy()
+    {
+        if (buffer == VK_NULL_HANDLE) {
+            return;
+        }
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(memory);
+        buffer = VK_NULL_HANDLE;
+        sliceCount = 0;
+    }
+
+    void UniformRing::write(uint32_t slice, const void * data, VkDeviceSize size)
+    {
+        memcpy(memory.mapped + slice * sliceSize, data, size);
+        flush(slice, size);
+    }
+
+    void UniformRing::flush(uint32_t slice, VkDeviceSize size)
+    {
+        // Does nothing if the allocator found coherent memory
+        allocator->flush(memory, slice * sliceSize, size);
+    }
+}
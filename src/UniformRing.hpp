@@ -0,0 +1,75 @@
+/*
+* Ring of uniform buffer slices
+*
+* One uniform buffer split into slices aligned to minUniformBufferOffsetAlignment and addressed with a dynamic offset,
+* so the host can write the slice of the next submission while the GPU still reads the others. The buffer stays
+* mapped for its whole lifetime, updates are a plain copy. With a vertex buffer usage the same ring holds per-instance
+* data that is bound with a slice offset instead
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "vulkan/vulkan.h"
+#include "MemoryAllocator.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+    class UniformRing
+    {
+    public:
+        VkBuffer buffer = VK_NULL_HANDLE;
+        /** @brief Descriptor of a single slice, for descriptors of type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC */
+        VkDescriptorBufferInfo descriptor {};
+
+        ~UniformRing();
+
+        /**
+        * Create the buffer, destroying the previous one if the ring has already been created
+        *
+        * @param vulkanDevice Device to create the buffer on
+        * @param allocator Allocator the host visible memory is taken from
+        * @param elementSize Size of the uniform data of one slice
+        * @param sliceCount Number of slices, at least the number of submissions that may read the buffer at the same time
+        * @param usage Usage of the buffer, slices are only aligned to minUniformBufferOffsetAlignment for uniform buffers
+        *
+        * @return False if no host visible memory could be allocated, the ring is left destroyed
+        */
+        bool create(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator, VkDeviceSize elementSize, uint32_t sliceCount,
+                    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+        void destroy();
+
+        /** @brief Dynamic offset that selects a slice when binding the descriptor set */
+        uint32_t dynamicOffset(uint32_t slice) const
+        { return static_cast<uint32_t>(slice * sliceSize); }
+
+        uint32_t size() const
+        { return sliceCount; }
+
+        /** @brief Mapped memory of a slice, for filling it in place instead of copying from a host copy with write */
+        void * slice(uint32_t slice) const
+        { return memory.mapped + slice * sliceSize; }
+
+        /** @brief Make host writes to a slice visible to the device, does nothing for coherent memory */
+        void flush(uint32_t slice, VkDeviceSize size);
+
+        /**
+        * Copy uniform data into a slice
+        *
+        * @note The slice must not be read by a pending submission, e.g. by only writing the slice of a frame after waiting for its fence
+        */
+        void write(uint32_t slice, const void * data, VkDeviceSize size);
+
+    private:
+        VkDevice device = VK_NULL_HANDLE;
+        vks::MemoryAllocator * allocator = nullptr;
+        vks::MemoryAllocation memory;
+        VkDeviceSize sliceSize = 0;
+        uint32_t sliceCount = 0;
+    };
+}
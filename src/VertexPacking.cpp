@@ -0,0 +1,317 @@
+/*
+* Vertex packing kernels for mesh uploads
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VertexPacking.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VKS_VERTICES_X86 1
+#include <immintrin.h>
+#endif
+
+// vcvtnq_s32_f32 (round to nearest even) is only available on AArch64
+#if defined(__aarch64__)
+#define VKS_VERTICES_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace vks::vertices
+{
+    namespace
+    {
+        // Scalar reference kernels, they round the way the vector conversions do in the default rounding mode
+
+        inline uint32_t floatBits(float value)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        inline float bitsFloat(uint32_t bits)
+        {
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // Round to nearest even, matches the hardware conversions for every value except the payload of NaNs
+        uint16_t floatToHalf(float value)
+        {
+            uint32_t bits = floatBits(value);
+            uint32_t sign = bits & 0x80000000u;
+            bits ^= sign;
+
+            uint16_t half;
+            if (bits >= 0x47800000u) {
+                // 65536 and above, infinity and NaN
+                half = bits > 0x7F800000u ? 0x7E00 : 0x7C00;
+            } else if (bits < 0x38800000u) {
+                // Below the smallest normal half, adding 0.5 lets the float unit round the mantissa into place
+                const float magic = bitsFloat(126u << 23);
+                half = static_cast<uint16_t>(floatBits(bitsFloat(bits) + magic) - floatBits(magic));
+            } else {
+                uint32_t odd = (bits >> 13) & 1;
+                bits += (uint32_t(15 - 127) << 23) + 0xFFF + odd;
+                half = static_cast<uint16_t>(bits >> 13);
+            }
+            return static_cast<uint16_t>(half | (sign >> 16));
+        }
+
+        float halfToFloat(uint16_t half)
+        {
+            uint32_t sign = uint32_t(half & 0x8000) << 16;
+            uint32_t exponent = (half >> 10) & 0x1F;
+            uint32_t mantissa = half & 0x3FF;
+            if (exponent == 0) {
+                float value = std::ldexp(float(mantissa), -24);
+                return sign ? -value : value;
+            }
+            if (exponent == 31) {
+                return bitsFloat(sign | 0x7F800000u | (mantissa << 13));
+            }
+            return bitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+        }
+
+        inline int32_t quantize(float value, float low, float scale)
+        {
+            return static_cast<int32_t>(std::lrint(std::min(std::max(value, low), 1.0f) * scale));
+        }
+
+        inline void packColorScalar(const MeshVertex & src, CompactVertex & dst)
+        {
+            for (int i = 0; i < 3; i++) {
+                dst.color[i] = static_cast<uint8_t>(quantize(src.color[i], 0.0f, 255.0f));
+            }
+            dst.color[3] = 255;
+        }
+
+        template<VertexFormat format>
+        void packScalar(const MeshVertex * src, CompactVertex * dst, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; i++) {
+                for (int axis = 0; axis < 3; axis++) {
+                    if constexpr (format == VertexFormat::Half) {
+                        dst[i].position[axis] = floatToHalf(src[i].position[axis]);
+                    } else {
+                        dst[i].position[axis] = static_cast<uint16_t>(quantize(src[i].position[axis], -1.0f, 32767.0f));
+                    }
+                }
+                dst[i].position[3] = format == VertexFormat::Half ? 0x3C00 : 32767;
+                packColorScalar(src[i], dst[i]);
+            }
+        }
+
+#if defined(VKS_VERTICES_X86)
+        // F16C kernels: one vertex per iteration, the position and the color are converted four components at a time
+        // Loads start at the position and at its z component, so they never read past the end of the vertex
+
+        __attribute__((target("avx,f16c"))) inline void packColorF16C(const MeshVertex & src, CompactVertex & dst)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+            __m128 color = _mm_loadu_ps(&src.position[2]);
+            color = _mm_shuffle_ps(color, color, _MM_SHUFFLE(0, 3, 2, 1));
+            color = _mm_blend_ps(color, one, 0x8);
+            color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), one);
+            __m128i quantized = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+            quantized = _mm_packus_epi32(quantized, quantized);
+            quantized = _mm_packus_epi16(quantized, quantized);
+            int32_t packed = _mm_cvtsi128_si32(quantized);
+            memcpy(dst.color, &packed, sizeof(packed));
+        }
+
+        template<VertexFormat format>
+        __attribute__((target("avx,f16c"))) void packF16C(const MeshVertex * src, CompactVertex * dst, uint32_t count)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+            for (uint32_t i = 0; i < count; i++) {
+                __m128 position = _mm_blend_ps(_mm_loadu_ps(src[i].position), one, 0x8);
+                __m128i packed;
+                if constexpr (format == VertexFormat::Half) {
+                    packed = _mm_cvtps_ph(position, _MM_FROUND_TO_NEAREST_INT);
+                } else {
+                    position = _mm_min_ps(_mm_max_ps(position, _mm_set1_ps(-1.0f)), one);
+                    packed = _mm_cvtps_epi32(_mm_mul_ps(position, _mm_set1_ps(32767.0f)));
+                    packed = _mm_packs_epi32(packed, packed);
+                }
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst[i].position), packed);
+                packColorF16C(src[i], dst[i]);
+            }
+        }
+#endif
+
+#if defined(VKS_VERTICES_NEON)
+        // NEON kernels: the same structure as the F16C ones
+
+        template<VertexFormat format>
+        void packNEON(const MeshVertex * src, CompactVertex * dst, uint32_t count)
+        {
+            const float32x4_t one = vdupq_n_f32(1.0f);
+            for (uint32_t i = 0; i < count; i++) {
+                float32x4_t position = vsetq_lane_f32(1.0f, vld1q_f32(src[i].position), 3);
+                if constexpr (format == VertexFormat::Half) {
+                    vst1_u16(dst[i].position, vreinterpret_u16_f16(vcvt_f16_f32(position)));
+                } else {
+                    position = vminq_f32(vmaxq_f32(position, vdupq_n_f32(-1.0f)), one);
+                    int32x4_t quantized = vcvtnq_s32_f32(vmulq_f32(position, vdupq_n_f32(32767.0f)));
+                    vst1_s16(reinterpret_cast<int16_t *>(dst[i].position), vqmovn_s32(quantized));
+                }
+
+                float32x4_t color = vld1q_f32(&src[i].position[2]);
+                color = vsetq_lane_f32(1.0f, vextq_f32(color, color, 1), 3);
+                color = vminq_f32(vmaxq_f32(color, vdupq_n_f32(0.0f)), one);
+                uint16x4_t narrowed = vqmovun_s32(vcvtnq_s32_f32(vmulq_f32(color, vdupq_n_f32(255.0f))));
+                uint8x8_t bytes = vqmovn_u16(vcombine_u16(narrowed, narrowed));
+                vst1_lane_u32(reinterpret_cast<uint32_t *>(dst[i].color), vreinterpret_u32_u8(bytes), 0);
+            }
+        }
+#endif
+
+        template<VertexFormat format>
+        PackFunction selectKernel(Isa isa)
+        {
+            switch (isa) {
+                case Isa::Scalar:
+                    return packScalar<format>;
+#if defined(VKS_VERTICES_X86)
+                case Isa::F16C:
+                    return packF16C<format>;
+#endif
+#if defined(VKS_VERTICES_NEON)
+                case Isa::NEON:
+                    return packNEON<format>;
+#endif
+                default:
+                    return nullptr;
+            }
+        }
+    }
+
+    const char * isaName(Isa isa)
+    {
+        switch (isa) {
+            case Isa::Scalar:
+                return "scalar";
+            case Isa::F16C:
+                return "f16c";
+            case Isa::NEON:
+                return "neon";
+        }
+        return "unknown";
+    }
+
+    const char * formatName(VertexFormat format)
+    {
+        switch (format) {
+            case VertexFormat::Float32:
+                return "float";
+            case VertexFormat::Half:
+                return "half";
+            case VertexFormat::Snorm16:
+                return "snorm16";
+        }
+        return "unknown";
+    }
+
+    bool formatFromName(const char * name, VertexFormat & format)
+    {
+        for (VertexFormat candidate : { VertexFormat::Float32, VertexFormat::Half, VertexFormat::Snorm16 }) {
+            if (strcmp(name, formatName(candidate)) == 0) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t vertexStride(VertexFormat format)
+    {
+        return format == VertexFormat::Float32 ? sizeof(MeshVertex) : sizeof(CompactVertex);
+    }
+
+    bool isaSupported(Isa isa)
+    {
+        switch (isa) {
+            case Isa::Scalar:
+                return true;
+#if defined(VKS_VERTICES_X86)
+            case Isa::F16C:
+                return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#endif
+#if defined(VKS_VERTICES_NEON)
+            case Isa::NEON:
+                return true;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    Isa bestIsa()
+    {
+        static const Isa best = [] {
+            for (Isa isa : { Isa::F16C, Isa::NEON }) {
+                if (isaSupported(isa)) {
+                    return isa;
+                }
+            }
+            return Isa::Scalar;
+        }();
+        return best;
+    }
+
+    PackFunction getKernel(VertexFormat format, Isa isa)
+    {
+        if (!isaSupported(isa)) {
+            return nullptr;
+        }
+        switch (format) {
+            case VertexFormat::Half:
+                return selectKernel<VertexFormat::Half>(isa);
+            case VertexFormat::Snorm16:
+                return selectKernel<VertexFormat::Snorm16>(isa);
+            default:
+                return nullptr;
+        }
+    }
+
+    void pack(VertexFormat format, const MeshVertex * src, CompactVertex * dst, uint32_t count)
+    {
+        static const PackFunction kernels[] = {
+            nullptr,
+            getKernel(VertexFormat::Half, bestIsa()),
+            getKernel(VertexFormat::Snorm16, bestIsa()),
+        };
+        kernels[static_cast<int>(format)](src, dst, count);
+    }
+
+    void unpack(VertexFormat format, const CompactVertex * src, MeshVertex * dst, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                if (format == VertexFormat::Half) {
+                    dst[i].position[axis] = halfToFloat(src[i].position[axis]);
+                } else {
+                    // -32768 also maps to -1, as in the Vulkan conversion of signed normalized values
+                    dst[i].position[axis] = std::max(static_cast<int16_t>(src[i].position[axis]) / 32767.0f, -1.0f);
+                }
+                dst[i].color[axis] = src[i].color[axis] / 255.0f;
+            }
+        }
+    }
+
+    void narrowIndices(const uint32_t * src, uint16_t * dst, uint32_t count)
+    {
+        // A plain loop, compilers turn it into pack instructions
+        for (uint32_t i = 0; i < count; i++) {
+            dst[i] = static_cast<uint16_t>(src[i]);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+* Vertex packing kernels for mesh uploads
+*
+* Packs the 24 byte float vertices of a mesh into 12 byte compact vertices: a four component 16 bit position (half
+* float or signed normalized) and an RGBA8 color. Both position formats and R8G8B8A8_UNORM are mandatory vertex buffer
+* formats, the vertex shader reads them as floats without changes. Index buffers are narrowed to 16 bit when every
+* index fits
+* Vectorized kernels (F16C, NEON) are selected at runtime, with a scalar fallback that also serves as reference
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "Mesh.hpp"
+
+namespace vks::vertices
+{
+    enum class VertexFormat
+    {
+        Float32,    // MeshVertex, VK_FORMAT_R32G32B32_SFLOAT position and color
+        Half,       // CompactVertex, VK_FORMAT_R16G16B16A16_SFLOAT position and VK_FORMAT_R8G8B8A8_UNORM color
+        Snorm16,    // CompactVertex, VK_FORMAT_R16G16B16A16_SNORM position and VK_FORMAT_R8G8B8A8_UNORM color
+    };
+
+    /** @brief Packed vertex of the Half and Snorm16 formats, the fourth position component is 1 */
+    struct CompactVertex
+    {
+        uint16_t position[4];
+        uint8_t color[4];
+    };
+
+    /** @brief Instruction sets a packing kernel can be implemented with */
+    enum class Isa
+    {
+        Scalar,
+        F16C,       // AVX with F16C, conversions of four components per instruction
+        NEON,
+    };
+
+    /**
+    * Signature of a packing kernel
+    *
+    * @param src Source vertices, positions must be within [-1, 1] for Snorm16 (see vks::fitToUnitCube), larger values saturate
+    * @param dst Destination for count compact vertices
+    * @param count Number of vertices to pack
+    *
+    * @note Conversions round to nearest even, colors are clamped to [0, 1]
+    */
+    typedef void (* PackFunction)(const MeshVertex * src, CompactVertex * dst, uint32_t count);
+
+    /** @brief Returns a readable name for an instruction set */
+    const char * isaName(Isa isa);
+
+    /** @brief Returns a readable name for a vertex format, as accepted by formatFromName */
+    const char * formatName(VertexFormat format);
+
+    /** @brief Parse "float", "half" or "snorm16", returns false for anything else */
+    bool formatFromName(const char * name, VertexFormat & format);
+
+    /** @brief Size of a vertex in bytes */
+    uint32_t vertexStride(VertexFormat format);
+
+    /** @brief Returns true if the instruction set has been compiled in and is supported by the running cpu */
+    bool isaSupported(Isa isa);
+
+    /** @brief Returns the fastest instruction set supported by the running cpu */
+    Isa bestIsa();
+
+    /** @brief Returns the kernel for a compact format and instruction set, or nullptr for Float32 or an unsupported instruction set */
+    PackFunction getKernel(VertexFormat format, Isa isa);
+
+    /** @brief Pack count vertices into a compact format using the fastest available kernel */
+    void pack(VertexFormat format, const MeshVertex * src, CompactVertex * dst, uint32_t count);
+
+    /** @brief Convert compact vertices back to floats, the way the vertex input stage reads them */
+    void unpack(VertexFormat format, const CompactVertex * src, MeshVertex * dst, uint32_t count);
+
+    /** @brief Returns true if all indices of a mesh with this many vertices fit into 16 bits */
+    inline bool fitsShortIndices(uint64_t vertexCount)
+    { return vertexCount <= 65536; }
+
+    /** @brief Copy 32 bit indices into 16 bit ones, every index must be below 65536 */
+    void narrowIndices(const uint32_t * src, uint16_t * dst, uint32_t count);
+}
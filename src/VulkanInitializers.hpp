@@ -60,6 +60,13 @@ namespace vks::initializers
             return imageCreateInfo;
         }
 
+        inline VkImageViewCreateInfo imageViewCreateInfo()
+        {
+            VkImageViewCreateInfo imageViewCreateInfo {};
+            imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            return imageViewCreateInfo;
+        }
+
         inline VkFenceCreateInfo fenceCreateInfo(VkFenceCreateFlags flags = 0)
         {
             VkFenceCreateInfo fenceCreateInfo {};
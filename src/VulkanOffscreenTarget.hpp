@@ -0,0 +1,139 @@
+/*
+* Class wrapping a set of offscreen color images used instead of a swap chain
+*
+* Used for headless rendering where there is no window, no surface and no presentation engine. The images are
+* rendered to in turn and left in transfer source layout, ready to be copied for a screenshot
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "VulkanTools.hpp"
+#include "VulkanDevice.hpp"
+#include "MemoryAllocator.hpp"
+#include "VulkanSwapChain.hpp"
+
+class VulkanOffscreenTarget
+{
+private:
+    vks::VulkanDevice * vulkanDevice = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    vks::MemoryAllocator * allocator = nullptr;
+    std::vector<vks::MemoryAllocation> memories;
+    uint32_t nextImage = 0;
+public:
+    /** @brief Color format of the images, always RGBA so screenshots can be copied without a blit or swizzle */
+    VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    uint32_t imageCount = 0;
+    std::vector<VkImage> images;
+    std::vector<SwapChainBuffer> buffers;
+    /** @brief Queue family index of the graphics queue */
+    uint32_t queueNodeIndex = UINT32_MAX;
+
+    /**
+    * Set the device to create the images on
+    *
+    * @param vulkanDevice Device the images are created on, its graphics queue family is used for rendering
+    * @param allocator Allocator the image memory is taken from
+    */
+    void connect(vks::VulkanDevice * vulkanDevice, vks::MemoryAllocator * allocator)
+    {
+        this->vulkanDevice = vulkanDevice;
+        this->device = vulkanDevice->logicalDevice;
+        this->allocator = allocator;
+        queueNodeIndex = vulkanDevice->queueFamilyIndices.graphics;
+    }
+
+    /**
+    * Create the images with the given width and height, destroying previously created images
+    *
+    * @param width Width of the images
+    * @param height Height of the images
+    * @param count Number of images, allows the CPU to record the next frame while earlier ones are still rendered
+    *
+    * @return False if an image could not get device local memory, no images are left then
+    */
+    bool create(uint32_t width, uint32_t height, uint32_t count = 3)
+    {
+        cleanup();
+
+        imageCount = count;
+        images.resize(imageCount);
+        buffers.resize(imageCount);
+        memories.resize(imageCount);
+
+        for (uint32_t i = 0; i < imageCount; i++) {
+            VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+            imageCI.imageType = VK_IMAGE_TYPE_2D;
+            imageCI.format = colorFormat;
+            imageCI.extent = { width, height, 1 };
+            imageCI.mipLevels = 1;
+            imageCI.arrayLayers = 1;
+            imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            // Transfer source is what allows the rendered images to be copied for screenshots
+            imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+            // Sub-allocated like every other resource, images too large for a block get a dedicated allocation
+            if (!allocator->allocateImage(images[i], vks::ResourceTiling::Optimal, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memories[i])) {
+                std::cerr << "Error: Could not allocate memory for offscreen image " << i << std::endl;
+                vkDestroyImage(device, images[i], nullptr);
+                imageCount = i;
+                cleanup();
+                return false;
+            }
+
+            VkImageViewCreateInfo colorAttachmentView = vks::initializers::imageViewCreateInfo();
+            colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            colorAttachmentView.format = colorFormat;
+            colorAttachmentView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            colorAttachmentView.subresourceRange.baseMipLevel = 0;
+            colorAttachmentView.subresourceRange.levelCount = 1;
+            colorAttachmentView.subresourceRange.baseArrayLayer = 0;
+            colorAttachmentView.subresourceRange.layerCount = 1;
+            colorAttachmentView.image = images[i];
+
+            buffers[i].image = images[i];
+            VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+        }
+        nextImage = 0;
+        return true;
+    }
+
+    /**
+    * Get the next image to render to
+    *
+    * @param imageIndex Pointer to the image index that is set to the next image
+    *
+    * @note Images are handed out round robin, waiting for the previous frame rendered to the image is up to the caller
+    */
+    void acquireNextImage(uint32_t * imageIndex)
+    {
+        VKS_TRACE_SCOPE("acquireNextImage");
+        *imageIndex = nextImage;
+        nextImage = (nextImage + 1) % imageCount;
+    }
+
+    /**
+    * Destroy and free the images
+    */
+    void cleanup()
+    {
+        for (uint32_t i = 0; i < imageCount; i++) {
+            vkDestroyImageView(device, buffers[i].view, nullptr);
+            vkDestroyImage(device, images[i], nullptr);
+            allocator->free(memories[i]);
+        }
+        imageCount = 0;
+        images.clear();
+        buffers.clear();
+        memories.clear();
+    }
+};
@@ -17,6 +17,7 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.hpp"
+#include "Trace.hpp"
 
 // Macro to get a procedure address based on a vulkan instance
 #define GET_INSTANCE_PROC_ADDR(inst, entrypoint)                        \
@@ -78,12 +79,17 @@ public:
         VkResult err = VK_SUCCESS;
 
         // Create the os-specific surface
+#if defined(VK_USE_PLATFORM_MACOS_MVK)
         VkMacOSSurfaceCreateInfoMVK surfaceCreateInfo = {};
         surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_MACOS_SURFACE_CREATE_INFO_MVK;
         surfaceCreateInfo.pNext = NULL;
         surfaceCreateInfo.flags = 0;
         surfaceCreateInfo.pView = view;
         err = vkCreateMacOSSurfaceMVK(instance, &surfaceCreateInfo, NULL, &surface);
+#else
+        // Surfaces are only supported on macOS, other platforms have to render headless
+        err = VK_ERROR_EXTENSION_NOT_PRESENT;
+#endif
 
         if (err != VK_SUCCESS) {
             vks::tools::exitFatal("Could not create surface!", err);
@@ -381,6 +387,7 @@ public:
     */
     VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t * imageIndex)
     {
+        VKS_TRACE_SCOPE("acquireNextImage");
         // By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
         // With that we don't have to handle VK_NOT_READY
         return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence) nullptr, imageIndex);
@@ -397,6 +404,7 @@ public:
     */
     VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE)
     {
+        VKS_TRACE_SCOPE("queuePresent");
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.pNext = NULL;
@@ -0,0 +1,95 @@
+/*
+* Worker pool
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+#include "Trace.hpp"
+
+namespace vks
+{
+    namespace
+    {
+        inline uint32_t partStart(uint32_t count, uint32_t part, uint32_t parts)
+        {
+            return static_cast<uint32_t>(uint64_t(count) * part / parts);
+        }
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        stop();
+    }
+
+    void WorkerPool::start(uint32_t workerCount)
+    {
+        stop();
+        this->workerCount = std::max(workerCount, 1u);
+        stopping = false;
+        for (uint32_t worker = 1; worker < this->workerCount; worker++) {
+            // No job is running, so the generation is stable and the new thread waits for the next one
+            threads.emplace_back(&WorkerPool::run, this, worker, generation);
+        }
+    }
+
+    void WorkerPool::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobStarted.notify_all();
+        for (auto & thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+        workerCount = 1;
+    }
+
+    void WorkerPool::parallelFor(uint32_t count, const RangeFunction & function)
+    {
+        if (workerCount > 1) {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &function;
+            jobCount = count;
+            running = workerCount - 1;
+            generation++;
+        }
+        jobStarted.notify_all();
+
+        function(0, 0, partStart(count, 1, workerCount));
+
+        if (workerCount > 1) {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobFinished.wait(lock, [this] { return running == 0; });
+            job = nullptr;
+        }
+    }
+
+    void WorkerPool::run(uint32_t worker, uint64_t seen)
+    {
+        VKS_TRACE_THREAD_NAME("recording worker");
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            jobStarted.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            const RangeFunction & function = *job;
+            uint32_t count = jobCount;
+            lock.unlock();
+
+            function(worker, partStart(count, worker, workerCount), partStart(count, worker + 1, workerCount));
+
+            lock.lock();
+            if (--running == 0) {
+                jobFinished.notify_one();
+            }
+        }
+    }
+}
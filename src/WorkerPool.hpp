@@ -0,0 +1,65 @@
+/*
+* Worker pool
+*
+* A fixed set of threads that split a range of work between them, used to record the draws of a frame into secondary
+* command buffers in parallel. The threads are started once and wait between jobs, so a job costs a wake-up instead of
+* a thread start. Worker i always gets the i-th part of the range and runs on the same thread, so it can use resources
+* that must only be touched by one thread at a time, like a command pool
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+    class WorkerPool
+    {
+    public:
+        /** @brief Runs the part [begin, end) of a range on worker worker */
+        using RangeFunction = std::function<void(uint32_t worker, uint32_t begin, uint32_t end)>;
+
+        ~WorkerPool();
+
+        /**
+        * Start the threads, stopping the previous ones if the pool has already been started
+        *
+        * @param workerCount Number of workers including the calling thread, which is always worker 0
+        */
+        void start(uint32_t workerCount);
+
+        void stop();
+
+        uint32_t size() const
+        { return workerCount; }
+
+        /**
+        * Split [0, count) into size() contiguous parts of nearly equal length and run them in parallel
+        *
+        * @note Returns when all parts have finished. Workers whose part is empty are still called
+        */
+        void parallelFor(uint32_t count, const RangeFunction & function);
+
+    private:
+        uint32_t workerCount = 1;
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable jobStarted;
+        std::condition_variable jobFinished;
+        // Incremented for every job, a worker runs when it sees a generation it hasn't run yet
+        uint64_t generation = 0;
+        uint32_t running = 0;
+        bool stopping = false;
+        const RangeFunction * job = nullptr;
+        uint32_t jobCount = 0;
+
+        void run(uint32_t worker, uint64_t seen);
+    };
+}